@@ -0,0 +1,130 @@
+/*
+Navigation benchmark for imported CAD parts, with and without the decimation of CADMesh (Decimator::SetDefaultTolerance,
+/custom/cad/decimate). Every part of the file is built as a G4TessellatedSolid twice, as read and decimated to the
+tolerance, and both are traced with the same random rays from the box around the part: Inside() at the start, then
+DistanceToIn() and DistanceToOut() in turn, moving to every boundary until the ray leaves the part - the calls of the
+navigator for the steps which start in or end at the part. A step is one DistanceToIn() or DistanceToOut() call.
+Printed: the time to build the solids as read, decimated and again from the decimation cache (a geometry rebuild),
+then per part the facets, the geometry steps per second and the speedup; the decimation prints the sampled
+deviation of every part. The rate is that of the geometry alone: the physics and the navigation in the other volumes
+add the same time per step to both solids, so the speedup of a full run is lower.
+
+usage: CADBench file.obj|.stl|.ply|.cmb [tolerance in mm, default 0.01] [rays, default 200000]
+*/
+
+#include "CADMesh.hh"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+  struct Ray {
+    G4ThreeVector point;
+    G4ThreeVector direction;
+  };
+
+  // random points in the box around the solid (10% larger) and isotropic directions, the same for both solids
+  std::vector<Ray> MakeRays(const G4VSolid* solid, std::size_t n)
+  {
+    G4ThreeVector min, max;
+    solid->BoundingLimits(min, max);
+    G4ThreeVector margin = 0.05*(max - min);
+    min -= margin;
+    max += margin;
+
+    std::mt19937_64 engine(12345);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    std::vector<Ray> rays(n);
+    for ( auto& ray : rays ) {
+      ray.point = G4ThreeVector(min.x() + uniform(engine)*(max.x() - min.x()),
+                              min.y() + uniform(engine)*(max.y() - min.y()),
+                              min.z() + uniform(engine)*(max.z() - min.z()));
+      double cosTheta = 2.*uniform(engine) - 1., phi = 2.*M_PI*uniform(engine);
+      double sinTheta = std::sqrt(1. - cosTheta*cosTheta);
+      ray.direction = G4ThreeVector(sinTheta*std::cos(phi), sinTheta*std::sin(phi), cosTheta);
+    }
+    return rays;
+  }
+
+  // geometry steps per second, every ray is followed through the solid until it leaves it
+  double Navigate(const G4VSolid* solid, const std::vector<Ray>& rays)
+  {
+    const int maxSteps = 1000;                  // per ray, stops a ray caught on a surface
+    volatile double sink = 0.;                  // keeps the calls from being optimized away
+    std::size_t steps = 0;
+    auto start = std::chrono::steady_clock::now();
+    for ( const auto& ray : rays ) {
+      G4ThreeVector point = ray.point;
+      G4bool inside = (solid->Inside(point) != kOutside);
+      for ( int i = 0; i < maxSteps; i++ ) {
+        G4double distance = inside ? solid->DistanceToOut(point, ray.direction)
+                                   : solid->DistanceToIn(point, ray.direction);
+        steps++;
+        if (distance == kInfinity) break;       // the ray misses the solid
+        point += distance*ray.direction;
+        sink = sink + distance;
+        inside = !inside;
+      }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return steps/seconds;
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    std::cerr << "usage: CADBench file.obj|.stl|.ply|.cmb [tolerance in mm, default 0.01] [rays, default 200000]" << std::endl;
+    return 1;
+  }
+  std::string fileName = argv[1];
+  double tolerance  = (argc > 2) ? std::atof(argv[2]) : 0.01;
+  std::size_t nbOfRays = (argc > 3) ? std::atol(argv[3]) : 200000;
+
+  auto mesh = CADMesh::TessellatedMesh::From(fileName);
+
+  auto seconds = [](std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  CADMesh::Decimator::SetDefaultTolerance(0.);
+  auto start = std::chrono::steady_clock::now();
+  auto solids  = mesh->GetSolids();
+  double buildTime = seconds(start);
+
+  CADMesh::Decimator::SetDefaultTolerance(tolerance);
+  start = std::chrono::steady_clock::now();
+  auto reduced = mesh->GetSolids();                // prints the facets and sampled deviation of every part
+  double decimateTime = seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  mesh->GetSolids();                               // from the DecimationCache, as at a geometry rebuild
+  double rebuildTime = seconds(start);
+
+  std::cout << "\nsolids built in " << buildTime << " s, decimated in " << decimateTime
+            << " s, rebuilt from the decimation cache in " << rebuildTime << " s" << std::endl;
+
+  std::cout << "\n" << std::left << std::setw(24) << "part" << std::right
+            << std::setw(10) << "facets" << std::setw(10) << "decimated"
+            << std::setw(14) << "steps/s" << std::setw(14) << "decimated" << std::setw(10) << "speedup" << std::endl;
+  for (std::size_t i = 0; i < solids.size() && i < reduced.size(); i++) {
+    auto rays = MakeRays(solids[i], nbOfRays);
+    double before = Navigate(solids[i], rays);
+    double after  = Navigate(reduced[i], rays);
+    std::cout << std::left << std::setw(24) << solids[i]->GetName() << std::right
+              << std::setw(10) << ((G4TessellatedSolid*)solids[i])->GetNumberOfFacets()
+              << std::setw(10) << ((G4TessellatedSolid*)reduced[i])->GetNumberOfFacets()
+              << std::setw(14) << std::setprecision(3) << before << std::setw(14) << after
+              << std::setw(9) << std::fixed << std::setprecision(2) << after/before << "x" << std::defaultfloat << std::endl;
+  }
+  return 0;
+}
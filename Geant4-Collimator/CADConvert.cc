@@ -0,0 +1,77 @@
+/*
+Converter of CAD files into the binary mesh format of CADMesh (.cmb, see File::WriteBinary in include/CADMeshExtensions.hh).
+The parts of an assembly keep their names, so GetSolid("Ring") works on the converted file as on the original. The
+geometry loads the binary file with CADMesh::TessellatedMesh::From("./FaradayCupMobile.cmb"): it is memory-mapped
+instead of tokenized, the load time is then mostly the construction of the facets.
+
+The converted file is read back and compared part by part, and the load times of both files are printed.
+
+usage: CADConvert input.obj|.stl|.ply [output.cmb]
+       the output is the input with the extension .cmb if not given
+*/
+
+#include "CADMesh.hh"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+  // reads a file with the built-in readers, the time in s
+  CADMesh::Meshes Load(const std::string& fileName, double& seconds)
+  {
+    auto start = std::chrono::steady_clock::now();
+    auto reader = CADMesh::File::BuiltIn();
+    reader->Read(fileName);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return reader->GetMeshes();
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc > 3) {
+    std::cerr << "usage: CADConvert input.obj|.stl|.ply [output.cmb]" << std::endl;
+    return 1;
+  }
+  std::string input  = argv[1];
+  std::string output = (argc == 3) ? std::string(argv[2]) : input.substr(0, input.find_last_of('.')) + ".cmb";
+
+  if (CADMesh::File::TypeFromName(output) != CADMesh::File::CMB) {
+    std::cerr << "CADConvert: the output file needs the extension .cmb" << std::endl;
+    return 1;
+  }
+
+  double textTime = 0., binaryTime = 0.;
+  auto meshes = Load(input, textTime);
+  if (!CADMesh::File::WriteBinary(meshes, output)) {
+    std::cerr << "CADConvert: can not write " << output << std::endl;
+    return 2;
+  }
+  auto converted = Load(output, binaryTime);
+
+  G4bool ok = (converted.size() == meshes.size());
+  std::size_t nbOfFacets = 0;
+  std::cout << std::left << std::setw(32) << "part" << std::right << std::setw(10) << "facets" << std::endl;
+  for (std::size_t i = 0; i < meshes.size(); i++) {
+    std::size_t facets = meshes[i]->GetTriangles().size();
+    nbOfFacets += facets;
+    std::cout << std::left << std::setw(32) << meshes[i]->GetName() << std::right << std::setw(10) << facets << std::endl;
+    if (i < converted.size()) {
+      ok = ok && converted[i]->GetName() == meshes[i]->GetName() && converted[i]->GetTriangles().size() == facets;
+    }
+  }
+  std::cout << meshes.size() << " parts, " << nbOfFacets << " facets written to " << output << "\n"
+            << std::fixed << std::setprecision(1)
+            << "load time " << input << ": " << textTime*1000. << " ms, " << output << ": " << binaryTime*1000. << " ms"
+            << std::endl;
+
+  if (!ok) {
+    std::cerr << "CADConvert: " << output << " does not read back the same parts" << std::endl;
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,550 @@
+/*
+Offline merger for the output of ColliRotate.
+
+Without ntuple merging (/custom/output/mergeNtuples false) every worker thread writes its own ROOT file
+(ID_..._t0.root, ID_..._t1.root, ...) and the end of the run does not wait for the master to collect all rows.
+This program merges such files afterwards - also files of separate processes or nodes, as long as they were
+written by ColliRotate:
+  - histograms (named with --h1 / --h2) are added bin by bin
+  - the ntuples PS, N_SD1, g_SD1, N_SD2, g_SD2 are concatenated
+  - the rows of columnar .hits files (see HitFile.hh) are concatenated into <output>.hits
+  - the partial results of a sharded run (Output/Shards/shard_<i>_of_<N>.txt, see RunControl.cc) are checked for
+    completeness and added up into <output>.shards.txt, which has the same format (shard 0 of 1), so merged results
+    can be merged again. The ROOT and hit files listed in the shard files are merged as well.
+
+The ROOT files are read with the Geant4 analysis reader, so no ROOT installation is needed. With -j N the inputs are
+split into N groups which are merged by N child processes into temporary files; the parent merges those.
+
+usage: ColliMerge [-j N] [--h1 name]... [--h2 name]... -o merged.root inputs...
+       inputs are files, folders (all .root, .hits and shard files below them), shard files or manifest.txt files
+       of the processes (Output/Runs/<tag>/manifest.txt, see OutputNaming.cc)
+*/
+
+#include "Analysis.hh"
+#include "HitFile.hh"
+
+#include "G4RootAnalysisReader.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+
+namespace {
+
+  // the ntuples booked in RunAction.cc: name, title, column names
+  struct NtupleSchema {
+    std::string              fName;
+    std::string              fTitle;
+    std::vector<std::string> fColumns;
+  };
+
+  const std::vector<NtupleSchema> kNtuples = {
+    { "PS",    "Primitive Scorer",     { "TrackLength" } },
+    { "N_SD1", "N_Sensitive Detector", { "N_Ekin", "N_Xpos", "N_Ypos", "N_time" } },
+    { "g_SD1", "g_Sensitive Detector", { "g_Ekin", "g_Xpos", "g_Ypos", "g_time" } },
+    { "N_SD2", "N_Sensitive Detector", { "N_Ekin", "N_Xpos", "N_Ypos", "N_time" } },
+    { "g_SD2", "g_Sensitive Detector", { "g_Ekin", "g_Xpos", "g_Ypos", "g_time" } }
+  };
+
+
+  const std::string kShardMagic = "ColliRotateShard 1";
+
+  G4bool IsShardFile(const fs::path& path)
+  {
+    if (path.extension() != ".txt") return false;
+    std::ifstream in(path);
+    std::string line;
+    return std::getline(in, line) && line == kShardMagic;
+  }
+
+
+  // collect the .root, .hits and shard files of the inputs - every file only once
+  void CollectInputs(const std::vector<std::string>& inputs, std::vector<std::string>& rootFiles,
+                     std::vector<std::string>& hitFiles, std::vector<std::string>& shardFiles)
+  {
+    std::set<fs::path> seen;
+    auto add = [&](const fs::path& path) {
+      std::error_code ec;
+      fs::path canonical = fs::weakly_canonical(path, ec);
+      if (!seen.insert(ec ? path : canonical).second) return;
+      if      (path.extension() == ".root") rootFiles.push_back(path.string());
+      else if (path.extension() == ".hits") hitFiles.push_back(path.string());
+      else if (IsShardFile(path))           shardFiles.push_back(path.string());
+    };
+
+    // a shard file and the files it lists, relative to the job directory three levels above Output/Shards/
+    auto addShard = [&](const fs::path& shardFile) {
+      add(shardFile);
+      fs::path jobDir = shardFile.parent_path().parent_path().parent_path();
+      std::ifstream shard(shardFile);
+      std::string line;
+      while (std::getline(shard, line)) {
+        if (line == "run") break;
+        if (line.compare(0, 5, "file ") != 0) continue;
+        std::string path = line.substr(5);
+        if (!fs::exists(path) && fs::exists(jobDir / path)) path = (jobDir / path).string();
+        add(path);
+      }
+    };
+
+    for ( const auto& input : inputs ) {
+      if (IsShardFile(input)) addShard(input);
+      else if (fs::path(input).filename() == "manifest.txt") {
+        // "file <kind> <path>" lines; the paths are relative to the working directory of the job,
+        // which is three levels above Output/Runs/<tag>/
+        fs::path jobDir = fs::path(input).parent_path().parent_path().parent_path().parent_path();
+        std::ifstream manifest(input);
+        std::string line;
+        while (std::getline(manifest, line)) {
+          std::istringstream is(line);
+          std::string key, kind, path;
+          is >> key >> kind >> std::ws;
+          std::getline(is, path);
+          if (key != "file" || path.empty()) continue;
+          if (!fs::exists(path) && fs::exists(jobDir / path)) path = (jobDir / path).string();
+          add(path);
+        }
+      }
+      else if (fs::is_directory(input)) {
+        for ( const auto& entry : fs::recursive_directory_iterator(input) ) {
+          if      (!entry.is_regular_file())   continue;
+          else if (IsShardFile(entry.path())) addShard(entry.path());
+          else                                add(entry.path());
+        }
+      }
+      else add(input);
+    }
+  }
+
+
+  // merge ROOT files into one - runs in one process, the Geant4 analysis managers are not shared
+  G4bool MergeRootFiles(const std::vector<std::string>& files, const std::string& output,
+                        const std::vector<std::string>& h1Names, const std::vector<std::string>& h2Names)
+  {
+    auto reader  = G4RootAnalysisReader::Instance();
+    auto manager = G4AnalysisManager::Instance();
+    reader->SetVerboseLevel(0);
+
+    // histograms: sum up in memory, book with the binning of the first file
+    std::map<std::string, tools::histo::h1d> h1Sums;
+    std::map<std::string, tools::histo::h2d> h2Sums;
+    for ( const auto& file : files ) {
+      for ( const auto& name : h1Names ) {
+        G4int id = reader->ReadH1(name, file);
+        if (id < 0) continue;
+        auto h1 = reader->GetH1(id);
+        auto it = h1Sums.find(name);
+        if (it == h1Sums.end()) h1Sums.emplace(name, *h1);
+        else it->second.add(*h1);
+      }
+      for ( const auto& name : h2Names ) {
+        G4int id = reader->ReadH2(name, file);
+        if (id < 0) continue;
+        auto h2 = reader->GetH2(id);
+        auto it = h2Sums.find(name);
+        if (it == h2Sums.end()) h2Sums.emplace(name, *h2);
+        else it->second.add(*h2);
+      }
+    }
+
+    if (!manager->OpenFile(output)) return false;
+
+    for ( const auto& h1Sum : h1Sums ) {
+      const auto& axis = h1Sum.second.axis();
+      G4int id = manager->CreateH1(h1Sum.first, h1Sum.second.title(),
+                                   axis.bins(), axis.lower_edge(), axis.upper_edge());
+      *manager->GetH1(id) = h1Sum.second;
+    }
+    for ( const auto& h2Sum : h2Sums ) {
+      const auto& xAxis = h2Sum.second.axis_x();
+      const auto& yAxis = h2Sum.second.axis_y();
+      G4int id = manager->CreateH2(h2Sum.first, h2Sum.second.title(),
+                                   xAxis.bins(), xAxis.lower_edge(), xAxis.upper_edge(),
+                                   yAxis.bins(), yAxis.lower_edge(), yAxis.upper_edge());
+      *manager->GetH2(id) = h2Sum.second;
+    }
+
+    // ntuples: same booking as RunAction.cc, then copy the rows file by file
+    for ( const auto& schema : kNtuples ) {
+      manager->CreateNtuple(schema.fName, schema.fTitle);
+      for ( const auto& column : schema.fColumns ) manager->CreateNtupleDColumn(column);
+      manager->FinishNtuple();
+    }
+
+    G4double values[4];
+    for ( const auto& file : files ) {
+      for (size_t n = 0; n < kNtuples.size(); n++) {
+        const NtupleSchema& schema = kNtuples[n];
+        G4int id = reader->GetNtuple(schema.fName, file);
+        if (id < 0) continue;
+        for (size_t c = 0; c < schema.fColumns.size(); c++) reader->SetNtupleDColumn(id, schema.fColumns[c], values[c]);
+
+        while (reader->GetNtupleRow(id)) {
+          for (size_t c = 0; c < schema.fColumns.size(); c++) manager->FillNtupleDColumn(n, c, values[c]);
+          manager->AddNtupleRow(n);
+        }
+      }
+    }
+
+    manager->Write();
+    manager->CloseFile();
+    return true;
+  }
+
+
+  // concatenate columnar hit files - the rows are re-chunked by the writer, the value size must agree
+  G4bool MergeHitFiles(const std::vector<std::string>& files, const std::string& output)
+  {
+    HitFileWriter writer;
+    G4bool open = false;
+    uint32_t valueSize = 0;
+
+    for ( const auto& file : files ) {
+      HitFileReader reader;
+      if (!reader.Open(file)) {
+        std::cerr << "ColliMerge: can not read " << file << std::endl;
+        continue;
+      }
+      if (!open) {
+        valueSize = reader.GetValueSize();
+        std::string text = reader.GetText() + "mergedFiles " + std::to_string(files.size()) + "\n";
+        if (!writer.Open(output, valueSize, text)) return false;
+        open = true;
+      }
+      if (reader.GetValueSize() != valueSize) {
+        std::cerr << "ColliMerge: " << file << " has a different value size, skipped" << std::endl;
+        continue;
+      }
+
+      for ( const auto& chunk : reader.GetChunks() ) {
+        for (uint32_t row = 0; row < chunk.fRows; row++) {
+          writer.Fill(chunk.fTable, chunk.fEvents[row],
+                      reader.GetValue(chunk, 0, row), reader.GetValue(chunk, 1, row),
+                      reader.GetValue(chunk, 2, row), reader.GetValue(chunk, 3, row));
+        }
+      }
+    }
+    writer.Close();
+    return open;
+  }
+
+
+  // the partial result of one shard: header and the state of the Run (Run::WriteState)
+  struct ParticleSums {
+    long   fCount = 0;
+    double fEsum  = 0., fEmin = std::numeric_limits<double>::max(), fEmax = 0., fTmean = -1.;
+  };
+
+  struct ShardResult {
+    int    fIndex = 0, fNbOfShards = 0;
+    long   fBaseSeed = 0, fEventsTotal = 0, fFirstEvent = 0, fEvents = 0;
+    std::vector<std::string> fHeader;                    // tag and file lines, kept for the merged file
+    long   fRunEvents = 0;
+    double fEdep = 0., fEdep2 = 0., fEflow = 0., fEflow2 = 0.;
+    std::vector<long> fTallies;
+    std::map<std::string, long>                fProcesses;
+    std::map<std::string, ParticleSums>        fCreated, fFlux;
+    std::map<std::string, std::array<double,3>> fKilled;
+
+    G4bool Read(const std::string& fileName);
+    void   Add(const ShardResult& other);
+    void   Write(std::ostream& out) const;
+  };
+
+
+  G4bool ShardResult::Read(const std::string& fileName)
+  {
+    std::ifstream in(fileName);
+    std::string line;
+    if (!std::getline(in, line) || line != kShardMagic) return false;
+
+    // header up to "run"
+    while (std::getline(in, line) && line != "run") {
+      std::istringstream is(line);
+      std::string key;
+      is >> key;
+      if      (key == "shard")       is >> fIndex >> fNbOfShards;
+      else if (key == "baseSeed")    is >> fBaseSeed;
+      else if (key == "eventsTotal") is >> fEventsTotal;
+      else if (key == "firstEvent")  is >> fFirstEvent;
+      else if (key == "events")      is >> fEvents;
+      else fHeader.push_back(line);
+    }
+
+    // same keys as Run::ReadState
+    std::string key;
+    while (in >> key) {
+      if (key == "endrun") return true;
+
+      if      (key == "events") in >> fRunEvents;
+      else if (key == "edep")   in >> fEdep  >> fEdep2;
+      else if (key == "eflow")  in >> fEflow >> fEflow2;
+      else if (key == "tallies") {
+        std::getline(in, line);
+        std::istringstream is(line);
+        long tally;
+        while (is >> tally) fTallies.push_back(tally);
+      }
+      else if (key == "process") {
+        std::string name; long count;
+        in >> name >> count;
+        fProcesses[name] += count;
+      }
+      else if (key == "created" || key == "flux") {
+        std::string name; ParticleSums data;
+        in >> name >> data.fCount >> data.fEsum >> data.fEmin >> data.fEmax >> data.fTmean;
+        (key == "created" ? fCreated : fFlux)[name] = data;
+      }
+      else if (key == "killed") {
+        std::string name; std::array<double,3> data;
+        in >> name >> data[0] >> data[1] >> data[2];
+        fKilled[name] = data;
+      }
+      else return false;
+    }
+    return false;
+  }
+
+
+  // sums, sums of squares and counts simply add up; min/max as in Run::Merge
+  void ShardResult::Add(const ShardResult& other)
+  {
+    fEvents    += other.fEvents;
+    fRunEvents += other.fRunEvents;
+    fEdep  += other.fEdep;   fEdep2  += other.fEdep2;
+    fEflow += other.fEflow;  fEflow2 += other.fEflow2;
+    if (fTallies.size() < other.fTallies.size()) fTallies.resize(other.fTallies.size(), 0);
+    for (size_t i = 0; i < other.fTallies.size(); i++) fTallies[i] += other.fTallies[i];
+
+    for ( const auto& process : other.fProcesses ) fProcesses[process.first] += process.second;
+
+    auto addParticles = [](std::map<std::string, ParticleSums>& to, const std::map<std::string, ParticleSums>& from) {
+      for ( const auto& particle : from ) {
+        ParticleSums& data = to[particle.first];
+        data.fCount += particle.second.fCount;
+        data.fEsum  += particle.second.fEsum;
+        data.fEmin   = std::min(data.fEmin, particle.second.fEmin);
+        data.fEmax   = std::max(data.fEmax, particle.second.fEmax);
+        data.fTmean  = particle.second.fTmean;
+      }
+    };
+    addParticles(fCreated, other.fCreated);
+    addParticles(fFlux,    other.fFlux);
+
+    for ( const auto& killed : other.fKilled ) {
+      auto& data = fKilled[killed.first];
+      for (size_t i = 0; i < 3; i++) data[i] += killed.second[i];
+    }
+  }
+
+
+  void ShardResult::Write(std::ostream& out) const
+  {
+    out << std::setprecision(std::numeric_limits<double>::max_digits10);
+    out << kShardMagic << "\n";
+    out << "shard "       << fIndex << " " << fNbOfShards << "\n";
+    out << "baseSeed "    << fBaseSeed    << "\n";
+    out << "eventsTotal " << fEventsTotal << "\n";
+    out << "firstEvent "  << fFirstEvent  << "\n";
+    out << "events "      << fEvents      << "\n";
+    for ( const auto& line : fHeader ) out << line << "\n";
+    out << "run\n";
+    out << "events " << fRunEvents << "\n";
+    out << "edep "   << fEdep  << " " << fEdep2  << "\n";
+    out << "eflow "  << fEflow << " " << fEflow2 << "\n";
+    out << "tallies";
+    for ( auto tally : fTallies ) out << " " << tally;
+    out << "\n";
+    for ( const auto& process : fProcesses ) out << "process " << process.first << " " << process.second << "\n";
+    for ( const auto& particle : fCreated ) {
+      const ParticleSums& data = particle.second;
+      out << "created " << particle.first << " " << data.fCount << " " << data.fEsum << " "
+          << data.fEmin << " " << data.fEmax << " " << data.fTmean << "\n";
+    }
+    for ( const auto& particle : fFlux ) {
+      const ParticleSums& data = particle.second;
+      out << "flux " << particle.first << " " << data.fCount << " " << data.fEsum << " "
+          << data.fEmin << " " << data.fEmax << " " << data.fTmean << "\n";
+    }
+    for ( const auto& killed : fKilled ) {
+      out << "killed " << killed.first << " " << (long)killed.second[0] << " " << (long)killed.second[1]
+          << " " << killed.second[2] << "\n";
+    }
+    out << "endrun\n";
+  }
+
+
+  // add up the shards of one sharded run; they must agree on seed and event count and cover the run exactly once
+  G4bool MergeShards(const std::vector<std::string>& files, const std::string& output)
+  {
+    std::vector<ShardResult> shards;
+    for ( const auto& file : files ) {
+      ShardResult shard;
+      if (!shard.Read(file)) {
+        std::cerr << "ColliMerge: " << file << " is not a complete shard result, skipped" << std::endl;
+        continue;
+      }
+      shards.push_back(shard);
+    }
+    if (shards.empty()) return false;
+
+    std::sort(shards.begin(), shards.end(),
+              [](const ShardResult& a, const ShardResult& b) { return a.fFirstEvent < b.fFirstEvent; });
+
+    G4bool ok = true;
+    const ShardResult& first = shards.front();
+    long nextEvent = 0;
+    for ( const auto& shard : shards ) {
+      if (shard.fBaseSeed != first.fBaseSeed || shard.fEventsTotal != first.fEventsTotal) {
+        std::cerr << "ColliMerge: shard " << shard.fIndex << " belongs to another run (seed " << shard.fBaseSeed
+                  << ", " << shard.fEventsTotal << " events)" << std::endl;
+        return false;
+      }
+      if (shard.fFirstEvent > nextEvent) {
+        std::cerr << "ColliMerge: events " << nextEvent << " to " << shard.fFirstEvent - 1 << " are missing" << std::endl;
+        ok = false;
+      }
+      else if (shard.fFirstEvent < nextEvent) {
+        std::cerr << "ColliMerge: events " << shard.fFirstEvent << " to " << nextEvent - 1
+                  << " are in more than one shard" << std::endl;
+        ok = false;
+      }
+      nextEvent = std::max(nextEvent, shard.fFirstEvent + shard.fEvents);
+    }
+    if (nextEvent != first.fEventsTotal) {
+      std::cerr << "ColliMerge: events " << nextEvent << " to " << first.fEventsTotal - 1 << " are missing" << std::endl;
+      ok = false;
+    }
+
+    ShardResult total = first;
+    for (size_t i = 1; i < shards.size(); i++) total.Add(shards[i]);
+    total.fIndex      = 0;
+    total.fNbOfShards = 1;
+    total.fHeader.clear();
+    for ( const auto& shard : shards ) {
+      total.fHeader.push_back("merged " + std::to_string(shard.fIndex) + " " + std::to_string(shard.fNbOfShards));
+    }
+
+    // summary: means per event with their standard errors
+    double n = total.fRunEvents;
+    auto summary = [](const std::string& name, double mean, double error) {
+      std::cout << "  " << std::left << std::setw(22) << name << mean << " +- " << error << std::endl;
+    };
+    std::cout << "ColliMerge: " << shards.size() << " shards, " << total.fRunEvents << " of "
+              << total.fEventsTotal << " events, seed " << total.fBaseSeed << std::endl;
+    if (total.fRunEvents > 0) {
+      double edep  = total.fEdep/n,  edepRms  = std::sqrt(std::max(0., total.fEdep2/n  - edep*edep));
+      double eflow = total.fEflow/n, eflowRms = std::sqrt(std::max(0., total.fEflow2/n - eflow*eflow));
+      summary("edep / event [MeV]",  edep,  edepRms/std::sqrt(n));
+      summary("eflow / event [MeV]", eflow, eflowRms/std::sqrt(n));
+      // the tallies are counts: Poisson errors
+      const char* tallyNames[] = { "SD1 neutrons / event", "SD2 gammas / event" };
+      for (size_t i = 0; i < total.fTallies.size() && i < 2; i++) {
+        summary(tallyNames[i], total.fTallies[i]/n, std::sqrt((double)total.fTallies[i])/n);
+      }
+    }
+
+    std::ofstream out(output);
+    total.Write(out);
+    std::cout << "ColliMerge: wrote " << output << (ok ? "" : " (incomplete)") << std::endl;
+    return ok;
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  G4int nofJobs = 1;
+  std::string output;
+  std::vector<std::string> inputs, h1Names, h2Names;
+
+  for (G4int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if      (arg == "-j"   && i+1 < argc) nofJobs = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "-o"   && i+1 < argc) output  = argv[++i];
+    else if (arg == "--h1" && i+1 < argc) h1Names.push_back(argv[++i]);
+    else if (arg == "--h2" && i+1 < argc) h2Names.push_back(argv[++i]);
+    else inputs.push_back(arg);
+  }
+
+  if (output.empty() || inputs.empty()) {
+    std::cerr << "usage: ColliMerge [-j N] [--h1 name]... [--h2 name]... -o merged.root inputs..." << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> rootFiles, hitFiles, shardFiles;
+  CollectInputs(inputs, rootFiles, hitFiles, shardFiles);
+  std::cout << "ColliMerge: " << rootFiles.size() << " ROOT files, " << hitFiles.size() << " hit files, "
+            << shardFiles.size() << " shard results" << std::endl;
+
+  // an incomplete set of shards is still added up, but reported by the exit code
+  G4bool shardsOk = true;
+  if (!shardFiles.empty()) {
+    shardsOk = MergeShards(shardFiles, fs::path(output).replace_extension(".shards.txt").string());
+  }
+
+  // the hit files are plain copies, no need for children
+  if (!hitFiles.empty()) {
+    std::string hitOutput = fs::path(output).replace_extension(".hits").string();
+    if (!MergeHitFiles(hitFiles, hitOutput)) std::cerr << "ColliMerge: no hit file written" << std::endl;
+    else std::cout << "ColliMerge: wrote " << hitOutput << std::endl;
+  }
+
+  if (rootFiles.empty()) return shardsOk ? 0 : 2;
+
+  nofJobs = std::min<G4int>(nofJobs, rootFiles.size());
+  if (nofJobs == 1) return !MergeRootFiles(rootFiles, output, h1Names, h2Names) ? 1 : (shardsOk ? 0 : 2);
+
+  // every child merges every nofJobs-th file into a part file
+  std::vector<std::string> parts;
+  std::vector<pid_t> children;
+  for (G4int job = 0; job < nofJobs; job++) {
+    std::string part = output + ".part" + std::to_string(job) + ".root";
+    parts.push_back(part);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      std::vector<std::string> files;
+      for (size_t i = job; i < rootFiles.size(); i += nofJobs) files.push_back(rootFiles[i]);
+      _exit(MergeRootFiles(files, part, h1Names, h2Names) ? 0 : 1);
+    }
+    if (pid < 0) {
+      std::cerr << "ColliMerge: fork failed" << std::endl;
+      return 1;
+    }
+    children.push_back(pid);
+  }
+
+  G4bool ok = true;
+  for ( auto child : children ) {
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+  }
+  if (!ok) {
+    std::cerr << "ColliMerge: a merge job failed, the part files are kept" << std::endl;
+    return 1;
+  }
+
+  ok = MergeRootFiles(parts, output, h1Names, h2Names);
+  for ( const auto& part : parts ) fs::remove(part);
+
+  if (ok) std::cout << "ColliMerge: wrote " << output << std::endl;
+  return !ok ? 1 : (shardsOk ? 0 : 2);
+}
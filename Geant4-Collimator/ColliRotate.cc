@@ -1,3 +1,7 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
 #if __unix__                              // for checking if the code shall be compiled on an UNIX system
 #include <unistd.h>                       //To use getpid() to get the process ID to use as random seed on UNIX systems
 #endif
@@ -8,6 +12,17 @@
 #include "DetectorConstruction.hh"        //This is where you define your Geometry and Scorers
 #include "PhysicsList.hh"                 //This is where you define what physics processes should be used, alternatively you can choose a complete physics list in this file
 #include "ActionInitialization.hh"        //This is where you define what the simulation does (...)
+#include "RunControl.hh"                  //segmented runs with checkpoints (/custom/run/ commands)
+#include "OutputWriter.hh"                //asynchronous hit output (/custom/output/ commands)
+#include "OutputNaming.hh"                //unique output file names and the manifest of this process
+#include "ProcessPool.hh"                 //forked processes sharing the initialized physics (--prefork)
+#include "Benchmark.hh"                   //thread-scaling benchmark (--benchmark)
+#include "LoopCounters.hh"                //event-loop counters (/custom/loop/ commands)
+#include "EventWatchdog.hh"               //reports and replay of slow events (/custom/watchdog/ commands)
+#include "StepProfiler.hh"                //steps and CPU time per volume, particle and process (/custom/profile/ commands)
+#include "PerfCounters.hh"                //hardware performance counters per event and callback (/custom/perf/ commands)
+#include "Tracer.hh"                      //timeline of the run phases as Chrome trace (--trace, /custom/trace/ commands)
+#include "StepRecorder.hh"                //binary step traces instead of /tracking/verbose (/custom/record/ commands)
 
 #include "G4Version.hh"                   //for checking which Geant4 version is installed
 #if G4VERSION_NUMBER>=1070
@@ -52,10 +67,68 @@
 
 int main(int argc,char** argv) {
 
-  // Detect interactive mode (if no arguments) and define UI session
+  // Command line: ColliRotate [--shard i/N] [--seed S] [--events T] [macro]
+  // With --events the macro only sets up the run; afterwards T events are run as /custom/run/beamOn T.
+  // In a job array every task runs the same command with its own i, e.g. --shard ${SLURM_ARRAY_TASK_ID}/100,
+  // and ColliMerge combines Output/Shards/shard_*_of_100.txt - see RunControl.cc
+  //
+  // Pre-fork pool: ColliRotate --prefork [--jobs J] setup.mac job1.mac job2.mac:energy=14,unit=MeV ...
+  // setup.mac initializes geometry and physics once, then every job macro runs in a forked process, at most J at
+  // a time. The values after the colon are set with /control/alias - see ProcessPool.cc
+  //
+  // Benchmark: ColliRotate --benchmark --threads N [--events E] [--seed S] [--csv scaling.csv] bench.mac
+  // one measured fixed-seed run at N threads, appended to the CSV file - see Benchmark.cc and ScalingBenchmark.py
+  //
+  // Timeline: ColliRotate --trace ... writes Output/Trace/trace_<tag>.json at the end - see Tracer.cc
+  G4String macroFile;
+  G4int shardIndex = 0, nofShards = 0;
+  G4long globalSeed = 0, totalEvents = 0;
+  G4bool prefork = false;
+  G4int maxJobs = 0;
+  G4bool benchmark = false;
+  G4int nofThreads = 1;
+  G4String csvFile = "scaling.csv";
+  G4bool trace = false;
+  std::vector<G4String> jobs;
+  for (G4int i = 1; i < argc; i++) {
+    G4String arg = argv[i];
+    if (arg == "--shard" && i+1 < argc) {
+      // a job array task which ran all events would count them twice in the merge
+      if (std::sscanf(argv[++i], "%d/%d", &shardIndex, &nofShards) != 2
+          || nofShards < 1 || shardIndex < 0 || shardIndex >= nofShards) {
+        G4cerr << "ColliRotate: --shard expects i/N with 0 <= i < N, e.g. --shard 3/100, got " << argv[i] << G4endl;
+        return 1;
+      }
+    }
+    else if (arg == "--seed"   && i+1 < argc) globalSeed  = std::atol(argv[++i]);
+    else if (arg == "--events" && i+1 < argc) totalEvents = std::atol(argv[++i]);
+    else if (arg == "--prefork")              prefork     = true;
+    else if (arg == "--jobs"   && i+1 < argc) maxJobs     = std::atoi(argv[++i]);
+    else if (arg == "--benchmark")            benchmark   = true;
+    else if (arg == "--threads" && i+1 < argc) nofThreads = std::atoi(argv[++i]);
+    else if (arg == "--csv"    && i+1 < argc) csvFile     = argv[++i];
+    else if (arg == "--trace")                trace       = true;
+    else if (macroFile.empty())               macroFile   = arg;
+    else                                      jobs.push_back(arg);
+  }
+  if (prefork && (macroFile.empty() || jobs.empty())) {
+    G4cerr << "ColliRotate: --prefork expects a setup macro and at least one job macro" << G4endl;
+    return 1;
+  }
+
+  // spans of the run phases from here on - see Tracer.cc
+  Tracer* tracer = new Tracer(trace);
+  G4double setupStart = Tracer::Now();
+
+  // the setup time of the pool counts from here
+  ProcessPool* pool = prefork ? new ProcessPool(maxJobs) : nullptr;
+  Benchmark* bench = benchmark ? new Benchmark(nofThreads, totalEvents > 0 ? totalEvents : 10000,
+                                               globalSeed > 0 ? globalSeed : 12345, csvFile) : nullptr;
+
+  // Detect interactive mode (if no macro) and define UI session
   //
   G4UIExecutive* ui = 0;
-  if ( argc == 1 ) {
+  if ( macroFile.empty() ) {
     ui = new G4UIExecutive(argc, argv);
   }
 
@@ -94,13 +167,15 @@ int main(int argc,char** argv) {
   #if G4VERSION_NUMBER>=1070
     // Construct the default run manager in Geant4 Version > 10.7.0
     // Auto detect if singlethreaded mode or multithreaded mode is used
-    auto* runManager = G4RunManagerFactory::CreateRunManager(G4RunManagerType::Default);
+    // The pool forks the process, which only keeps the calling thread: sequential run manager
+    auto* runManager = G4RunManagerFactory::CreateRunManager(prefork ? G4RunManagerType::Serial
+                                                                     : G4RunManagerType::Default);
 
   #else
     //for Geant4 Versions < 10.7 use this!
     //check if Geant4 is built with multithread option
     #ifdef G4MULTITHREADED
-      G4MTRunManager* runManager = new G4MTRunManager;
+      G4RunManager* runManager = prefork ? new G4RunManager : new G4MTRunManager;
     #else
       //my Verbose output class
       G4VSteppingVerbose::SetInstance(new SteppingVerbose);
@@ -146,8 +221,35 @@ int main(int argc,char** argv) {
   runManager->SetUserInitialization(physicsList);
   G4HadronicProcessStore::Instance()->SetVerbose(0);
 
+  // output file names - see OutputNaming.cc. Before the actions: the RunAction of the master is built in
+  // SetUserInitialization and opens its file there if SaveEachRunInSeparateFile is false
+  OutputNaming* outputNaming = new OutputNaming;
+
   runManager->SetUserInitialization(new ActionInitialization(det));
 
+  // segmented runs with checkpoints and resume - see RunControl.cc
+  RunControl* runControl = new RunControl(det);
+  if (nofShards > 0)  runControl->SetShard(shardIndex, nofShards);
+  if (globalSeed > 0) runControl->SetBaseSeed(globalSeed);
+
+  // writer thread for the SD hits - see OutputWriter.cc
+  OutputWriter* outputWriter = new OutputWriter;
+
+  // counters of events, tracks and steps per thread - see LoopCounters.cc
+  LoopCounters* loopCounters = new LoopCounters;
+
+  // slow events with their random engine state - see EventWatchdog.cc
+  EventWatchdog* eventWatchdog = new EventWatchdog;
+
+  // where the steps and the CPU time go - see StepProfiler.cc
+  StepProfiler* stepProfiler = new StepProfiler;
+
+  // cycles, instructions, cache and branch misses - see PerfCounters.cc
+  PerfCounters* perfCounters = new PerfCounters;
+
+  // compressed step records for debugging - see StepRecorder.cc
+  StepRecorder* stepRecorder = new StepRecorder;
+
   // Replaced HP (high-precision) environmental variables with C++ calls
   //
   //SkipMissingIsotopes: It sets to zero the cross section of the isotopes which are not present in the neutron library. If GEANT4 doesn’t find an isotope, 
@@ -193,13 +295,26 @@ int main(int argc,char** argv) {
   UImanager->ApplyCommand(G4String("/tracking/verbose 0"));
   UImanager->ApplyCommand(G4String("/stepping/verbose 0"));
 
+  if (Tracer::IsEnabled()) Tracer::Add("setup", setupStart);
+
   // Process macro or start UI session
   // A UI session is started if the program is execute without a macro file.
   if ( ! ui ) { 
     // batch mode
     G4String command = "/control/execute ";
-    G4String fileName = argv[1];
-    UImanager->ApplyCommand(command+fileName);
+    if (bench) {
+      if (!bench->Run(macroFile)) G4cout << "\n--> warning from ColliRotate : benchmark failed" << G4endl;
+    }
+    else {
+      { Tracer::Span span("macro"); UImanager->ApplyCommand(command+macroFile); }
+      if (totalEvents > 0) runControl->BeamOn(totalEvents);
+    }
+
+    if (pool) {
+      for ( const auto& job : jobs ) pool->AddJob(job);
+      G4int failed = pool->Run();
+      if (failed > 0) G4cout << "\n--> warning from ColliRotate : " << failed << " pool jobs failed" << G4endl;
+    }
   }
   else { 
     // interactive mode
@@ -213,7 +328,20 @@ int main(int argc,char** argv) {
   // owned and deleted by the run manager, so they should not be deleted 
   // in the main() program !
   
+  if (Tracer::IsEnabled()) tracer->Write();
+
+  delete bench;
+  delete pool;
+  delete stepRecorder;
+  delete perfCounters;
+  delete stepProfiler;
+  delete eventWatchdog;
+  delete loopCounters;
+  delete outputNaming;
+  delete outputWriter;
+  delete runControl;
   delete visManager;
   delete runManager;
+  delete tracer;
 }
 
@@ -0,0 +1,71 @@
+#Thread-scaling benchmark of ColliRotate: runs the reference configuration bench.mac with the same seed at several
+#thread counts, one process per thread count, and summarises the CSV written by ColliRotate --benchmark
+#(see src/Benchmark.cc). Also run by 'make benchmark' in the build directory.
+#
+#python3 ScalingBenchmark.py --exe ./ColliRotate --threads 1,2,4,8,16,32,64,128 --events 20000
+#
+#compare against an earlier result, exit code 1 if events/s dropped by more than 10% at any thread count:
+#python3 ScalingBenchmark.py --exe ./ColliRotate --threads 1,4,16,64 --baseline scaling_old.csv --tolerance 0.1
+
+import argparse                     #for the command line
+import csv                          #for reading the results
+import os                           #for removing old results
+import subprocess                   #for running ColliRotate
+import sys                          #for the exit code
+
+
+def read_csv(path):
+    with open(path) as f:
+        return {int(row["threads"]): row for row in csv.DictReader(f)}
+
+
+parser = argparse.ArgumentParser(description="Thread-scaling benchmark of ColliRotate")
+parser.add_argument("--exe",       default="./ColliRotate")
+parser.add_argument("--macro",     default="bench.mac")
+parser.add_argument("--threads",   default="1,2,4,8")
+parser.add_argument("--events",    type=int, default=20000)
+parser.add_argument("--seed",      type=int, default=12345)
+parser.add_argument("--csv",       default="scaling.csv")
+parser.add_argument("--baseline",  default=None)
+parser.add_argument("--tolerance", type=float, default=0.1)
+args = parser.parse_args()
+
+#start with empty result files
+stem = os.path.splitext(args.csv)[0]
+for path in (args.csv, stem + "_threads.csv"):
+    if os.path.exists(path):
+        os.remove(path)
+
+for threads in [int(t) for t in args.threads.split(",")]:
+    print("running", threads, "threads ...", flush=True)
+    with open("%s_%d.log" % (stem, threads), "w") as log:
+        result = subprocess.run([args.exe, "--benchmark", "--threads", str(threads), "--events", str(args.events),
+                                 "--seed", str(args.seed), "--csv", args.csv, args.macro],
+                                stdout=log, stderr=subprocess.STDOUT)
+    if result.returncode != 0:
+        print("  failed, see %s_%d.log" % (stem, threads))
+
+if not os.path.exists(args.csv):
+    sys.exit("no results in " + args.csv)
+
+#speedup and efficiency relative to the smallest thread count
+results = read_csv(args.csv)
+reference = results[min(results)]
+print("\nthreads  events/s  speedup  efficiency  imbalance  merge [s]  peak RSS [MB]")
+for threads in sorted(results):
+    row = results[threads]
+    speedup = float(row["events_per_s"]) / float(reference["events_per_s"])
+    efficiency = speedup * int(reference["threads"]) / threads
+    print("%7d %9.1f %8.2f %11.2f %10.3f %10.2f %14.0f" % (threads, float(row["events_per_s"]), speedup, efficiency,
+          float(row["imbalance"]), float(row["merge_s"]), float(row["peak_rss_MB"])))
+
+#scaling regressions
+if args.baseline:
+    baseline = read_csv(args.baseline)
+    failed = False
+    for threads in sorted(set(results) & set(baseline)):
+        now, before = float(results[threads]["events_per_s"]), float(baseline[threads]["events_per_s"])
+        if now < (1. - args.tolerance) * before:
+            print("REGRESSION at %d threads: %.1f events/s, was %.1f" % (threads, now, before))
+            failed = True
+    sys.exit(1 if failed else 0)
@@ -0,0 +1,172 @@
+/*
+Pretty-printer for the binary step traces of ColliRotate (/custom/record/ commands, see src/StepRecorder.cc and
+include/StepTrace.hh). Prints the steps in the columns of /tracking/verbose 1 (SteppingVerbose.cc), one block per
+track, with the units chosen per value like G4BestUnit.
+
+usage: StepPrint [--event N] [--track N] [--summary] files.steps.gz ...
+       --event / --track print only this event / track, --summary prints the steps per volume and process instead
+*/
+
+#include "StepTrace.hh"
+
+#include "zlib.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+  // value with the unit which keeps it between 1 and 1000, like G4BestUnit
+  std::string BestUnit(double value, const char* const* units, const double* scales, int nbOfUnits)
+  {
+    int i = 0;
+    double magnitude = std::fabs(value);
+    if (magnitude > 0.) {
+      while (i < nbOfUnits - 1 && magnitude >= 1000.*scales[i]) i++;
+    }
+    else {
+      while (i < nbOfUnits - 1 && scales[i] < 1.) i++;       // zero in mm or MeV
+    }
+    std::ostringstream os;
+    os << std::setprecision(3) << std::setw(6) << value/scales[i] << " " << std::left << std::setw(3) << units[i];
+    return os.str();
+  }
+
+  std::string Length(double mm)
+  {
+    static const char* const units[] = { "fm", "nm", "um", "mm", "m", "km" };
+    static const double scales[] = { 1.e-12, 1.e-6, 1.e-3, 1., 1.e3, 1.e6 };
+    return BestUnit(mm, units, scales, 6);
+  }
+
+  std::string Energy(double MeV)
+  {
+    static const char* const units[] = { "meV", "eV", "keV", "MeV", "GeV", "TeV" };
+    static const double scales[] = { 1.e-9, 1.e-6, 1.e-3, 1., 1.e3, 1.e6 };
+    return BestUnit(MeV, units, scales, 6);
+  }
+
+  struct Options {
+    long long event   = -1;
+    long long track   = -1;
+    bool      summary = false;
+  };
+
+  // reads one file; returns false on a broken file
+  bool Print(const std::string& fileName, const Options& options)
+  {
+    gzFile file = gzopen(fileName.c_str(), "rb");
+    if (!file) {
+      std::cerr << "StepPrint: can not open " << fileName << std::endl;
+      return false;
+    }
+    auto read = [&](void* data, unsigned size) { return gzread(file, data, size) == (int)size; };
+
+    char magic[sizeof(StepTrace::kMagic)];
+    if (!read(magic, sizeof(magic)) || std::memcmp(magic, StepTrace::kMagic, sizeof(magic)) != 0) {
+      std::cerr << "StepPrint: " << fileName << " is not a step trace" << std::endl;
+      gzclose(file);
+      return false;
+    }
+    std::cout << "\n=== " << fileName << std::endl;
+
+    std::map<uint16_t,std::string> volumes, processes, particles;
+    std::map<std::pair<std::string,std::string>,long long> counts;     // summary: volume, process
+    StepTrace::EventRecord event = { -1, 0 };
+    StepTrace::TrackRecord track;
+    bool printEvent = false, printTrack = false;
+    bool ok = true;
+
+    uint8_t tag;
+    while (read(&tag, 1)) {
+      if (tag == StepTrace::kVolumeName || tag == StepTrace::kProcessName || tag == StepTrace::kParticleName) {
+        uint16_t header[2];
+        if (!read(header, sizeof(header))) { ok = false; break; }
+        std::string name(header[1], ' ');
+        if (header[1] > 0 && !read(&name[0], header[1])) { ok = false; break; }
+        if (tag == StepTrace::kVolumeName)  volumes[header[0]]   = name;
+        if (tag == StepTrace::kProcessName) processes[header[0]] = name;
+        if (tag == StepTrace::kParticleName) particles[header[0]] = name;
+      }
+      else if (tag == StepTrace::kEvent) {
+        if (!read(&event, sizeof(event))) { ok = false; break; }
+        printEvent = (options.event < 0 || event.fEvent == options.event);
+        if (printEvent && !options.summary)
+          std::cout << "\n********** event " << event.fEvent << "  run " << event.fRun << std::endl;
+      }
+      else if (tag == StepTrace::kTrack) {
+        if (!read(&track, sizeof(track))) { ok = false; break; }
+        printTrack = printEvent && (options.track < 0 || track.fTrackID == options.track);
+        if (!printTrack || options.summary) continue;
+        std::cout << "\n* particle " << particles[track.fParticle] << "  track " << track.fTrackID
+                  << "  parent " << track.fParentID << "\n"
+                  << std::setw(5) << "Step#" << " "
+                  << std::setw(10) << "X" << std::setw(10) << "Y" << std::setw(10) << "Z"
+                  << std::setw(10) << "KineE" << std::setw(10) << "dEStep"
+                  << std::setw(10) << "StepLeng" << std::setw(10) << "TrakLeng"
+                  << std::setw(12) << "Volume" << "  " << "Process" << "\n"
+                  << std::setw(5) << "start" << " "
+                  << Length(track.fX) << Length(track.fY) << Length(track.fZ) << Energy(track.fEkin)
+                  << std::setw(30) << "" << std::setw(12) << volumes[track.fVolume] << "  initStep" << std::endl;
+      }
+      else if (tag == StepTrace::kStep) {
+        StepTrace::StepRecord step;
+        if (!read(&step, sizeof(step))) { ok = false; break; }
+        if (!printTrack) continue;
+
+        std::string process = (step.fProcess == StepTrace::kOutOfWorld) ? "OutOfWorld"
+                            : (step.fProcess == StepTrace::kNoProcess)  ? "UserLimit" : processes[step.fProcess];
+        if (options.summary) {
+          counts[{ volumes[step.fVolume], process }]++;
+          continue;
+        }
+        std::cout << std::setw(5) << step.fStep << " "
+                  << Length(step.fX) << Length(step.fY) << Length(step.fZ)
+                  << Energy(step.fEkin) << Energy(step.fEdep)
+                  << Length(step.fStepLength) << Length(step.fTrackLength)
+                  << std::setw(12) << volumes[step.fVolume] << "  " << process << std::endl;
+      }
+      else { ok = false; break; }
+    }
+    if (!gzeof(file)) ok = false;
+    gzclose(file);
+
+    if (options.summary) {
+      std::cout << std::left << std::setw(24) << "volume" << std::setw(24) << "process" << "steps" << std::right << std::endl;
+      for ( const auto& count : counts )
+        std::cout << std::left << std::setw(24) << count.first.first << std::setw(24) << count.first.second
+                  << std::right << count.second << std::endl;
+    }
+    if (!ok) std::cerr << "StepPrint: " << fileName << " ends in a broken record (run not finished?)" << std::endl;
+    return ok;
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  Options options;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if      (arg == "--event" && i+1 < argc) options.event = std::atoll(argv[++i]);
+    else if (arg == "--track" && i+1 < argc) options.track = std::atoll(argv[++i]);
+    else if (arg == "--summary")             options.summary = true;
+    else                                     files.push_back(arg);
+  }
+  if (files.empty()) {
+    std::cerr << "usage: StepPrint [--event N] [--track N] [--summary] files.steps.gz ..." << std::endl;
+    return 1;
+  }
+
+  int failed = 0;
+  for ( const auto& file : files ) if (!Print(file, options)) failed++;
+  return failed > 0 ? 2 : 0;
+}
@@ -0,0 +1,53 @@
+#ifndef Benchmark_h
+#define Benchmark_h 1
+
+#include "globals.hh"
+#include <chrono>
+#include <vector>
+
+//
+// Thread-scaling benchmark: one fixed-seed run of the reference configuration (bench.mac) at the thread count
+// given on the command line, measured and appended to a CSV file. ScalingBenchmark.py runs it for a list of
+// thread counts. Created in main() for ColliRotate --benchmark - see ColliRotate.cc and Benchmark.cc
+//
+class Benchmark
+{
+  public:
+    Benchmark(G4int nofThreads, G4long nofEvents, G4long seed, G4String csvFile);
+   ~Benchmark();
+
+    static Benchmark* Instance() { return fgInstance; }
+
+  public:
+    G4bool Run(G4String macroFile);          // set up with the macro, warm up, measure, write the CSV rows
+
+    // RunAction - the worker runs of the measured run
+    void BeginOfRun(G4bool isMaster);
+    void EndOfRun(G4bool isMaster, G4int nofEvents);
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct ThreadData {
+      G4long            fEvents = 0;
+      G4double          fBusy   = 0.;       // s, from BeginOfRunAction to EndOfRunAction of the worker
+      Clock::time_point fStart;
+    };
+
+    G4int ThreadIndex(G4bool isMaster) const;
+    void  WriteCSV(G4double initTime, G4double warmupTime, G4double loopTime, G4double runTime) const;
+
+    static Benchmark* fgInstance;
+
+    G4int    fNbOfThreads;
+    G4long   fNbOfEvents;
+    G4long   fSeed;
+    G4String fCSVFile;
+
+    G4bool                  fMeasuring;
+    std::vector<ThreadData> fThreads;
+    Clock::time_point       fLoopEnd;       // last worker at EndOfRunAction
+};
+
+
+#endif
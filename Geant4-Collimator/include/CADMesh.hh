@@ -35,6 +35,9 @@
 
 // !! THIS FILE HAS BEEN AUTOMATICALLY GENERATED. DON'T EDIT IT DIRECTLY. !!
 
+// Geant4-Collimator: the local additions are in CADMeshExtensions.hh, included
+// at the end. The changes here are the hooks marked 'Geant4-Collimator'.
+
 #pragma once
 
 class BuiltInReader;
@@ -69,21 +72,27 @@ enum Type {
   OBJ,
   TET,
   OFF,
+  CMB,  // Geant4-Collimator
+  NODE, // Geant4-Collimator
 };
 
 static std::map<Type, G4String> Extension = {
     {Unknown, "unknown"}, {PLY, "ply"}, {STL, "stl"}, {DAE, "dae"},
-    {OBJ, "obj"},         {TET, "tet"}, {OFF, "off"}};
+    {OBJ, "obj"},         {TET, "tet"}, {OFF, "off"},
+    {CMB, "cmb"},         {NODE, "node"}}; // Geant4-Collimator
 
 static std::map<Type, G4String> TypeString = {
     {Unknown, "UNKNOWN"}, {PLY, "PLY"}, {STL, "STL"}, {DAE, "DAE"},
-    {OBJ, "OBJ"},         {TET, "TET"}, {OFF, "OFF"}};
+    {OBJ, "OBJ"},         {TET, "TET"}, {OFF, "OFF"},
+    {CMB, "CMB"},         {NODE, "NODE"}}; // Geant4-Collimator
 
 static std::map<Type, G4String> TypeName = {
     {Unknown, "Unknown File Format"}, {PLY, "Stanford Triangle Format (PLY)"},
     {STL, "Stereolithography (STL)"}, {DAE, "COLLADA (DAE)"},
     {OBJ, "Wavefront (OBJ)"},         {TET, "TetGet (TET)"},
-    {OFF, "Object File Format (OFF)"}};
+    {OFF, "Object File Format (OFF)"},
+    {CMB, "CADMesh Binary (CMB)"}, // Geant4-Collimator
+    {NODE, "TetGen nodes and elements (NODE/ELE)"}};
 
 Type TypeFromExtension(G4String extension);
 Type TypeFromName(G4String name);
@@ -157,6 +166,8 @@ protected:
   size_t AddMesh(std::shared_ptr<Mesh> mesh);
   void SetMeshes(Meshes meshs);
 
+  friend class MeshCache; // Geant4-Collimator
+
 private:
   Meshes meshes_;
 
@@ -482,10 +493,33 @@ public:
   G4bool GetReverse() { return this->reverse_; };
 
 private:
-  G4bool reverse_;
+  G4bool reverse_ = false;
 };
 }
 
+// Geant4-Collimator: the hooks into CADMeshExtensions.hh
+namespace CADMesh {
+
+namespace Hooks {
+
+// read through File::MeshCache
+G4bool Read(File::Reader *reader, G4String filepath);
+
+// the reader of the built-in reader for the added file types and the parallel
+// OBJ reader, nullptr for the others
+File::Reader *NewReader(File::Type type);
+G4bool CanRead(File::Type type);
+
+// the native solid if the part is a box, tube or cone (PrimitiveFitter), else
+// the tessellated solid
+G4VSolid *GetSolid(TessellatedMesh *tessellated, std::shared_ptr<Mesh> mesh);
+
+// the facets of the decimated mesh (Decimator), nullptr if not decimated
+std::shared_ptr<const Triangles> Decimate(std::shared_ptr<Mesh> mesh,
+                                          G4double scale);
+}
+}
+
 #ifdef USE_CADMESH_TETGEN
 
 #include "tetgen.h"
@@ -1088,7 +1122,8 @@ CADMeshTemplate<T>::CADMeshTemplate() : CADMeshTemplate<T>("") {}
 
 template <typename T>
 CADMeshTemplate<T>::CADMeshTemplate(G4String file_name)
-    : CADMeshTemplate<T>(file_name, File::Unknown) {}
+    : CADMeshTemplate<T>(file_name, File::TypeFromName(file_name)) {
+} // Geant4-Collimator: the type from the name, was File::Unknown
 
 template <typename T>
 CADMeshTemplate<T>::CADMeshTemplate(G4String file_name, File::Type file_type)
@@ -1122,7 +1157,7 @@ CADMeshTemplate<T>::CADMeshTemplate(G4String file_name, File::Type file_type,
 
   reader_ = reader;
 
-  reader_->Read(file_name_);
+  Hooks::Read(reader_.get(), file_name_); // Geant4-Collimator
 }
 
 template <typename T>
@@ -1268,23 +1303,21 @@ inline void MeshNotFound(G4String origin, G4String name) {
 
 namespace CADMesh {
 
-inline G4VSolid *TessellatedMesh::GetSolid() {
-  return (G4VSolid *)GetTessellatedSolid();
-}
+inline G4VSolid *TessellatedMesh::GetSolid() { return GetSolid(0); }
 
 inline G4VSolid *TessellatedMesh::GetSolid(G4int index) {
-  return (G4VSolid *)GetTessellatedSolid(index);
+  return Hooks::GetSolid(this, reader_->GetMesh(index)); // Geant4-Collimator
 }
 
 inline G4VSolid *TessellatedMesh::GetSolid(G4String name, G4bool exact) {
-  return (G4VSolid *)GetTessellatedSolid(name, exact);
+  return Hooks::GetSolid(this, reader_->GetMesh(name, exact));
 }
 
 inline std::vector<G4VSolid *> TessellatedMesh::GetSolids() {
   std::vector<G4VSolid *> solids;
 
   for (auto mesh : reader_->GetMeshes()) {
-    solids.push_back(GetTessellatedSolid(mesh));
+    solids.push_back(Hooks::GetSolid(this, mesh)); // Geant4-Collimator
   }
 
   return solids;
@@ -1296,7 +1329,7 @@ inline G4AssemblyVolume *TessellatedMesh::GetAssembly() {
   }
 
   for (auto mesh : reader_->GetMeshes()) {
-    auto solid = GetTessellatedSolid(mesh);
+    auto solid = Hooks::GetSolid(this, mesh); // Geant4-Collimator
 
     G4Material *material = nullptr;
 
@@ -1329,7 +1362,10 @@ inline G4TessellatedSolid *
 TessellatedMesh::GetTessellatedSolid(std::shared_ptr<Mesh> mesh) {
   auto volume_solid = new G4TessellatedSolid(mesh->GetName());
 
-  for (auto triangle : mesh->GetTriangles()) {
+  // Geant4-Collimator: holds the decimated facets while they are used
+  auto decimated = Hooks::Decimate(mesh, scale_);
+
+  for (auto triangle : decimated ? *decimated : mesh->GetTriangles()) {
     auto a = triangle->GetVertex(0) * scale_ + offset_;
     auto b = triangle->GetVertex(1) * scale_ + offset_;
     auto c = triangle->GetVertex(2) * scale_ + offset_;
@@ -2669,7 +2705,13 @@ inline G4bool BuiltInReader::Read(G4String filepath) {
 
   auto type = TypeFromName(filepath);
 
-  if (type == STL) {
+  reader = Hooks::NewReader(type); // Geant4-Collimator
+
+  if (reader) {
+    // one of CADMeshExtensions.hh
+  }
+
+  else if (type == STL) {
     reader = new File::STLReader();
   }
 
@@ -2694,7 +2736,8 @@ inline G4bool BuiltInReader::Read(G4String filepath) {
 }
 
 inline G4bool BuiltInReader::CanRead(Type type) {
-  return type == STL || type == OBJ || type == PLY;
+  return type == STL || type == OBJ || type == PLY ||
+         Hooks::CanRead(type); // Geant4-Collimator
 }
 
 inline std::shared_ptr<BuiltInReader> BuiltIn() {
@@ -2702,3 +2745,5 @@ inline std::shared_ptr<BuiltInReader> BuiltIn() {
 }
 }
 }
+
+#include "CADMeshExtensions.hh" // Geant4-Collimator
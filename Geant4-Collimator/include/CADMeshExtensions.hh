@@ -0,0 +1,2485 @@
+// Local additions to CADMesh for Geant4-Collimator (commands in
+// src/CADMessenger.cc), kept out of the generated CADMesh.hh, which only calls
+// them through the hooks in namespace CADMesh::Hooks:
+//   File::MeshCache - process-wide cache of the parsed meshes
+//   File::BinaryReader, File::WriteBinary - memory-mapped binary meshes (.cmb)
+//   File::ParallelOBJReader - multi-threaded OBJ reader of the built-in reader
+//   Decimator - edge-collapse simplification of the tessellated solids,
+//     DecimationCache - the decimated meshes per mesh and tolerance
+//   PrimitiveFitter - native solids for the parts which are boxes, tubes or
+//     cones
+//   File::ReadTetGen, File::TetGenReader, TetParameterisation - tetrahedral
+//     meshes from .node/.ele files without TetGen, placed as G4PVParameterised
+//
+// Included at the end of CADMesh.hh; include CADMesh.hh.
+
+#pragma once
+
+#include "CADMesh.hh"
+
+#include "G4Box.hh"
+#include "G4Cons.hh"
+#include "G4DisplacedSolid.hh"
+#include "G4GeometryTolerance.hh"
+#include "G4PVParameterised.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4Transform3D.hh"
+#include "G4Tubs.hh"
+#include "G4VPVParameterisation.hh"
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <mutex>
+
+namespace CADMesh {
+
+namespace File {
+
+// Process-wide cache of the parsed meshes, keyed by reader, file path and
+// modification time. Several From* calls for the parts of one assembly and the
+// geometry rebuilds after ReinitializeGeometry share one parsed Mesh set; a
+// changed file is parsed again. The meshes are not modified after reading (the
+// solids get their own copies of the facets), so they can be shared.
+class MeshCache {
+public:
+  static G4bool Read(Reader *reader, G4String filepath);
+
+  static void SetEnabled(G4bool enabled) { Enabled() = enabled; };
+  static G4bool IsEnabled() { return Enabled(); };
+
+  static void Clear();
+  static void Print(std::ostream &out);
+
+private:
+  struct Entry {
+    std::filesystem::file_time_type modified;
+    std::uintmax_t size = 0;
+    Meshes meshes;
+    size_t facets = 0;
+    G4double parse_time = 0.; // s, of the last parse
+    size_t hits = 0;
+    G4double hit_time = 0.; // s, of all hits
+  };
+
+  static std::map<std::string, Entry> &Entries() {
+    static std::map<std::string, Entry> entries;
+    return entries;
+  };
+
+  static std::mutex &Mutex() {
+    static std::mutex mutex;
+    return mutex;
+  };
+
+  static G4bool &Enabled() {
+    static G4bool enabled = true;
+    return enabled;
+  };
+};
+
+inline G4bool MeshCache::Read(Reader *reader, G4String filepath) {
+  auto start = std::chrono::steady_clock::now();
+  auto seconds = [&start]() {
+    return std::chrono::duration<G4double>(std::chrono::steady_clock::now() -
+                                           start)
+        .count();
+  };
+
+  // files which can't be found are left to the reader and its error
+  std::error_code error;
+  auto path = std::filesystem::canonical(std::string(filepath), error);
+  auto modified = std::filesystem::last_write_time(path, error);
+  auto size = std::filesystem::file_size(path, error);
+
+  if (!IsEnabled() || error) {
+    return reader->Read(filepath);
+  }
+
+  auto key = reader->GetName() + ":" + path.string();
+
+  std::lock_guard<std::mutex> lock(Mutex());
+
+  auto entry = Entries().find(key);
+  if (entry != Entries().end() && entry->second.modified == modified &&
+      entry->second.size == size) {
+    reader->SetMeshes(entry->second.meshes);
+    entry->second.hits++;
+    entry->second.hit_time += seconds();
+    return true;
+  }
+
+  if (!reader->Read(filepath)) {
+    return false;
+  }
+
+  Entry parsed;
+  parsed.modified = modified;
+  parsed.size = size;
+  parsed.meshes = reader->GetMeshes();
+
+  for (auto mesh : parsed.meshes) {
+    parsed.facets += mesh->GetTriangles().size();
+  }
+
+  parsed.parse_time = seconds();
+  Entries()[key] = parsed;
+
+  return true;
+}
+
+inline void MeshCache::Clear() {
+  std::lock_guard<std::mutex> lock(Mutex());
+  Entries().clear();
+}
+
+inline void MeshCache::Print(std::ostream &out) {
+  std::lock_guard<std::mutex> lock(Mutex());
+
+  out << "\n CADMesh mesh cache: " << Entries().size() << " file(s)"
+      << (IsEnabled() ? "" : " (disabled)") << std::endl;
+
+  if (Entries().empty()) {
+    return;
+  }
+
+  out << std::setw(8) << "parts" << std::setw(10) << "facets" << std::setw(12)
+      << "parse [ms]" << std::setw(8) << "hits" << std::setw(14)
+      << "per hit [ms]"
+      << "  file" << std::endl;
+
+  for (auto &entry : Entries()) {
+    auto &e = entry.second;
+    auto file = entry.first.substr(entry.first.find(':') + 1);
+
+    out << std::setw(8) << e.meshes.size() << std::setw(10) << e.facets
+        << std::setw(12) << std::fixed << std::setprecision(1)
+        << e.parse_time * 1000. << std::setw(8) << e.hits << std::setw(14)
+        << std::setprecision(3) << (e.hits ? e.hit_time * 1000. / e.hits : 0.)
+        << "  " << file << std::endl;
+  }
+
+  out << std::defaultfloat << std::setprecision(6);
+}
+}
+}
+
+namespace CADMesh {
+
+namespace Exceptions {
+
+inline void MaterialNotFound(G4String origin, G4int region) {
+  std::stringstream message;
+  message << "\nThe tetrahedra of region '" << region
+          << "' have no material.\n\tSet one with SetMaterial(material) or"
+          << " SetMaterial(" << region << ", material).";
+
+  G4Exception(("CADMesh in " + origin).c_str(), "MaterialNotFound",
+              FatalException, message.str().c_str());
+}
+}
+}
+
+#include <array>
+#include <cfloat>
+#include <cmath>
+
+namespace CADMesh {
+
+// Edge-collapse decimation of a closed mesh, of all TessellatedMesh solids
+// while a default tolerance is set (SetDefaultTolerance).
+// A vertex is merged into one of its neighbours (half-edge collapse, so the
+// vertices left are original vertices) if
+//   - the mesh stays a closed 2-manifold (link condition) and no facet flips
+//     over or degenerates,
+//   - the original vertices and facet centres the vertices around it stand for
+//     stay within the tolerance of their new facets.
+// Shorter edges are collapsed first, the passes over all vertices are repeated
+// until nothing changes, with the tolerance raised in steps. The reported
+// deviation is a sampled, one-sided estimate, not a bound: the largest distance
+// of an original vertex or facet centre from the simplified surface. Points
+// between the samples, and the simplified surface seen from the original, are
+// not measured.
+class Decimator {
+public:
+  Decimator(Triangles triangles);
+
+  // false if the mesh is not closed, then nothing is changed
+  G4bool Run(G4double tolerance);
+
+  Triangles GetTriangles();
+  size_t GetNumberOfFacetsBefore() { return faces_.size(); };
+  size_t GetNumberOfFacets() { return facets_; };
+  G4double GetMaxDeviation() { return max_deviation_; }; // sampled estimate
+
+  // tolerance for the solids of TessellatedMesh (in the units after SetScale),
+  // 0: not decimated
+  static void SetDefaultTolerance(G4double tolerance) {
+    DefaultTolerance() = tolerance;
+  };
+
+  static G4double GetDefaultTolerance() { return DefaultTolerance(); };
+
+private:
+  typedef std::array<size_t, 3> Face;
+
+  static G4double &DefaultTolerance() {
+    static G4double tolerance = 0.;
+    return tolerance;
+  };
+
+  G4bool IsClosed();
+  G4bool Collapse(size_t u, size_t v, G4double tolerance);
+  std::vector<size_t> Neighbours(size_t u);
+  G4ThreeVector Normal(const Face &face);
+  G4double Deviation(const Points &points, const std::vector<Face> &fan);
+
+  static G4double Distance(const G4ThreeVector &p, const G4ThreeVector &a,
+                           const G4ThreeVector &b, const G4ThreeVector &c);
+
+  Points vertices_;
+  std::vector<Face> faces_;
+  std::vector<G4bool> face_alive_;
+  std::vector<G4bool> vertex_alive_;
+  std::vector<std::vector<size_t>> vertex_faces_;
+  std::vector<Points> samples_; // original points each vertex answers for
+  size_t facets_ = 0;
+  G4double max_deviation_ = 0.;
+};
+
+inline Decimator::Decimator(Triangles triangles) {
+  std::map<G4ThreeVector, size_t> vertex_index;
+
+  for (auto triangle : triangles) {
+    Face face;
+
+    for (G4int i = 0; i < 3; i++) {
+      auto vertex = triangle->GetVertex(i);
+      auto found = vertex_index.find(vertex);
+
+      if (found == vertex_index.end()) {
+        found = vertex_index.emplace(vertex, vertices_.size()).first;
+        vertices_.push_back(vertex);
+        vertex_faces_.push_back(std::vector<size_t>());
+        samples_.push_back(Points());
+      }
+
+      face[i] = found->second;
+    }
+
+    for (auto i : face) {
+      vertex_faces_[i].push_back(faces_.size());
+    }
+
+    samples_[face[0]].push_back(
+        (vertices_[face[0]] + vertices_[face[1]] + vertices_[face[2]]) / 3.);
+    faces_.push_back(face);
+  }
+
+  face_alive_.assign(faces_.size(), true);
+  facets_ = faces_.size();
+  vertex_alive_.assign(vertices_.size(), true);
+}
+
+inline G4bool Decimator::IsClosed() {
+  // every edge in both directions, once each
+  std::map<std::pair<size_t, size_t>, G4int> edges;
+
+  for (auto &face : faces_) {
+    for (G4int i = 0; i < 3; i++) {
+      if (face[i] == face[(i + 1) % 3]) {
+        return false;
+      }
+
+      edges[std::make_pair(face[i], face[(i + 1) % 3])]++;
+    }
+  }
+
+  for (auto &edge : edges) {
+    auto reverse =
+        edges.find(std::make_pair(edge.first.second, edge.first.first));
+
+    if (edge.second != 1 || reverse == edges.end() || reverse->second != 1) {
+      return false;
+    }
+  }
+
+  return faces_.size() > 0;
+}
+
+inline std::vector<size_t> Decimator::Neighbours(size_t u) {
+  std::vector<size_t> neighbours;
+
+  for (auto f : vertex_faces_[u]) {
+    for (auto w : faces_[f]) {
+      if (w != u && std::find(neighbours.begin(), neighbours.end(), w) ==
+                        neighbours.end()) {
+        neighbours.push_back(w);
+      }
+    }
+  }
+
+  return neighbours;
+}
+
+inline G4ThreeVector Decimator::Normal(const Face &face) {
+  return (vertices_[face[1]] - vertices_[face[0]])
+      .cross(vertices_[face[2]] - vertices_[face[0]]);
+}
+
+inline G4double Decimator::Distance(const G4ThreeVector &p,
+                                    const G4ThreeVector &a,
+                                    const G4ThreeVector &b,
+                                    const G4ThreeVector &c) {
+  // closest point on the triangle, by the region of p (Ericson, Real-Time
+  // Collision Detection, 5.1.5)
+  auto ab = b - a;
+  auto ac = c - a;
+  auto ap = p - a;
+
+  G4double d1 = ab.dot(ap);
+  G4double d2 = ac.dot(ap);
+  if (d1 <= 0. && d2 <= 0.) {
+    return ap.mag();
+  }
+
+  auto bp = p - b;
+  G4double d3 = ab.dot(bp);
+  G4double d4 = ac.dot(bp);
+  if (d3 >= 0. && d4 <= d3) {
+    return bp.mag();
+  }
+
+  G4double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0. && d1 >= 0. && d3 <= 0.) {
+    return (p - (a + ab * (d1 / (d1 - d3)))).mag();
+  }
+
+  auto cp = p - c;
+  G4double d5 = ab.dot(cp);
+  G4double d6 = ac.dot(cp);
+  if (d6 >= 0. && d5 <= d6) {
+    return cp.mag();
+  }
+
+  G4double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0. && d2 >= 0. && d6 <= 0.) {
+    return (p - (a + ac * (d2 / (d2 - d6)))).mag();
+  }
+
+  G4double va = d3 * d6 - d5 * d4;
+  if (va <= 0. && (d4 - d3) >= 0. && (d5 - d6) >= 0.) {
+    return (p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))))).mag();
+  }
+
+  G4double denominator = 1. / (va + vb + vc);
+  return (p - (a + ab * (vb * denominator) + ac * (vc * denominator))).mag();
+}
+
+inline G4double Decimator::Deviation(const Points &points,
+                                     const std::vector<Face> &fan) {
+  G4double deviation = 0.;
+
+  for (auto &point : points) {
+    G4double distance = DBL_MAX;
+
+    for (auto &face : fan) {
+      distance = std::min(distance, Distance(point, vertices_[face[0]],
+                                             vertices_[face[1]],
+                                             vertices_[face[2]]));
+    }
+
+    deviation = std::max(deviation, distance);
+  }
+
+  return deviation;
+}
+
+inline G4bool Decimator::Collapse(size_t u, size_t v, G4double tolerance) {
+  std::vector<size_t> shared, moved;
+
+  for (auto f : vertex_faces_[u]) {
+    auto &face = faces_[f];
+
+    if (face[0] == v || face[1] == v || face[2] == v) {
+      shared.push_back(f);
+    } else {
+      moved.push_back(f);
+    }
+  }
+
+  // a tetrahedron is as far as it goes
+  if (shared.size() != 2 || moved.size() == 0 || facets_ <= 4) {
+    return false;
+  }
+
+  // link condition: u and v have only the two opposite vertices in common
+  auto neighbours_u = Neighbours(u);
+  auto neighbours_v = Neighbours(v);
+  size_t common = 0;
+
+  for (auto w : neighbours_u) {
+    if (std::find(neighbours_v.begin(), neighbours_v.end(), w) !=
+        neighbours_v.end()) {
+      common++;
+    }
+  }
+
+  if (common != 2) {
+    return false;
+  }
+
+  auto replaced = [u, v](Face face) {
+    for (auto &i : face) {
+      if (i == u) {
+        i = v;
+      }
+    }
+    return face;
+  };
+
+  // no facet may flip over or degenerate
+  for (auto f : moved) {
+    auto before = Normal(faces_[f]);
+    auto after = Normal(replaced(faces_[f]));
+
+    if (after.mag2() <= 1e-12 * before.mag2() ||
+        before.unit().dot(after.unit()) < 0.5) {
+      return false;
+    }
+  }
+
+  // the new facets around every vertex whose facets change
+  auto fan = [&](size_t w) {
+    std::vector<Face> faces;
+
+    for (auto f : vertex_faces_[w]) {
+      if (std::find(shared.begin(), shared.end(), f) == shared.end()) {
+        faces.push_back(replaced(faces_[f]));
+      }
+    }
+
+    if (w == v) {
+      for (auto f : moved) {
+        faces.push_back(replaced(faces_[f]));
+      }
+    }
+
+    return faces;
+  };
+
+  std::vector<size_t> changed(1, v);
+  for (auto w : neighbours_u) {
+    if (w != v) {
+      changed.push_back(w);
+    }
+  }
+
+  std::vector<std::vector<Face>> fans;
+  for (auto w : changed) {
+    fans.push_back(fan(w));
+  }
+
+  // every point stays with its vertex if it is close enough to its new
+  // facets, else it goes to the vertex with the closest facets
+  std::vector<Points> samples(changed.size());
+
+  auto place = [&](const G4ThreeVector &point, size_t owner) {
+    if (Deviation(Points(1, point), fans[owner]) <= tolerance) {
+      samples[owner].push_back(point);
+      return true;
+    }
+
+    G4double closest = DBL_MAX;
+    for (size_t k = 0; k < changed.size(); k++) {
+      auto distance = Deviation(Points(1, point), fans[k]);
+
+      if (distance < closest) {
+        closest = distance;
+        owner = k;
+      }
+    }
+
+    samples[owner].push_back(point);
+    return closest <= tolerance;
+  };
+
+  for (size_t k = 0; k < changed.size(); k++) {
+    for (auto &point : samples_[changed[k]]) {
+      if (!place(point, k)) {
+        return false;
+      }
+    }
+  }
+
+  for (auto &point : samples_[u]) {
+    if (!place(point, 0)) {
+      return false;
+    }
+  }
+
+  if (!place(vertices_[u], 0)) {
+    return false;
+  }
+
+  for (auto f : shared) {
+    face_alive_[f] = false;
+    facets_--;
+
+    for (auto w : faces_[f]) {
+      auto &faces = vertex_faces_[w];
+      faces.erase(std::remove(faces.begin(), faces.end(), f), faces.end());
+    }
+  }
+
+  for (auto f : moved) {
+    faces_[f] = replaced(faces_[f]);
+    vertex_faces_[v].push_back(f);
+  }
+
+  vertex_faces_[u].clear();
+  vertex_alive_[u] = false;
+
+  for (size_t k = 0; k < changed.size(); k++) {
+    samples_[changed[k]] = samples[k];
+  }
+  samples_[u].clear();
+
+  return true;
+}
+
+inline G4bool Decimator::Run(G4double tolerance) {
+  if (!IsClosed()) {
+    return false;
+  }
+
+  // the flat regions first, then in steps up to the tolerance: a cheap
+  // stand-in for collapsing in the order of the deviation
+  for (G4double step : {1e-6, 0.125, 0.25, 0.5, 1.}) {
+    G4bool changed = true;
+
+    while (changed) {
+      changed = false;
+
+      for (size_t u = 0; u < vertices_.size(); u++) {
+        if (!vertex_alive_[u]) {
+          continue;
+        }
+
+        auto neighbours = Neighbours(u);
+        std::sort(neighbours.begin(), neighbours.end(),
+                  [&](size_t a, size_t b) {
+                    return (vertices_[a] - vertices_[u]).mag2() <
+                           (vertices_[b] - vertices_[u]).mag2();
+                  });
+
+        for (auto v : neighbours) {
+          if (Collapse(u, v, step * tolerance)) {
+            changed = true;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  max_deviation_ = 0.;
+
+  for (size_t w = 0; w < vertices_.size(); w++) {
+    if (!vertex_alive_[w]) {
+      continue;
+    }
+
+    std::vector<Face> faces;
+    for (auto f : vertex_faces_[w]) {
+      faces.push_back(faces_[f]);
+    }
+
+    max_deviation_ = std::max(max_deviation_, Deviation(samples_[w], faces));
+  }
+
+  return true;
+}
+
+inline Triangles Decimator::GetTriangles() {
+  Triangles triangles;
+
+  for (size_t f = 0; f < faces_.size(); f++) {
+    if (face_alive_[f]) {
+      triangles.push_back(new G4TriangularFacet(vertices_[faces_[f][0]],
+                                                vertices_[faces_[f][1]],
+                                                vertices_[faces_[f][2]],
+                                                ABSOLUTE));
+    }
+  }
+
+  return triangles;
+}
+
+// Process-wide cache of the decimated meshes, keyed by mesh and tolerance (in
+// the units of the mesh). The meshes of File::MeshCache are shared by the parts
+// of one file and by the geometry rebuilds, so a rebuild (/custom/geo/change_x)
+// does not decimate them again. An entry whose mesh is gone is decimated again
+// on the next use, since a new mesh may have the same address.
+class DecimationCache {
+public:
+  struct Result {
+    std::shared_ptr<const Triangles> triangles; // owns the facets
+    size_t facets_before = 0;
+    G4double max_deviation = 0.; // sampled estimate, see Decimator
+    G4bool closed = true;        // false: not decimated
+    G4bool cached = false;       // found in the cache
+  };
+
+  static Result Get(std::shared_ptr<Mesh> mesh, G4double tolerance);
+
+  static void Clear();
+
+private:
+  struct Entry {
+    std::weak_ptr<Mesh> mesh;
+    Result result;
+  };
+
+  typedef std::pair<const Mesh *, G4double> Key;
+
+  static std::map<Key, Entry> &Entries() {
+    static std::map<Key, Entry> entries;
+    return entries;
+  };
+
+  static std::mutex &Mutex() {
+    static std::mutex mutex;
+    return mutex;
+  };
+};
+
+inline DecimationCache::Result
+DecimationCache::Get(std::shared_ptr<Mesh> mesh, G4double tolerance) {
+  std::lock_guard<std::mutex> lock(Mutex());
+
+  Key key(mesh.get(), tolerance);
+  auto entry = Entries().find(key);
+  if (entry != Entries().end() && entry->second.mesh.lock() == mesh) {
+    auto result = entry->second.result;
+    result.cached = true;
+    return result;
+  }
+
+  Decimator decimator(mesh->GetTriangles());
+
+  Result result;
+  result.closed = decimator.Run(tolerance);
+  result.facets_before = decimator.GetNumberOfFacetsBefore();
+
+  if (result.closed) {
+    result.max_deviation = decimator.GetMaxDeviation();
+    result.triangles = std::shared_ptr<const Triangles>(
+        new Triangles(decimator.GetTriangles()), [](const Triangles *triangles) {
+          for (auto triangle : *triangles) {
+            delete triangle;
+          }
+          delete triangles;
+        });
+  }
+
+  Entries()[key] = {mesh, result};
+  return result;
+}
+
+inline void DecimationCache::Clear() {
+  std::lock_guard<std::mutex> lock(Mutex());
+  Entries().clear();
+}
+}
+
+namespace CADMesh {
+
+// Recognition of the parts which are a box, a tube (cylinder, ring, disk) or a
+// cone (SetDefaultTolerance), so that the native G4Box, G4Tubs
+// or G4Cons navigates instead of the tessellated solid.
+//   - the candidate axes are the eigenvectors of the facet normals and the
+//     directions shared by the largest facets (the caps),
+//   - the dimensions follow from the vertices (the native surface runs through
+//     the corners of the tessellation, so it is never smaller than the part),
+//     the centre from the centroid of the volume,
+//   - the part is accepted if all vertices, edge centres and facet centres are
+//     within the tolerance of the native surface and the two volumes differ by
+//     less than the surface area times the tolerance.
+class PrimitiveFitter {
+public:
+  PrimitiveFitter(Triangles triangles, G4double scale = 1.,
+                  G4ThreeVector offset = G4ThreeVector());
+
+  // true if the part is a box, tube or cone within the tolerance
+  G4bool Run(G4double tolerance);
+
+  // the native solid at the place of the part, nullptr if Run failed
+  G4VSolid *GetSolid(G4String name);
+
+  // e.g. "G4Tubs rmin 5 rmax 10 dz 10 mm"
+  G4String GetDescription();
+
+  G4double GetMaxDeviation() { return max_deviation_; };
+
+  // tolerance for the solids of TessellatedMesh (in the units after SetScale),
+  // 0: always the tessellated solid
+  static void SetDefaultTolerance(G4double tolerance) {
+    DefaultTolerance() = tolerance;
+  };
+
+  static G4double GetDefaultTolerance() { return DefaultTolerance(); };
+
+private:
+  enum Shape { Unfitted, Box, Tubs, Cons };
+
+  static G4double &DefaultTolerance() {
+    static G4double tolerance = 0.;
+    return tolerance;
+  };
+
+  typedef std::array<G4ThreeVector, 3> Facet;
+
+  G4bool FitBox(std::vector<G4ThreeVector> axes, G4double tolerance);
+  G4bool FitRevolution(G4ThreeVector axis, G4double tolerance);
+  G4bool Accept(G4double tolerance);
+  G4double Distance(const G4ThreeVector &point);
+  G4double NativeVolume();
+  G4double NativeArea();
+  G4bool IsPlaced();
+
+  static G4ThreeVector Orient(G4ThreeVector direction);
+  static G4ThreeVector Snap(G4ThreeVector vector);
+  static std::vector<G4ThreeVector> EigenVectors(G4double m[3][3]);
+
+  std::vector<Facet> facets_;
+  G4double volume_ = 0.;
+  G4ThreeVector centroid_;
+
+  Shape shape_ = Unfitted;
+  G4ThreeVector centre_;
+  G4ThreeVector u_, v_, w_; // local axes of the native solid
+  G4double dx_ = 0., dy_ = 0., dz_ = 0.;
+  G4double rmin1_ = 0., rmax1_ = 0.; // at -dz
+  G4double rmin2_ = 0., rmax2_ = 0.; // at +dz
+  G4double max_deviation_ = 0.;
+};
+
+inline PrimitiveFitter::PrimitiveFitter(Triangles triangles, G4double scale,
+                                        G4ThreeVector offset) {
+  G4ThreeVector moment;
+
+  for (auto triangle : triangles) {
+    Facet facet;
+
+    for (G4int i = 0; i < 3; i++) {
+      facet[i] = triangle->GetVertex(i) * scale + offset;
+    }
+
+    // signed volume of the tetrahedron with the origin
+    auto volume = facet[0].dot(facet[1].cross(facet[2])) / 6.;
+    volume_ += volume;
+    moment += (facet[0] + facet[1] + facet[2]) * volume / 4.;
+
+    facets_.push_back(facet);
+  }
+
+  if (volume_ != 0.) {
+    centroid_ = moment / volume_;
+  }
+
+  volume_ = std::fabs(volume_);
+}
+
+inline G4bool PrimitiveFitter::Run(G4double tolerance) {
+  shape_ = Unfitted;
+
+  if (facets_.size() < 4 || volume_ <= 0.) {
+    return false;
+  }
+
+  // directions of the facets (opposite ones are one direction) with their
+  // area, and the tensor of the normals
+  std::map<std::array<long, 3>, std::pair<G4ThreeVector, G4double>> cells;
+  G4double tensor[3][3] = {{0., 0., 0.}, {0., 0., 0.}, {0., 0., 0.}};
+
+  for (auto &facet : facets_) {
+    auto normal = (facet[1] - facet[0]).cross(facet[2] - facet[0]);
+    auto area = normal.mag();
+
+    if (area <= 0.) {
+      continue;
+    }
+
+    normal = Orient(normal / area);
+
+    std::array<long, 3> key = {{std::lround(normal.x() * 1000.),
+                                std::lround(normal.y() * 1000.),
+                                std::lround(normal.z() * 1000.)}};
+    auto &cell = cells[key];
+    cell.first += normal * area;
+    cell.second += area;
+
+    for (G4int i = 0; i < 3; i++) {
+      for (G4int j = 0; j < 3; j++) {
+        tensor[i][j] += area * normal[i] * normal[j];
+      }
+    }
+  }
+
+  std::vector<std::pair<G4ThreeVector, G4double>> directions;
+  for (auto &cell : cells) {
+    directions.push_back({cell.second.first.unit(), cell.second.second});
+  }
+
+  std::sort(directions.begin(), directions.end(),
+            [](const std::pair<G4ThreeVector, G4double> &a,
+               const std::pair<G4ThreeVector, G4double> &b) {
+              return a.second > b.second;
+            });
+
+  // a box has three perpendicular directions
+  std::vector<G4ThreeVector> axes;
+  for (auto &direction : directions) {
+    auto same = std::find_if(axes.begin(), axes.end(),
+                             [&](const G4ThreeVector &axis) {
+                               return std::fabs(axis.dot(direction.first)) >
+                                      1. - 1e-6;
+                             });
+
+    if (same == axes.end()) {
+      axes.push_back(direction.first);
+    }
+
+    if (axes.size() > 3) {
+      break;
+    }
+  }
+
+  if (axes.size() == 3 && FitBox(axes, tolerance)) {
+    return true;
+  }
+
+  // the axis of a tube or cone is an eigenvector of the normals, or the
+  // direction of its caps
+  std::vector<G4ThreeVector> candidates = EigenVectors(tensor);
+  for (size_t i = 0; i < directions.size() && i < 8; i++) {
+    candidates.push_back(directions[i].first);
+  }
+
+  for (auto &axis : candidates) {
+    if (FitRevolution(axis, tolerance)) {
+      return true;
+    }
+  }
+
+  shape_ = Unfitted;
+  return false;
+}
+
+inline G4bool PrimitiveFitter::FitBox(std::vector<G4ThreeVector> axes,
+                                      G4double tolerance) {
+  for (size_t i = 0; i < 3; i++) {
+    for (size_t j = i + 1; j < 3; j++) {
+      if (std::fabs(axes[i].dot(axes[j])) > 1e-6) {
+        return false;
+      }
+    }
+  }
+
+  // the axis closest to x first, then to y
+  std::sort(axes.begin(), axes.end(),
+            [](const G4ThreeVector &a, const G4ThreeVector &b) {
+              return std::fabs(a.x()) > std::fabs(b.x());
+            });
+
+  if (std::fabs(axes[2].y()) > std::fabs(axes[1].y())) {
+    std::swap(axes[1], axes[2]);
+  }
+
+  u_ = Snap(Orient(axes[0]));
+  v_ = Snap(Orient(axes[1] - u_ * u_.dot(axes[1])).unit());
+  w_ = Snap(u_.cross(v_));
+
+  G4ThreeVector low(DBL_MAX, DBL_MAX, DBL_MAX);
+  G4ThreeVector high(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+
+  for (auto &facet : facets_) {
+    for (auto &vertex : facet) {
+      G4ThreeVector local(vertex.dot(u_), vertex.dot(v_), vertex.dot(w_));
+
+      for (G4int i = 0; i < 3; i++) {
+        low[i] = std::min(low[i], local[i]);
+        high[i] = std::max(high[i], local[i]);
+      }
+    }
+  }
+
+  auto middle = (low + high) / 2.;
+  centre_ = Snap(u_ * middle.x() + v_ * middle.y() + w_ * middle.z());
+  dx_ = (high.x() - low.x()) / 2.;
+  dy_ = (high.y() - low.y()) / 2.;
+  dz_ = (high.z() - low.z()) / 2.;
+
+  shape_ = Box;
+  return Accept(tolerance);
+}
+
+inline G4bool PrimitiveFitter::FitRevolution(G4ThreeVector axis,
+                                             G4double tolerance) {
+  w_ = Orient(axis.unit());
+
+  // the local x axis as close to the global x axis as possible
+  if (std::fabs(w_.y()) < 0.9) {
+    u_ = G4ThreeVector(0., 1., 0.).cross(w_).unit();
+  }
+
+  else {
+    u_ = w_.cross(G4ThreeVector(0., 0., 1.)).unit();
+  }
+
+  u_ = Snap(u_);
+  v_ = Snap(w_.cross(u_));
+  w_ = Snap(w_);
+
+  G4double low = DBL_MAX, high = -DBL_MAX;
+  for (auto &facet : facets_) {
+    for (auto &vertex : facet) {
+      auto z = (vertex - centroid_).dot(w_);
+      low = std::min(low, z);
+      high = std::max(high, z);
+    }
+  }
+
+  centre_ = Snap(centroid_ + w_ * (low + high) / 2.);
+  dz_ = (high - low) / 2.;
+
+  // the radii of the vertices in the two caps
+  G4double inner[2] = {DBL_MAX, DBL_MAX}, outer[2] = {0., 0.};
+  for (auto &facet : facets_) {
+    for (auto &vertex : facet) {
+      auto d = vertex - centre_;
+      auto z = d.dot(w_);
+      auto r = (d - w_ * z).mag();
+
+      // within the tolerance of a cap, or on the side for thin foils
+      if (std::fabs(z) < dz_ - std::min(tolerance, dz_ / 2.)) {
+        continue;
+      }
+
+      G4int cap = z < 0. ? 0 : 1;
+      inner[cap] = std::min(inner[cap], r);
+      outer[cap] = std::max(outer[cap], r);
+    }
+  }
+
+  if (dz_ <= 0. || inner[0] > outer[0] || inner[1] > outer[1]) {
+    return false;
+  }
+
+  // a cap without a hole may have its vertices on the rim only, or one vertex
+  // on the axis
+  rmax1_ = outer[0];
+  rmax2_ = outer[1];
+  rmin1_ = inner[0] > tolerance && inner[0] < outer[0] - tolerance ? inner[0]
+                                                                   : 0.;
+  rmin2_ = inner[1] > tolerance && inner[1] < outer[1] - tolerance ? inner[1]
+                                                                   : 0.;
+
+  if (std::fabs(rmin1_ - rmin2_) <= tolerance &&
+      std::fabs(rmax1_ - rmax2_) <= tolerance) {
+    rmin1_ = rmin2_ = (rmin1_ + rmin2_) / 2.;
+    rmax1_ = rmax2_ = std::max(rmax1_, rmax2_);
+    shape_ = Tubs;
+  }
+
+  else {
+    shape_ = Cons;
+  }
+
+  if (Accept(tolerance)) {
+    return true;
+  }
+
+  // a solid part, the smallest radius in the caps was a vertex near the axis
+  if (rmin1_ > 0. || rmin2_ > 0.) {
+    rmin1_ = rmin2_ = 0.;
+    return Accept(tolerance);
+  }
+
+  return false;
+}
+
+inline G4bool PrimitiveFitter::Accept(G4double tolerance) {
+  if (std::fabs(volume_ - NativeVolume()) > NativeArea() * tolerance) {
+    return false;
+  }
+
+  max_deviation_ = 0.;
+
+  for (auto &facet : facets_) {
+    std::array<G4ThreeVector, 7> points = {
+        {facet[0], facet[1], facet[2], (facet[0] + facet[1]) / 2.,
+         (facet[1] + facet[2]) / 2., (facet[2] + facet[0]) / 2.,
+         (facet[0] + facet[1] + facet[2]) / 3.}};
+
+    for (auto &point : points) {
+      auto deviation = Distance(point);
+
+      if (deviation > tolerance) {
+        return false;
+      }
+
+      max_deviation_ = std::max(max_deviation_, deviation);
+    }
+  }
+
+  return true;
+}
+
+inline G4double PrimitiveFitter::Distance(const G4ThreeVector &point) {
+  auto d = point - centre_;
+  G4ThreeVector local(d.dot(u_), d.dot(v_), d.dot(w_));
+
+  if (shape_ == Box) {
+    G4ThreeVector excess(std::fabs(local.x()) - dx_,
+                         std::fabs(local.y()) - dy_,
+                         std::fabs(local.z()) - dz_);
+
+    if (excess.x() <= 0. && excess.y() <= 0. && excess.z() <= 0.) {
+      return -std::max(excess.x(), std::max(excess.y(), excess.z()));
+    }
+
+    return G4ThreeVector(std::max(excess.x(), 0.), std::max(excess.y(), 0.),
+                         std::max(excess.z(), 0.))
+        .mag();
+  }
+
+  // distance from the outline of the tube or cone in the r-z plane
+  auto r = std::sqrt(local.x() * local.x() + local.y() * local.y());
+  auto z = local.z();
+
+  auto segment = [r, z](G4double r1, G4double z1, G4double r2, G4double z2) {
+    auto dr = r2 - r1, dz = z2 - z1;
+    auto length2 = dr * dr + dz * dz;
+    auto t = length2 > 0. ? ((r - r1) * dr + (z - z1) * dz) / length2 : 0.;
+    t = std::min(std::max(t, 0.), 1.);
+    return std::hypot(r - r1 - t * dr, z - z1 - t * dz);
+  };
+
+  auto distance = std::min(segment(rmin1_, -dz_, rmax1_, -dz_),
+                           segment(rmin2_, dz_, rmax2_, dz_));
+  distance = std::min(distance, segment(rmax1_, -dz_, rmax2_, dz_));
+
+  if (rmin1_ > 0. || rmin2_ > 0.) {
+    distance = std::min(distance, segment(rmin1_, -dz_, rmin2_, dz_));
+  }
+
+  return distance;
+}
+
+inline G4double PrimitiveFitter::NativeVolume() {
+  if (shape_ == Box) {
+    return 8. * dx_ * dy_ * dz_;
+  }
+
+  auto frustum = [this](G4double r1, G4double r2) {
+    return CLHEP::pi * 2. * dz_ / 3. * (r1 * r1 + r1 * r2 + r2 * r2);
+  };
+
+  return frustum(rmax1_, rmax2_) - frustum(rmin1_, rmin2_);
+}
+
+inline G4double PrimitiveFitter::NativeArea() {
+  if (shape_ == Box) {
+    return 8. * (dx_ * dy_ + dy_ * dz_ + dz_ * dx_);
+  }
+
+  auto side = [this](G4double r1, G4double r2) {
+    return CLHEP::pi * (r1 + r2) * std::hypot(r1 - r2, 2. * dz_);
+  };
+
+  return CLHEP::pi * (rmax1_ * rmax1_ - rmin1_ * rmin1_) +
+         CLHEP::pi * (rmax2_ * rmax2_ - rmin2_ * rmin2_) +
+         side(rmax1_, rmax2_) + side(rmin1_, rmin2_);
+}
+
+inline G4bool PrimitiveFitter::IsPlaced() {
+  return centre_.mag() > 1e-6 ||
+         (u_ - G4ThreeVector(1., 0., 0.)).mag() > 1e-9 ||
+         (v_ - G4ThreeVector(0., 1., 0.)).mag() > 1e-9;
+}
+
+inline G4VSolid *PrimitiveFitter::GetSolid(G4String name) {
+  G4VSolid *solid = nullptr;
+  auto native_name = IsPlaced() ? name + "_native" : name;
+
+  if (shape_ == Box) {
+    solid = new G4Box(native_name, dx_, dy_, dz_);
+  }
+
+  else if (shape_ == Tubs) {
+    solid = new G4Tubs(native_name, rmin1_, rmax1_, dz_, 0., CLHEP::twopi);
+  }
+
+  else if (shape_ == Cons) {
+    solid = new G4Cons(native_name, rmin1_, rmax1_, rmin2_, rmax2_, dz_, 0.,
+                       CLHEP::twopi);
+  }
+
+  if (solid == nullptr || !IsPlaced()) {
+    return solid;
+  }
+
+  return new G4DisplacedSolid(
+      name, solid, G4Transform3D(G4RotationMatrix(u_, v_, w_), centre_));
+}
+
+inline G4String PrimitiveFitter::GetDescription() {
+  std::ostringstream description;
+
+  if (shape_ == Box) {
+    description << "G4Box dx " << dx_ << " dy " << dy_ << " dz " << dz_;
+  }
+
+  else if (shape_ == Tubs) {
+    description << "G4Tubs rmin " << rmin1_ << " rmax " << rmax1_ << " dz "
+                << dz_;
+  }
+
+  else if (shape_ == Cons) {
+    description << "G4Cons rmin1 " << rmin1_ << " rmax1 " << rmax1_
+                << " rmin2 " << rmin2_ << " rmax2 " << rmax2_ << " dz "
+                << dz_;
+  }
+
+  else {
+    return "nothing";
+  }
+
+  description << " mm";
+
+  if (IsPlaced() && shape_ == Box) {
+    description << " at " << centre_ << ", axes " << u_ << " " << v_ << " "
+                << w_;
+  }
+
+  else if (IsPlaced()) {
+    description << " at " << centre_ << " along " << w_;
+  }
+
+  return description.str();
+}
+
+// the sign which makes the largest component positive
+inline G4ThreeVector PrimitiveFitter::Orient(G4ThreeVector direction) {
+  auto largest = direction.x();
+
+  if (std::fabs(direction.y()) > std::fabs(largest)) {
+    largest = direction.y();
+  }
+
+  if (std::fabs(direction.z()) > std::fabs(largest)) {
+    largest = direction.z();
+  }
+
+  return largest < 0. ? -direction : direction;
+}
+
+// without the rounding noise of the float coordinates around 0
+inline G4ThreeVector PrimitiveFitter::Snap(G4ThreeVector vector) {
+  for (G4int i = 0; i < 3; i++) {
+    if (std::fabs(vector[i]) < 1e-9) {
+      vector[i] = 0.;
+    }
+  }
+
+  return vector;
+}
+
+// Jacobi rotations of a symmetric 3x3 matrix
+inline std::vector<G4ThreeVector> PrimitiveFitter::EigenVectors(
+    G4double m[3][3]) {
+  G4double v[3][3] = {{1., 0., 0.}, {0., 1., 0.}, {0., 0., 1.}};
+
+  for (G4int sweep = 0; sweep < 50; sweep++) {
+    auto off = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+    auto norm = off + m[0][0] * m[0][0] + m[1][1] * m[1][1] + m[2][2] * m[2][2];
+
+    if (off <= 1e-24 * norm) {
+      break;
+    }
+
+    for (G4int p = 0; p < 2; p++) {
+      for (G4int q = p + 1; q < 3; q++) {
+        if (m[p][q] == 0.) {
+          continue;
+        }
+
+        auto theta = (m[q][q] - m[p][p]) / (2. * m[p][q]);
+        auto t = (theta >= 0. ? 1. : -1.) /
+                 (std::fabs(theta) + std::sqrt(theta * theta + 1.));
+        auto c = 1. / std::sqrt(t * t + 1.), s = t * c;
+
+        for (G4int k = 0; k < 3; k++) {
+          auto mkp = m[k][p], mkq = m[k][q];
+          m[k][p] = c * mkp - s * mkq;
+          m[k][q] = s * mkp + c * mkq;
+        }
+
+        for (G4int k = 0; k < 3; k++) {
+          auto mpk = m[p][k], mqk = m[q][k];
+          m[p][k] = c * mpk - s * mqk;
+          m[q][k] = s * mpk + c * mqk;
+        }
+
+        for (G4int k = 0; k < 3; k++) {
+          auto vkp = v[k][p], vkq = v[k][q];
+          v[k][p] = c * vkp - s * vkq;
+          v[k][q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+
+  std::vector<G4ThreeVector> vectors;
+  for (G4int k = 0; k < 3; k++) {
+    vectors.push_back(G4ThreeVector(v[0][k], v[1][k], v[2][k]));
+  }
+
+  return vectors;
+}
+}
+
+namespace CADMesh {
+
+namespace File {
+
+// Tetrahedra of a TetGen mesh: the .node file with the points and the .ele
+// file with the tetrahedra of the same name (TetGen -k, or written by Gmsh and
+// other mesh generators). Quadratic elements are read by their corners.
+struct Tetrahedra {
+  Points nodes;
+  std::vector<std::array<size_t, 4>> elements;
+  std::vector<G4int> regions; // region attribute of the element, 0 if none
+};
+
+G4bool ReadTetGen(G4String filepath, Tetrahedra &tetrahedra);
+}
+}
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CADMESH_MMAP
+#endif
+
+namespace CADMesh {
+
+namespace File {
+
+// Binary meshes (.cmb), written by WriteBinary from any mesh the readers
+// return, e.g. with the CADConvert program. Native byte order:
+//   BinaryHeader               magic, number of parts
+//   BinaryPart[parts]          offsets and sizes of the arrays of each part
+//   the names, then per part   double[3 * vertices] (8-byte aligned),
+//                              uint32_t[3 * triangles] (vertex indices)
+// The file is memory-mapped, so loading costs about as much as the facet
+// construction of G4TessellatedSolid, not the parsing of the text formats.
+static const char BinaryMagic[8] = {'C', 'A', 'D', 'M', 'B', 'I', 'N', '1'};
+
+#pragma pack(push, 1)
+struct BinaryHeader {
+  char magic[8];
+  uint32_t parts;
+  uint32_t reserved;
+};
+
+struct BinaryPart {
+  uint64_t name_offset;
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+  uint32_t name_length;
+  uint32_t vertices;
+  uint32_t triangles;
+  uint32_t reserved;
+};
+#pragma pack(pop)
+
+// Read-only view of a whole file: mapped where mmap is available, read into
+// memory otherwise.
+class MappedFile {
+public:
+  MappedFile(G4String filepath);
+  ~MappedFile();
+
+  const char *GetData() { return data_; };
+  size_t GetSize() { return size_; };
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  std::string buffer_;
+};
+
+class BinaryReader : public Reader {
+public:
+  BinaryReader() : Reader("BinaryReader"){};
+
+  G4bool Read(G4String filepath);
+  G4bool CanRead(Type file_type);
+};
+
+G4bool WriteBinary(Meshes meshes, G4String filepath);
+
+// The outer surface of a tetrahedral mesh (.node/.ele), the faces which belong
+// to one tetrahedron only, as one mesh named after the file.
+class TetGenReader : public Reader {
+public:
+  TetGenReader() : Reader("TetGenReader"){};
+
+  G4bool Read(G4String filepath);
+  G4bool CanRead(Type file_type);
+
+  // the tetrahedra the surface mesh was built from, so that a TetrahedralMesh
+  // takes them from the same read; nullptr if the mesh was not read here
+  static std::shared_ptr<const Tetrahedra>
+  GetTetrahedra(std::shared_ptr<Mesh> mesh);
+
+private:
+  struct Entry {
+    std::weak_ptr<Mesh> mesh;
+    std::shared_ptr<const Tetrahedra> tetrahedra;
+  };
+
+  static std::map<const Mesh *, Entry> &Entries() {
+    static std::map<const Mesh *, Entry> entries;
+    return entries;
+  };
+
+  static std::mutex &Mutex() {
+    static std::mutex mutex;
+    return mutex;
+  };
+};
+
+inline MappedFile::MappedFile(G4String filepath) {
+#ifdef CADMESH_MMAP
+  int fd = open(filepath.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    Exceptions::FileNotFound("MappedFile", filepath);
+    return;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) == 0 && status.st_size > 0) {
+    void *map = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map != MAP_FAILED) {
+      data_ = (const char *)map;
+      size_ = status.st_size;
+    }
+  }
+
+  close(fd);
+#else
+  std::ifstream file(filepath, std::ios::binary);
+
+  if (!file) {
+    Exceptions::FileNotFound("MappedFile", filepath);
+    return;
+  }
+
+  buffer_ = std::string((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#endif
+}
+
+inline MappedFile::~MappedFile() {
+#ifdef CADMESH_MMAP
+  if (data_) {
+    munmap((void *)data_, size_);
+  }
+#endif
+}
+
+inline G4bool BinaryReader::Read(G4String filepath) {
+  MappedFile file(filepath);
+
+  auto data = file.GetData();
+  auto size = file.GetSize();
+
+  BinaryHeader header;
+  if (size < sizeof(header)) {
+    Exceptions::ParserError("BinaryReader::Read",
+                            "The binary mesh file appears to be empty.");
+    return false;
+  }
+
+  std::memcpy(&header, data, sizeof(header));
+
+  if (std::memcmp(header.magic, BinaryMagic, sizeof(BinaryMagic)) != 0) {
+    Exceptions::ParserError("BinaryReader::Read",
+                            filepath + " is not a binary mesh file.");
+    return false;
+  }
+
+  if (size < sizeof(header) + (uint64_t)header.parts * sizeof(BinaryPart)) {
+    Exceptions::ParserError("BinaryReader::Read",
+                            filepath + " is truncated.");
+    return false;
+  }
+
+  for (uint32_t p = 0; p < header.parts; p++) {
+    BinaryPart part;
+    std::memcpy(&part, data + sizeof(header) + p * sizeof(BinaryPart),
+                sizeof(part));
+
+    uint64_t vertex_end =
+        part.vertex_offset + (uint64_t)part.vertices * 3 * sizeof(double);
+    uint64_t index_end =
+        part.index_offset + (uint64_t)part.triangles * 3 * sizeof(uint32_t);
+
+    if (part.name_offset + part.name_length > size || vertex_end > size ||
+        index_end > size || part.vertex_offset % alignof(double) != 0 ||
+        part.index_offset % alignof(uint32_t) != 0) {
+      std::stringstream error;
+      error << "Part " << p << " of " << filepath
+            << " lies outside of the file.";
+
+      Exceptions::ParserError("BinaryReader::Read", error.str());
+      return false;
+    }
+
+    G4String name(data + part.name_offset, part.name_length);
+
+    auto coordinates = (const double *)(data + part.vertex_offset);
+    auto indices = (const uint32_t *)(data + part.index_offset);
+
+    Points points(part.vertices);
+    for (uint32_t i = 0; i < part.vertices; i++) {
+      points[i] = G4ThreeVector(coordinates[3 * i], coordinates[3 * i + 1],
+                                coordinates[3 * i + 2]);
+    }
+
+    Triangles triangles;
+    triangles.reserve(part.triangles);
+
+    for (uint32_t t = 0; t < part.triangles; t++) {
+      auto a = indices[3 * t];
+      auto b = indices[3 * t + 1];
+      auto c = indices[3 * t + 2];
+
+      if (a >= part.vertices || b >= part.vertices || c >= part.vertices) {
+        std::stringstream error;
+        error << "Triangle " << t << " of part '" << name
+              << "' uses a vertex which does not exist.";
+
+        Exceptions::ParserError("BinaryReader::Read", error.str());
+        return false;
+      }
+
+      triangles.push_back(
+          new G4TriangularFacet(points[a], points[b], points[c], ABSOLUTE));
+    }
+
+    AddMesh(Mesh::New(points, triangles, name));
+  }
+
+  return true;
+}
+
+inline G4bool BinaryReader::CanRead(Type file_type) {
+  return (file_type == CMB);
+}
+
+inline G4bool WriteBinary(Meshes meshes, G4String filepath) {
+  auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+
+  std::vector<BinaryPart> parts(meshes.size());
+  std::vector<std::vector<double>> coordinates(meshes.size());
+  std::vector<std::vector<uint32_t>> indices(meshes.size());
+
+  // shared vertices of the facets, in the order of their first use
+  for (size_t p = 0; p < meshes.size(); p++) {
+    std::map<G4ThreeVector, uint32_t> vertex_index;
+
+    for (auto triangle : meshes[p]->GetTriangles()) {
+      for (G4int v = 0; v < 3; v++) {
+        auto vertex = triangle->GetVertex(v);
+        auto found = vertex_index.find(vertex);
+
+        if (found == vertex_index.end()) {
+          found = vertex_index.emplace(vertex, vertex_index.size()).first;
+
+          coordinates[p].push_back(vertex.x());
+          coordinates[p].push_back(vertex.y());
+          coordinates[p].push_back(vertex.z());
+        }
+
+        indices[p].push_back(found->second);
+      }
+    }
+  }
+
+  uint64_t offset = sizeof(BinaryHeader) + parts.size() * sizeof(BinaryPart);
+
+  for (size_t p = 0; p < meshes.size(); p++) {
+    parts[p] = BinaryPart();
+    parts[p].name_offset = offset;
+    parts[p].name_length = meshes[p]->GetName().size();
+    offset += parts[p].name_length;
+  }
+
+  for (size_t p = 0; p < meshes.size(); p++) {
+    parts[p].vertices = coordinates[p].size() / 3;
+    parts[p].triangles = indices[p].size() / 3;
+
+    parts[p].vertex_offset = offset = align(offset);
+    offset += coordinates[p].size() * sizeof(double);
+
+    parts[p].index_offset = offset = align(offset);
+    offset += indices[p].size() * sizeof(uint32_t);
+  }
+
+  std::ofstream file(filepath, std::ios::binary);
+
+  if (!file) {
+    return false;
+  }
+
+  BinaryHeader header;
+  std::memcpy(header.magic, BinaryMagic, sizeof(BinaryMagic));
+  header.parts = parts.size();
+  header.reserved = 0;
+
+  file.write((const char *)&header, sizeof(header));
+  file.write((const char *)parts.data(), parts.size() * sizeof(BinaryPart));
+
+  for (auto mesh : meshes) {
+    auto name = mesh->GetName();
+    file.write(name.data(), name.size());
+  }
+
+  auto pad_to = [&file](uint64_t position) {
+    while ((uint64_t)file.tellp() < position) {
+      file.put(0);
+    }
+  };
+
+  for (size_t p = 0; p < meshes.size(); p++) {
+    pad_to(parts[p].vertex_offset);
+    file.write((const char *)coordinates[p].data(),
+               coordinates[p].size() * sizeof(double));
+
+    pad_to(parts[p].index_offset);
+    file.write((const char *)indices[p].data(),
+               indices[p].size() * sizeof(uint32_t));
+  }
+
+  return (bool)file;
+}
+}
+}
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+
+namespace CADMesh {
+
+namespace File {
+
+// OBJ reader of the built-in reader: the file is split into its "o" groups,
+// large groups into pieces of whole lines, and the pieces are parsed by
+// several threads - first the vertices, then, with the vertex numbers known,
+// the facets.
+// The parts are assembled in the order of the file, so the meshes do not depend
+// on the number of threads. Reads what OBJReader reads (v, f with v/vt/vn
+// indices, o), polygons with more than four corners are split into a fan.
+class ParallelOBJReader : public Reader {
+public:
+  ParallelOBJReader() : Reader("ParallelOBJReader"){};
+
+  G4bool Read(G4String filepath);
+  G4bool CanRead(Type file_type);
+
+  // 0: one thread per core
+  static void SetThreads(G4int threads) { Threads() = threads; };
+  static G4int GetThreads() { return Threads(); };
+
+private:
+  struct Piece {
+    size_t begin;
+    size_t end;
+    size_t group;
+    size_t first_vertex = 0;
+    std::vector<double> coordinates;
+    std::vector<int64_t> indices; // 3 per triangle, 1-based as in the file
+    Triangles triangles;
+    std::string error;
+  };
+
+  static G4int &Threads() {
+    static G4int threads = 0;
+    return threads;
+  };
+
+  static void ParsePiece(const char *data, Piece &piece);
+  static void ForEach(size_t n, std::function<void(size_t)> function);
+};
+
+inline G4bool ParallelOBJReader::CanRead(Type file_type) {
+  return (file_type == OBJ);
+}
+
+inline void ParallelOBJReader::ForEach(size_t n,
+                                       std::function<void(size_t)> function) {
+  size_t threads =
+      Threads() > 0 ? Threads() : std::thread::hardware_concurrency();
+  threads = std::max<size_t>(1, std::min(threads, n));
+
+  if (threads == 1) {
+    for (size_t i = 0; i < n; i++) {
+      function(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+
+  for (size_t t = 0; t < threads; t++) {
+    pool.emplace_back([&]() {
+      for (size_t i = next++; i < n; i = next++) {
+        function(i);
+      }
+    });
+  }
+
+  for (auto &thread : pool) {
+    thread.join();
+  }
+}
+
+inline void ParallelOBJReader::ParsePiece(const char *data, Piece &piece) {
+  auto blank = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+
+  // the numbers are read with strtod/strtoll, which stop at the '\n' of the
+  // line; a last line without one is copied, so they never read past the file
+  auto parse_line = [&](const char *line, const char *line_end) {
+    auto p = line;
+    while (p < line_end && blank(*p)) {
+      p++;
+    }
+
+    if (line_end - p < 2 || !blank(p[1]) || (p[0] != 'v' && p[0] != 'f')) {
+      return true;
+    }
+
+    G4bool vertex = (p[0] == 'v');
+    std::vector<int64_t> corners;
+    p++;
+
+    while (true) {
+      while (p < line_end && blank(*p)) {
+        p++;
+      }
+
+      if (p >= line_end) {
+        break;
+      }
+
+      char *number_end;
+
+      if (vertex) {
+        double value = std::strtod(p, &number_end);
+        if (number_end == p) {
+          break;
+        }
+        if (corners.size() < 3) { // without the weight of "v x y z w"
+          piece.coordinates.push_back(value);
+        }
+        corners.push_back(0);
+      }
+
+      else {
+        int64_t index = std::strtoll(p, &number_end, 10);
+        if (number_end == p) {
+          break;
+        }
+        corners.push_back(index);
+      }
+
+      // texture and normal numbers of v/vt/vn
+      p = number_end;
+      while (p < line_end && !blank(*p)) {
+        p++;
+      }
+    }
+
+    if (vertex && corners.size() < 3) {
+      piece.error = "A vertex needs three numbers: '" +
+                    std::string(line, line_end) + "'";
+      return false;
+    }
+
+    if (!vertex && corners.size() < 3) {
+      piece.error = "A facet needs at least three vertices: '" +
+                    std::string(line, line_end) + "'";
+      return false;
+    }
+
+    for (size_t i = 1; !vertex && i + 1 < corners.size(); i++) {
+      piece.indices.push_back(corners[0]);
+      piece.indices.push_back(corners[i]);
+      piece.indices.push_back(corners[i + 1]);
+    }
+
+    return true;
+  };
+
+  const char *p = data + piece.begin;
+  const char *end = data + piece.end;
+
+  while (p < end) {
+    auto line_end = (const char *)std::memchr(p, '\n', end - p);
+
+    if (!line_end) {
+      std::string last_line(p, end);
+      parse_line(last_line.c_str(), last_line.c_str() + last_line.size());
+      return;
+    }
+
+    if (!parse_line(p, line_end)) {
+      return;
+    }
+
+    p = line_end + 1;
+  }
+}
+
+inline G4bool ParallelOBJReader::Read(G4String filepath) {
+  MappedFile file(filepath);
+
+  auto data = file.GetData();
+  auto size = file.GetSize();
+
+  if (!data || size == 0) {
+    Exceptions::ParserError("ParallelOBJReader::Read",
+                            "The OBJ file appears to be empty.");
+    return false;
+  }
+
+  // the groups: everything before the first "o" line is an unnamed group
+  std::vector<G4String> names(1);
+  std::vector<size_t> group_begin(1, 0);
+
+  for (size_t position = 0; position < size;) {
+    auto line = data + position;
+    auto line_end = (const char *)std::memchr(line, '\n', size - position);
+    size_t length = line_end ? line_end - line : size - position;
+
+    while (length > 0 && (*line == ' ' || *line == '\t')) {
+      line++;
+      length--;
+    }
+
+    if (length > 1 && line[0] == 'o' && (line[1] == ' ' || line[1] == '\t')) {
+      std::string name(line + 2, length - 2);
+      name.erase(0, name.find_first_not_of(" \t"));
+      name.erase(name.find_last_not_of(" \t\r") + 1);
+
+      names.push_back(name);
+      group_begin.push_back(line_end ? line_end - data + 1 : size);
+    }
+
+    position = line_end ? line_end - data + 1 : size;
+  }
+
+  group_begin.push_back(size);
+
+  // pieces of at most a few MB, cut at line ends
+  const size_t piece_size = 4 << 20;
+  std::vector<Piece> pieces;
+
+  for (size_t g = 0; g < names.size(); g++) {
+    size_t begin = group_begin[g];
+    size_t group_end = group_begin[g + 1];
+
+    while (begin < group_end) {
+      size_t end = std::min(begin + piece_size, group_end);
+
+      if (end < group_end) {
+        auto line_end =
+            (const char *)std::memchr(data + end, '\n', group_end - end);
+        end = line_end ? line_end - data + 1 : group_end;
+      }
+
+      Piece piece;
+      piece.begin = begin;
+      piece.end = end;
+      piece.group = g;
+      pieces.push_back(std::move(piece));
+
+      begin = end;
+    }
+  }
+
+  ForEach(pieces.size(), [&](size_t i) { ParsePiece(data, pieces[i]); });
+
+  Points vertices;
+  for (auto &piece : pieces) {
+    if (piece.error != "") {
+      Exceptions::ParserError("ParallelOBJReader::Read", piece.error);
+      return false;
+    }
+
+    piece.first_vertex = vertices.size();
+
+    for (size_t i = 0; i + 2 < piece.coordinates.size(); i += 3) {
+      vertices.push_back(G4ThreeVector(piece.coordinates[i],
+                                       piece.coordinates[i + 1],
+                                       piece.coordinates[i + 2]));
+    }
+
+    piece.coordinates = std::vector<double>();
+  }
+
+  // created before the threads construct facets with it
+  G4GeometryTolerance::GetInstance();
+
+  ForEach(pieces.size(), [&](size_t i) {
+    auto &piece = pieces[i];
+    piece.triangles.reserve(piece.indices.size() / 3);
+
+    for (size_t t = 0; t + 2 < piece.indices.size(); t += 3) {
+      auto a = piece.indices[t] - 1;
+      auto b = piece.indices[t + 1] - 1;
+      auto c = piece.indices[t + 2] - 1;
+      int64_t n = vertices.size();
+
+      if (a < 0 || b < 0 || c < 0 || a >= n || b >= n || c >= n) {
+        std::stringstream error;
+        error << "A facet of '" << names[piece.group]
+              << "' uses a vertex which does not exist (" << a + 1 << " "
+              << b + 1 << " " << c + 1 << " of " << n << " vertices).";
+        piece.error = error.str();
+        return;
+      }
+
+      piece.triangles.push_back(new G4TriangularFacet(
+          vertices[a], vertices[b], vertices[c], ABSOLUTE));
+    }
+  });
+
+  std::vector<Triangles> groups(names.size());
+  for (auto &piece : pieces) {
+    if (piece.error != "") {
+      Exceptions::ParserError("ParallelOBJReader::Read", piece.error);
+      return false;
+    }
+
+    groups[piece.group].insert(groups[piece.group].end(),
+                               piece.triangles.begin(), piece.triangles.end());
+  }
+
+  for (size_t g = 0; g < groups.size(); g++) {
+    if (groups[g].size() == 0) {
+      continue;
+    }
+
+    AddMesh(Mesh::New(groups[g], names[g]));
+  }
+
+  if (GetNumberOfMeshes() == 0) {
+    Exceptions::ParserError("ParallelOBJReader::Read",
+                            "The OBJ file has no facets.");
+    return false;
+  }
+
+  return true;
+}
+}
+}
+
+namespace CADMesh {
+
+namespace File {
+
+inline G4bool ReadTetGen(G4String filepath, Tetrahedra &tetrahedra) {
+  auto base = filepath;
+  auto type = TypeFromName(filepath);
+  auto dot = filepath.find_last_of('.');
+
+  if (type == NODE || filepath.substr(dot + 1) == "ele") {
+    base = filepath.substr(0, dot);
+  }
+
+  std::ifstream node_file(base + ".node");
+  if (!node_file.good()) {
+    Exceptions::FileNotFound("ReadTetGen", base + ".node");
+    return false;
+  }
+
+  std::ifstream ele_file(base + ".ele");
+  if (!ele_file.good()) {
+    Exceptions::FileNotFound("ReadTetGen", base + ".ele");
+    return false;
+  }
+
+  // the next line with data, without the comment after '#'
+  std::string line;
+  auto read_line = [&line](std::ifstream &file, std::istringstream &stream) {
+    while (std::getline(file, line)) {
+      line = line.substr(0, line.find('#'));
+
+      if (line.find_first_not_of(" \t\r") != std::string::npos) {
+        stream.clear();
+        stream.str(line);
+        return true;
+      }
+    }
+
+    return false;
+  };
+
+  std::istringstream stream;
+  size_t points = 0, elements = 0;
+  G4int dimension = 0, corners = 0, attributes = 0;
+
+  if (!read_line(node_file, stream) || !(stream >> points >> dimension) ||
+      dimension != 3) {
+    Exceptions::ParserError("ReadTetGen",
+                            base + ".node has no header of 3D points.");
+    return false;
+  }
+
+  tetrahedra.nodes.assign(points, G4ThreeVector());
+
+  // the numbering starts at the index of the first point, 0 or 1
+  size_t first = 0;
+
+  for (size_t i = 0; i < points; i++) {
+    size_t index = 0;
+    G4double x, y, z;
+
+    if (!read_line(node_file, stream) || !(stream >> index >> x >> y >> z) ||
+        (i > 0 && (index < first || index - first >= points))) {
+      std::stringstream error;
+      error << "Point " << i << " of " << base << ".node is invalid.";
+
+      Exceptions::ParserError("ReadTetGen", error.str());
+      return false;
+    }
+
+    if (i == 0) {
+      first = index;
+    }
+
+    tetrahedra.nodes[index - first] = G4ThreeVector(x, y, z);
+  }
+
+  if (!read_line(ele_file, stream) ||
+      !(stream >> elements >> corners >> attributes) ||
+      (corners != 4 && corners != 10)) {
+    Exceptions::ParserError("ReadTetGen",
+                            base + ".ele has no header of tetrahedra.");
+    return false;
+  }
+
+  tetrahedra.elements.resize(elements);
+  tetrahedra.regions.assign(elements, 0);
+
+  for (size_t e = 0; e < elements; e++) {
+    size_t index = 0;
+    std::array<size_t, 4> element;
+    G4bool valid = read_line(ele_file, stream) && (stream >> index);
+
+    for (G4int c = 0; valid && c < corners; c++) {
+      size_t node = 0;
+      valid = (stream >> node) && node >= first && node - first < points;
+
+      if (valid && c < 4) {
+        element[c] = node - first;
+      }
+    }
+
+    G4double region = 0.;
+    if (valid && attributes > 0) {
+      valid = (G4bool)(stream >> region);
+    }
+
+    if (!valid) {
+      std::stringstream error;
+      error << "Tetrahedron " << e << " of " << base
+            << ".ele is invalid or uses a point which does not exist.";
+
+      Exceptions::ParserError("ReadTetGen", error.str());
+      return false;
+    }
+
+    tetrahedra.elements[e] = element;
+    tetrahedra.regions[e] = (G4int)std::lround(region);
+  }
+
+  return true;
+}
+
+inline G4bool TetGenReader::Read(G4String filepath) {
+  auto tetrahedra = std::make_shared<Tetrahedra>();
+
+  if (!ReadTetGen(filepath, *tetrahedra)) {
+    return false;
+  }
+
+  // faces by their sorted corners, with the number of tetrahedra they belong
+  // to and the corners in the order which points out of the tetrahedron
+  typedef std::array<size_t, 3> Face;
+  std::map<Face, std::pair<G4int, Face>> faces;
+
+  auto &nodes = tetrahedra->nodes;
+
+  for (auto &element : tetrahedra->elements) {
+    for (G4int opposite = 0; opposite < 4; opposite++) {
+      Face face;
+      G4int n = 0;
+
+      for (G4int c = 0; c < 4; c++) {
+        if (c != opposite) {
+          face[n++] = element[c];
+        }
+      }
+
+      auto normal = (nodes[face[1]] - nodes[face[0]])
+                        .cross(nodes[face[2]] - nodes[face[0]]);
+
+      if (normal.dot(nodes[element[opposite]] - nodes[face[0]]) > 0.) {
+        std::swap(face[1], face[2]);
+      }
+
+      auto key = face;
+      std::sort(key.begin(), key.end());
+
+      auto &entry = faces[key];
+      entry.first++;
+      entry.second = face;
+    }
+  }
+
+  Triangles triangles;
+
+  for (auto &entry : faces) {
+    if (entry.second.first == 1) {
+      auto &face = entry.second.second;
+      triangles.push_back(new G4TriangularFacet(
+          nodes[face[0]], nodes[face[1]], nodes[face[2]], ABSOLUTE));
+    }
+  }
+
+  auto name = filepath.substr(0, filepath.find_last_of('.'));
+  name = name.substr(name.find_last_of("/\\") + 1);
+
+  auto mesh = Mesh::New(triangles, name);
+  AddMesh(mesh);
+
+  // the entries of the meshes which are gone are dropped, a new mesh may have
+  // the same address
+  std::lock_guard<std::mutex> lock(Mutex());
+
+  for (auto entry = Entries().begin(); entry != Entries().end();) {
+    entry = entry->second.mesh.expired() ? Entries().erase(entry) : ++entry;
+  }
+
+  Entries()[mesh.get()] = {mesh, tetrahedra};
+
+  return true;
+}
+
+inline G4bool TetGenReader::CanRead(Type file_type) {
+  return file_type == NODE;
+}
+
+inline std::shared_ptr<const Tetrahedra>
+TetGenReader::GetTetrahedra(std::shared_ptr<Mesh> mesh) {
+  std::lock_guard<std::mutex> lock(Mutex());
+
+  auto entry = Entries().find(mesh.get());
+  if (entry != Entries().end() && entry->second.mesh.lock() == mesh) {
+    return entry->second.tetrahedra;
+  }
+
+  return nullptr;
+}
+}
+}
+
+#ifndef USE_CADMESH_TETGEN
+
+namespace CADMesh {
+
+// All tetrahedra of a TetrahedralMesh in one G4PVParameterised
+// (TetrahedralMesh::GetParameterisedVolume). The tetrahedra are at their place
+// in the mother volume already, the copy number is the index of the
+// tetrahedron.
+class TetParameterisation : public G4VPVParameterisation {
+public:
+  TetParameterisation(std::vector<G4Tet *> solids,
+                      std::vector<G4Material *> materials)
+      : solids_(solids), materials_(materials){};
+
+  void ComputeTransformation(const G4int, G4VPhysicalVolume *) const {};
+
+  G4VSolid *ComputeSolid(const G4int copy, G4VPhysicalVolume *) {
+    return solids_[copy];
+  };
+
+  G4Material *ComputeMaterial(const G4int copy, G4VPhysicalVolume *,
+                              const G4VTouchable *) {
+    return materials_[copy];
+  };
+
+private:
+  std::vector<G4Tet *> solids_;
+  std::vector<G4Material *> materials_;
+};
+
+// Without TetGen (USE_CADMESH_TETGEN) only pre-tetrahedralized meshes are
+// read, from .node/.ele files (From("part.node")). With TetGen the
+// TetrahedralMesh of CADMesh.hh is used.
+class TetrahedralMesh : public CADMeshTemplate<TetrahedralMesh> {
+public:
+  using CADMeshTemplate::CADMeshTemplate;
+
+  TetrahedralMesh();
+  ~TetrahedralMesh();
+
+public:
+  G4VSolid *GetSolid();
+  G4VSolid *GetSolid(G4int index);
+  G4VSolid *GetSolid(G4String name, G4bool exact = true);
+
+  std::vector<G4VSolid *> GetSolids();
+
+  G4AssemblyVolume *GetAssembly();
+
+  // all tetrahedra as one G4PVParameterised in a box around the mesh, filled
+  // with the material around the part. The box is placed like the solids of a
+  // TessellatedMesh; the replica number of a step in it is the index of its
+  // tetrahedron, for scoring per tetrahedron.
+  G4LogicalVolume *GetParameterisedVolume(G4Material *surrounding);
+
+  size_t GetNumberOfTetrahedra();
+
+public:
+  void SetMaterial(G4Material *material) { this->material_ = material; };
+
+  G4Material *GetMaterial() { return this->material_; };
+
+  // the material of the tetrahedra with this region attribute, the others are
+  // of SetMaterial
+  void SetMaterial(G4int region, G4Material *material) {
+    this->region_materials_[region] = material;
+  };
+
+private:
+  void Load();
+  G4ThreeVector GetTetPoint(size_t tet, G4int corner);
+  G4Material *GetTetMaterial(size_t tet);
+
+private:
+  std::shared_ptr<const File::Tetrahedra> tetrahedra_ =
+      std::make_shared<File::Tetrahedra>(); // shared with File::TetGenReader
+  G4bool loaded_ = false;
+
+  std::vector<G4Tet *> solids_;
+  G4LogicalVolume *parameterised_ = nullptr;
+
+  G4Material *material_ = nullptr;
+  std::map<G4int, G4Material *> region_materials_;
+};
+}
+
+namespace CADMesh {
+
+inline TetrahedralMesh::TetrahedralMesh() {}
+
+inline TetrahedralMesh::~TetrahedralMesh() {}
+
+inline G4VSolid *TetrahedralMesh::GetSolid() { return GetSolid(0); }
+
+inline G4VSolid *TetrahedralMesh::GetSolid(G4int index) {
+  auto solids = GetSolids();
+
+  if (index < 0 || (size_t)index >= solids.size()) {
+    Exceptions::MeshNotFound("TetrahedralMesh::GetSolid", index);
+    return nullptr;
+  }
+
+  return solids[index];
+}
+
+inline G4VSolid *TetrahedralMesh::GetSolid(G4String name, G4bool exact) {
+  for (auto solid : GetSolids()) {
+    if (exact ? solid->GetName() == name
+              : solid->GetName().find(name) != std::string::npos) {
+      return solid;
+    }
+  }
+
+  Exceptions::MeshNotFound("TetrahedralMesh::GetSolid", name);
+  return nullptr;
+}
+
+inline std::vector<G4VSolid *> TetrahedralMesh::GetSolids() {
+  Load();
+
+  if (solids_.empty()) {
+    size_t degenerate = 0;
+
+    for (size_t i = 0; i < tetrahedra_->elements.size(); i++) {
+      G4String tet_name = file_name_ + G4String("_tet_") +
+                          G4UIcommand::ConvertToString((G4int)i);
+
+      G4bool is_degenerate = false;
+      solids_.push_back(new G4Tet(tet_name + G4String("_solid"),
+                                  GetTetPoint(i, 0), GetTetPoint(i, 1),
+                                  GetTetPoint(i, 2), GetTetPoint(i, 3),
+                                  &is_degenerate));
+
+      if (is_degenerate) {
+        degenerate++;
+      }
+    }
+
+    if (degenerate > 0) {
+      G4cout << "\n--> warning from CADMesh : " << degenerate << " of "
+             << solids_.size() << " tetrahedra of " << file_name_
+             << " are degenerate" << G4endl;
+    }
+  }
+
+  return std::vector<G4VSolid *>(solids_.begin(), solids_.end());
+}
+
+inline G4AssemblyVolume *TetrahedralMesh::GetAssembly() {
+  if (assembly_) {
+    return assembly_;
+  }
+
+  assembly_ = new G4AssemblyVolume();
+
+  G4RotationMatrix *element_rotation = new G4RotationMatrix();
+  G4ThreeVector element_position = G4ThreeVector();
+
+  auto solids = GetSolids();
+
+  for (size_t i = 0; i < solids.size(); i++) {
+    auto tet_logical = new G4LogicalVolume(
+        solids[i], GetTetMaterial(i),
+        solids[i]->GetName() + G4String("_logical"), 0, 0, 0);
+
+    assembly_->AddPlacedVolume(tet_logical, element_position, element_rotation);
+  }
+
+  return assembly_;
+}
+
+inline G4LogicalVolume *
+TetrahedralMesh::GetParameterisedVolume(G4Material *surrounding) {
+  if (parameterised_) {
+    return parameterised_;
+  }
+
+  auto solids = GetSolids();
+
+  if (solids.empty()) {
+    Exceptions::MeshNotFound("TetrahedralMesh::GetParameterisedVolume", 0);
+    return nullptr;
+  }
+
+  G4ThreeVector low(DBL_MAX, DBL_MAX, DBL_MAX);
+  G4ThreeVector high(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+  std::vector<G4Material *> materials;
+
+  for (size_t i = 0; i < solids.size(); i++) {
+    for (G4int corner = 0; corner < 4; corner++) {
+      auto point = GetTetPoint(i, corner);
+
+      for (G4int k = 0; k < 3; k++) {
+        low[k] = std::min(low[k], point[k]);
+        high[k] = std::max(high[k], point[k]);
+      }
+    }
+
+    materials.push_back(GetTetMaterial(i));
+  }
+
+  // the box around the tetrahedra, in the frame of the mesh, larger by the
+  // surface tolerance so that the faces of the tetrahedra on it do not touch it
+  auto tolerance = G4GeometryTolerance::GetInstance()->GetSurfaceTolerance();
+  auto box = new G4Box(file_name_ + "_envelope_box",
+                       (high.x() - low.x()) / 2. + tolerance,
+                       (high.y() - low.y()) / 2. + tolerance,
+                       (high.z() - low.z()) / 2. + tolerance);
+
+  auto envelope = new G4DisplacedSolid(file_name_ + "_envelope", box, nullptr,
+                                       (low + high) / 2.);
+
+  parameterised_ = new G4LogicalVolume(envelope, surrounding,
+                                       file_name_ + "_envelope_logical");
+
+  auto tet_logical =
+      new G4LogicalVolume(solids[0], materials[0], file_name_ + "_tet_logical");
+
+  // kUndefined: the navigator builds smart voxels over the tetrahedra
+  new G4PVParameterised(file_name_ + "_tets", tet_logical, parameterised_,
+                        kUndefined, (G4int)solids.size(),
+                        new TetParameterisation(solids_, materials));
+
+  return parameterised_;
+}
+
+inline size_t TetrahedralMesh::GetNumberOfTetrahedra() {
+  Load();
+  return tetrahedra_->elements.size();
+}
+
+inline void TetrahedralMesh::Load() {
+  if (loaded_) {
+    return;
+  }
+
+  loaded_ = true;
+
+  if (file_type_ == File::NODE ||
+      File::TypeFromName(file_name_) == File::NODE) {
+    // the tetrahedra of the read in the constructor, the files are parsed
+    // again only if they were read by another reader than File::TetGenReader
+    auto tetrahedra = File::TetGenReader::GetTetrahedra(reader_->GetMesh());
+
+    if (!tetrahedra) {
+      auto parsed = std::make_shared<File::Tetrahedra>();
+      File::ReadTetGen(file_name_, *parsed);
+      tetrahedra = parsed;
+    }
+
+    tetrahedra_ = tetrahedra;
+    return;
+  }
+
+  G4Exception("CADMesh in TetrahedralMesh::Load", "TetGenNotAvailable",
+              FatalException,
+              ("\nWithout TetGen (USE_CADMESH_TETGEN) only pre-tetrahedralized"
+               " meshes (.node/.ele) can be read:\n\t" +
+               file_name_)
+                  .c_str());
+}
+
+inline G4ThreeVector TetrahedralMesh::GetTetPoint(size_t tet, G4int corner) {
+  return tetrahedra_->nodes[tetrahedra_->elements[tet][corner]] * scale_ +
+         offset_;
+}
+
+inline G4Material *TetrahedralMesh::GetTetMaterial(size_t tet) {
+  auto region = region_materials_.find(tetrahedra_->regions[tet]);
+  auto material =
+      region == region_materials_.end() ? material_ : region->second;
+
+  if (!material) {
+    Exceptions::MaterialNotFound("TetrahedralMesh::GetTetMaterial",
+                                 tetrahedra_->regions[tet]);
+  }
+
+  return material;
+}
+}
+
+#endif
+
+namespace CADMesh {
+
+namespace Hooks {
+
+inline G4bool Read(File::Reader *reader, G4String filepath) {
+  return File::MeshCache::Read(reader, filepath);
+}
+
+inline File::Reader *NewReader(File::Type type) {
+  if (type == File::OBJ) {
+    return new File::ParallelOBJReader();
+  }
+
+  else if (type == File::CMB) {
+    return new File::BinaryReader();
+  }
+
+  else if (type == File::NODE) {
+    return new File::TetGenReader();
+  }
+
+  return nullptr;
+}
+
+inline G4bool CanRead(File::Type type) {
+  return type == File::CMB || type == File::NODE;
+}
+
+inline G4VSolid *GetSolid(TessellatedMesh *tessellated,
+                          std::shared_ptr<Mesh> mesh) {
+  auto tolerance = PrimitiveFitter::GetDefaultTolerance();
+
+  if (tolerance > 0.) {
+    PrimitiveFitter fitter(mesh->GetTriangles(), tessellated->GetScale(),
+                           tessellated->GetOffset());
+
+    if (fitter.Run(tolerance)) {
+      G4cout << "CADMesh: replaced '" << mesh->GetName() << "' by "
+             << fitter.GetDescription() << ", max deviation "
+             << fitter.GetMaxDeviation() << " mm" << G4endl;
+
+      return fitter.GetSolid(mesh->GetName());
+    }
+
+    G4cout << "CADMesh: '" << mesh->GetName()
+           << "' stays a G4TessellatedSolid, it is no box, tube or cone within "
+           << tolerance << " mm" << G4endl;
+  }
+
+  return (G4VSolid *)tessellated->GetTessellatedSolid(mesh);
+}
+
+inline std::shared_ptr<const Triangles> Decimate(std::shared_ptr<Mesh> mesh,
+                                                 G4double scale) {
+  auto tolerance = Decimator::GetDefaultTolerance();
+
+  if (tolerance <= 0.) {
+    return nullptr;
+  }
+
+  auto result = DecimationCache::Get(mesh, tolerance / scale);
+
+  if (!result.closed) {
+    G4cout << "\n--> warning from CADMesh : '" << mesh->GetName()
+           << "' is not closed, it is not decimated" << G4endl;
+    return nullptr;
+  }
+
+  G4cout << "CADMesh: decimated '" << mesh->GetName() << "' from "
+         << result.facets_before << " to " << result.triangles->size()
+         << " facets, max sampled deviation " << result.max_deviation * scale
+         << " mm" << (result.cached ? " (cached)" : "") << G4endl;
+
+  return result.triangles;
+}
+}
+}
@@ -0,0 +1,34 @@
+#ifndef CADMessenger_h
+#define CADMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class G4UIdirectory;
+class G4UIcmdWithABool;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithADoubleAndUnit;
+class G4UIcmdWithoutParameter;
+
+
+class CADMessenger: public G4UImessenger
+{
+  public:
+    CADMessenger();
+   ~CADMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    G4UIdirectory*             fCADDir;
+
+    G4UIcmdWithABool*          fCacheCmd;
+    G4UIcmdWithoutParameter*   fPrintCacheCmd;
+    G4UIcmdWithoutParameter*   fClearCacheCmd;
+    G4UIcmdWithAnInteger*      fThreadsCmd;
+    G4UIcmdWithADoubleAndUnit* fDecimateCmd;
+    G4UIcmdWithADoubleAndUnit* fPrimitivesCmd;
+};
+
+
+#endif
@@ -8,6 +8,10 @@ class G4VPhysicalVolume;
 class G4LogicalVolume;
 class G4Material;
 class DetectorMessenger;
+class CADMessenger;
+class TrackKiller;
+class GeometryValidator;
+class GeometryBuilder;
 
 
 class DetectorConstruction : public G4VUserDetectorConstruction
@@ -23,6 +27,8 @@ class DetectorConstruction : public G4VUserDetectorConstruction
     virtual void ConstructSDandField();
 
     G4LogicalVolume* GetScoringVolume() const { return fScoringVolume; }
+    TrackKiller*     GetTrackKiller()   const { return fTrackKiller; }
+    GeometryValidator* GetGeometryValidator() const { return fGeometryValidator; }
 
     void SetOutputFolder (std::string);
     void SetAbsorMaterial (G4String);
@@ -34,6 +40,9 @@ class DetectorConstruction : public G4VUserDetectorConstruction
     void change_e   (G4double);
     void change_f   (G4double);
 
+    void SetGeometryFile      (G4String);
+    void SetGeometryParameter (G4String, G4String);
+
   public:  
 
    G4double GetAbsorThickness()    {return boxX;};
@@ -101,11 +110,16 @@ class DetectorConstruction : public G4VUserDetectorConstruction
    G4Material*        BoratedPE;               
 
    DetectorMessenger* fDetectorMessenger;
+   CADMessenger*      fCADMessenger;
+   TrackKiller*       fTrackKiller;
+   GeometryValidator* fGeometryValidator;
+   GeometryBuilder*   fGeometryBuilder;
 
   private:
 
    void               DefineMaterials();
    G4VPhysicalVolume* ConstructVolumes(); 
+   void               ClearRegions();
 
   protected:
     G4LogicalVolume*  fScoringVolume;    
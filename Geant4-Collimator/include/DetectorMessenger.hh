@@ -37,6 +37,14 @@ class DetectorMessenger: public G4UImessenger
     G4UIcmdWithADoubleAndUnit* fchange_dCmd;
     G4UIcmdWithADoubleAndUnit* fchange_eCmd; 
     G4UIcmdWithADoubleAndUnit* fchange_fCmd;
+
+    G4UIcmdWithAString*        fGeoFileCmd;
+    G4UIcommand*               fGeoParamCmd;
+
+    G4UIdirectory*             fKillDir;
+    G4UIcommand*               fKillTimeCmd;
+    G4UIcommand*               fKillEnergyCmd;
+    G4UIcmdWithoutParameter*   fKillClearCmd;
 };
 
 
@@ -0,0 +1,78 @@
+#ifndef EventWatchdog_h
+#define EventWatchdog_h 1
+
+#include "globals.hh"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+class WatchdogMessenger;
+class G4Event;
+class G4Step;
+
+//
+// Slow-event watchdog: events running longer than a threshold are reported with the state of the random engine at
+// the start of the event, so they can be replayed with /custom/watchdog/replay under SteppingVerbose.
+// See EventWatchdog.cc; created once in main() - see ColliRotate.cc; the commands are in WatchdogMessenger.cc
+//
+class EventWatchdog
+{
+  public:
+    EventWatchdog();
+   ~EventWatchdog();
+
+    static EventWatchdog* Instance() { return fgInstance; }
+
+  public:
+    void SetThreshold(G4double t)   { fgThreshold = t; }     // seconds, 0 = off
+    void SetMaxReports(G4int n)     { fMaxReports = n; }
+    void Replay(G4String fileName, G4int verboseLevel);     // run the event of a report once more
+
+    static G4bool IsEnabled() { return fgThreshold > 0.; }
+
+    // user actions of the worker threads
+    void BeginOfEvent(G4Event*);            // PrimaryGeneratorAction, before the primaries are generated
+    void EndOfEvent(const G4Event*);
+    static void CountTrack() { Local().fTracks++; }
+    static void Step(const G4Step* step)
+    {
+      ThreadData& data = Local();
+      data.fSteps++;
+      if (data.fSlow) CountStep(step);
+      else if ((data.fSteps & 255) == 0 && Elapsed(data) > fgThreshold) Instance()->StartReport(data);
+    }
+
+  private:
+    struct ThreadData {
+      std::chrono::steady_clock::time_point fStart;
+      G4String fEngineState;                        // G4Random::saveFullState at the start of the event
+      G4long   fEvent  = 0;                         // global event number
+      G4int    fRun    = 0;
+      G4long   fTracks = 0, fSteps = 0;
+      G4bool   fSlow   = false;                     // threshold crossed in this event
+      G4String fStateFile;
+      std::map<G4String,G4long> fVolumes, fProcesses;   // steps after the threshold was crossed
+    };
+
+    static ThreadData& Local() { return fgLocal ? *fgLocal : Register(); }
+    static ThreadData& Register();
+    static G4double Elapsed(const ThreadData& data)
+      { return std::chrono::duration<G4double>(std::chrono::steady_clock::now() - data.fStart).count(); }
+    static void CountStep(const G4Step*);
+    void StartReport(ThreadData&);
+
+    static EventWatchdog*             fgInstance;
+    static G4double                   fgThreshold;
+    static G4ThreadLocal ThreadData*  fgLocal;
+    static std::vector<std::unique_ptr<ThreadData>> fgThreadData;   // owns the data of all threads
+
+    WatchdogMessenger* fWatchdogMessenger;
+    G4int              fMaxReports;
+    std::atomic<G4int> fNbOfReports;
+    G4String           fReplayState;                // engine state of the event being replayed
+};
+
+
+#endif
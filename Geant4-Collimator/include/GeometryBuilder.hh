@@ -0,0 +1,72 @@
+#ifndef GeometryBuilder_h
+#define GeometryBuilder_h 1
+
+#include "globals.hh"
+#include "G4VisAttributes.hh"
+#include "G4RotationMatrix.hh"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+class G4VPhysicalVolume;
+class G4LogicalVolume;
+class G4VSolid;
+
+//
+// Builds the geometry from a text file of parameters, solids, volumes and placements (see Collimator.geo) instead of
+// DetectorConstruction::ConstructVolumes. All numbers are expressions of units and parameters. Solids and logical
+// volumes are kept between the builds by a hash of their content, so a /custom/geo/change_x or /custom/geo/param
+// rebuilds only what depends on the changed parameter. Set with /custom/geo/file - see DetectorMessenger.cc
+//
+class GeometryBuilder
+{
+  public:
+    GeometryBuilder();
+   ~GeometryBuilder();
+
+  public:
+    // "none" = the geometry of ConstructVolumes
+    void     SetFile(G4String fileName);
+    G4String GetFile() const  { return fFileName; }
+    G4bool   HasFile() const  { return !fFileName.empty() && fFileName != "none"; }
+
+    // replaces the expression of a parameter of the file, e.g. SetParameter("b", "3*cm")
+    void     SetParameter(G4String name, G4String expression);
+    void     SetParameter(G4String name, G4double value);
+
+    // a new world from the file; the physical volumes are always new, solids and logical volumes only if their
+    // content changed. Fatal exception on an error in the file
+    G4VPhysicalVolume* Build(G4bool checkOverlaps);
+
+    // forget the cached solids and volumes - before the stores are cleaned by ConstructVolumes
+    void     Forget();
+
+  private:
+    struct Statement {
+      G4int                 fLine;
+      std::vector<G4String> fTokens;
+    };
+
+    struct CachedVolume {
+      G4LogicalVolume*      fVolume;
+      G4VisAttributes       fVisAttributes;
+    };
+
+    G4bool   Read(std::vector<Statement>& statements) const;
+    void     ClearRegions();
+    void     RemoveStale(std::set<G4VSolid*> solids, const std::set<G4LogicalVolume*>& volumes);
+
+    G4String                                       fFileName;
+    std::map<G4String,G4String>                    fOverrides;
+
+    std::map<uint64_t,G4VSolid*>                   fSolids;          // by content hash
+    std::map<uint64_t,CachedVolume>                fVolumes;
+    std::vector<std::unique_ptr<G4RotationMatrix>> fRotations;       // of the current placements
+    std::set<G4String>                             fRegions;         // with root volumes from the file
+};
+
+
+#endif
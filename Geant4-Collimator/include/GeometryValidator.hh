@@ -0,0 +1,89 @@
+#ifndef GeometryValidator_h
+#define GeometryValidator_h 1
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+#include "G4AffineTransform.hh"
+
+#include <cstdint>
+#include <vector>
+
+class G4VPhysicalVolume;
+class ValidatorMessenger;
+
+//
+// Overlap checks of the whole geometry after it is built, instead of one G4PVPlacement::CheckOverlaps per placement
+// during ConstructVolumes. The checks of all placements run in parallel, and a geometry which passed is recorded
+// with its hash in a cache file, so later runs of the same geometry skip them. Set with the /custom/overlaps/
+// commands - see ValidatorMessenger.cc
+//
+class GeometryValidator
+{
+  public:
+    GeometryValidator();
+   ~GeometryValidator();
+
+  public:
+    // when the overlaps are checked: kPlacement = by every G4PVPlacement (as before), kDeferred = once the
+    // geometry is built (default), kOff = never
+    enum CheckMode { kOff = 0, kPlacement = 1, kDeferred = 2 };
+
+    void SetMode      (CheckMode mode)    { fMode = mode; }
+    void SetResolution(G4int points)      { fResolution = points; }
+    void SetTolerance (G4double tol)      { fTolerance = tol; }
+    void SetThreads   (G4int threads)     { fThreads = threads; }
+    void SetCacheFile (G4String fileName) { fCacheFile = fileName; }
+
+    CheckMode GetMode() const             { return fMode; }
+
+    // argument pSurfChk of the G4PVPlacements in ConstructVolumes
+    G4bool IsCheckedAtPlacement() const   { return fMode == kPlacement; }
+
+    // call from DetectorConstruction::Construct with the new world: checks it in kDeferred mode unless the cache
+    // has it; returns the number of overlaps found (0 if skipped)
+    G4int Validate(G4VPhysicalVolume* world);
+
+    // /custom/overlaps/validate: checks the last constructed world now, in any mode and ignoring the cache
+    G4int ValidateNow();
+
+    // hash of the placement tree: names, copy numbers, transformations, materials and solid parameters
+    static uint64_t GeometryHash(G4VPhysicalVolume* world);
+
+  private:
+    struct Overlap {
+      G4String           fOther;          // sister, or the mother logical volume if fProtrudes
+      G4double           fDepth;          // < 0: the sister lies completely inside the daughter
+      G4ThreeVector      fPoint;          // in the frame of the mother
+      G4bool             fProtrudes;
+    };
+
+    // one placement with its surface points in the frame of its mother
+    struct Check {
+      G4VPhysicalVolume*         fVolume;
+      G4AffineTransform          fTransform;      // daughter -> mother
+      std::vector<G4ThreeVector> fPoints;
+      G4ThreeVector              fMin, fMax;      // extent in the frame of the mother
+      std::vector<std::size_t>   fSisters;
+      std::vector<Overlap>       fOverlaps;
+    };
+
+    G4int  Run(G4VPhysicalVolume* world, uint64_t hash);
+    void   Prepare(G4VPhysicalVolume* world, std::vector<Check>& checks) const;
+    void   CheckOne(std::vector<Check>& checks, std::size_t index) const;
+
+    G4bool IsCached(uint64_t hash) const;
+    void   AddToCache(uint64_t hash, G4int overlaps) const;
+
+    CheckMode            fMode;
+    G4int                fResolution;
+    G4double             fTolerance;
+    G4int                fThreads;        // 0 = one per core
+    G4String             fCacheFile;
+
+    G4VPhysicalVolume*   fWorld;          // of the last Construct
+
+    ValidatorMessenger*  fMessenger;
+};
+
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef HitFile_h
+#define HitFile_h 1
+
+// No Geant4 types in here - the reader is also used by analysis programs which do not link Geant4.
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//
+// Compact columnar hit files (.hits), written by the writer thread - see OutputWriter.cc and HitFile.cc
+//
+// File layout, native byte order, every block starts at a multiple of 8 bytes:
+//   FileHeader, fTextSize bytes of "key value" lines (schema, run parameters, seeds), padding
+//   chunks: ChunkHeader, int64 event[rows], Ekin[rows], X[rows], Y[rows], time[rows]
+// The columns are float32 or float64 (FileHeader::fValueSize), in MeV, cm, cm, ns like the ntuples.
+//
+namespace HitFile
+{
+  const char     kMagic[8]    = { 'C','R','H','I','T','S','0','1' };
+  const uint32_t kNbOfColumns = 4;                    // Ekin, X, Y, time
+  const uint32_t kNbOfTables  = 5;                    // index = ntuple ID: 1 N_SD1, 2 g_SD1, 3 N_SD2, 4 g_SD2
+
+  struct FileHeader {
+    char     fMagic[8];
+    uint32_t fValueSize;                              // 4 = float32, 8 = float64
+    uint32_t fTextSize;
+  };
+
+  struct ChunkHeader {
+    uint32_t fTable;
+    uint32_t fRows;
+    uint64_t fSize;                                   // bytes of the chunk after this header
+  };
+
+  inline uint64_t Padded(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+}
+
+
+class HitFileWriter
+{
+  public:
+    HitFileWriter();
+   ~HitFileWriter();
+
+    bool Open(const std::string& fileName, uint32_t valueSize, const std::string& text);
+    void Fill(uint32_t table, int64_t event, double ekin, double x, double y, double time);
+    void Close();
+
+    uint64_t GetBytesWritten() const { return fBytesWritten; }
+
+  private:
+    void WriteChunk(uint32_t table);
+    void WritePadded(const void* data, uint64_t size);
+
+    struct Table {
+      std::vector<int64_t> fEvents;
+      std::vector<double>  fColumns[HitFile::kNbOfColumns];
+    };
+
+    std::FILE*        fFile;
+    uint32_t          fValueSize;
+    uint32_t          fChunkRows;
+    Table             fTables[HitFile::kNbOfTables];
+    std::vector<char> fScratch;
+    uint64_t          fBytesWritten;
+};
+
+
+class HitFileReader
+{
+  public:
+    struct Chunk {
+      uint32_t       fTable;
+      uint32_t       fRows;
+      const int64_t* fEvents;
+      const void*    fColumns[HitFile::kNbOfColumns];  // float or double, see GetValueSize()
+    };
+
+    HitFileReader();
+   ~HitFileReader();
+
+    bool Open(const std::string& fileName);            // memory-maps the file and indexes the chunks; false if the
+                                                       // value size is not 4 or 8 or a chunk does not match it
+    void Close();
+
+    const std::string&        GetText()      const { return fText; }
+    uint32_t                  GetValueSize() const { return fValueSize; }
+    const std::vector<Chunk>& GetChunks()    const { return fChunks; }
+    uint64_t                  GetNbOfRows(uint32_t table) const;
+
+    // zero copy access - valid as long as the reader is open
+    const float*  GetFloatColumn (const Chunk& chunk, uint32_t column) const
+      { return static_cast<const float*>(chunk.fColumns[column]); }
+    const double* GetDoubleColumn(const Chunk& chunk, uint32_t column) const
+      { return static_cast<const double*>(chunk.fColumns[column]); }
+    double GetValue(const Chunk& chunk, uint32_t column, uint32_t row) const
+      { return (fValueSize == 4) ? GetFloatColumn(chunk, column)[row] : GetDoubleColumn(chunk, column)[row]; }
+
+  private:
+    const char*        fData;
+    size_t             fSize;
+    uint32_t           fValueSize;
+    std::string        fText;
+    std::vector<Chunk> fChunks;
+};
+
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef LoopCounters_h
+#define LoopCounters_h 1
+
+#include "globals.hh"
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class LoopMessenger;
+
+//
+// Event-loop counters: per thread the events, and per event the tracks, steps, secondaries and wall time, each as
+// a distribution with log2 bins. The user actions count into thread-local data without locks; the master adds
+// them up at the end of the run - see LoopCounters.cc. Commands in LoopMessenger.cc (/custom/loop/)
+//
+// LOOP_COUNT(...) is compiled only with COLLI_LOOP_COUNTERS (CMake option WITH_LOOP_COUNTERS), and at run time
+// it costs one branch unless /custom/loop/enable is set.
+//
+#ifdef COLLI_LOOP_COUNTERS
+#define LOOP_COUNT(call) do { if (LoopCounters::IsEnabled()) LoopCounters::call; } while (0)
+#else
+#define LOOP_COUNT(call) do { } while (0)
+#endif
+
+class LoopCounters
+{
+  public:
+    LoopCounters();
+   ~LoopCounters();
+
+    static LoopCounters* Instance() { return fgInstance; }
+
+  public:
+    // values per event, bin i holds [2^(i-1), 2^i), bin 0 the zeros
+    struct Distribution {
+      static const G4int kNbOfBins = 64;
+      G4long   fEntries = 0;
+      G4double fSum     = 0.;
+      G4double fSum2    = 0.;
+      G4long   fMax     = 0;
+      G4long   fBins[kNbOfBins] = { 0 };
+
+      void     Fill(G4long value);
+      void     Add(const Distribution& other);
+      G4double Mean() const { return fEntries > 0 ? fSum/fEntries : 0.; }
+      G4double Quantile(G4double q) const;     // upper edge of the bin holding the quantile
+    };
+
+    struct alignas(64) ThreadData {
+      G4int    fThread = 0;
+      G4long   fTracks = 0, fSteps = 0, fSecondaries = 0;      // of the current event
+      std::chrono::steady_clock::time_point fEventStart;
+      std::chrono::steady_clock::time_point fLastDump;
+      Distribution fTracksPerEvent, fStepsPerEvent, fSecondariesPerEvent, fTimePerEvent;   // time in ns
+    };
+
+    static G4bool IsEnabled() { return fgEnabled; }
+    void SetEnabled(G4bool b)             { fgEnabled = b; }
+    void SetDumpInterval(G4double t)      { fgDumpInterval = t; }   // seconds, 0 = off
+
+    // user actions of the worker threads
+    static void BeginOfEvent();
+    static void EndOfEvent();
+    static void CountTrack(G4bool secondary) { ThreadData& d = Local(); d.fTracks++; if (secondary) d.fSecondaries++; }
+    static void CountStep()                  { Local().fSteps++; }
+
+    // RunAction (master)
+    void BeginOfRun();
+    void EndOfRun() const;
+
+  private:
+    static ThreadData& Local() { return fgLocal ? *fgLocal : Register(); }
+    static ThreadData& Register();
+    static void Print(const ThreadData& data, const G4String& label);
+
+    static LoopCounters*            fgInstance;
+    static G4bool                   fgEnabled;
+    static G4double                 fgDumpInterval;
+    static G4ThreadLocal ThreadData* fgLocal;
+
+    LoopMessenger* fLoopMessenger;
+};
+
+
+#endif
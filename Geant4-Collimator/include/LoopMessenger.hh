@@ -0,0 +1,31 @@
+#ifndef LoopMessenger_h
+#define LoopMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class LoopCounters;
+class G4UIdirectory;
+class G4UIcmdWithABool;
+class G4UIcmdWithADoubleAndUnit;
+
+
+class LoopMessenger: public G4UImessenger
+{
+  public:
+    LoopMessenger(LoopCounters*);
+   ~LoopMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    LoopCounters*              fLoopCounters;
+
+    G4UIdirectory*             fLoopDir;
+
+    G4UIcmdWithABool*          fEnableCmd;
+    G4UIcmdWithADoubleAndUnit* fDumpCmd;
+};
+
+
+#endif
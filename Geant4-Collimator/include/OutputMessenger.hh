@@ -0,0 +1,36 @@
+#ifndef OutputMessenger_h
+#define OutputMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class OutputWriter;
+class G4UIdirectory;
+class G4UIcmdWithABool;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithAString;
+
+
+class OutputMessenger: public G4UImessenger
+{
+  public:
+    OutputMessenger(OutputWriter*);
+   ~OutputMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    OutputWriter*          fOutputWriter;
+
+    G4UIdirectory*         fOutputDir;
+
+    G4UIcmdWithABool*      fAsyncCmd;
+    G4UIcmdWithAnInteger*  fQueueSizeCmd;
+    G4UIcmdWithABool*      fNtuplesCmd;
+    G4UIcmdWithAString*    fFormatCmd;
+    G4UIcmdWithAString*    fPrecisionCmd;
+    G4UIcmdWithABool*      fMergeCmd;
+};
+
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef OutputNaming_h
+#define OutputNaming_h 1
+
+#include "globals.hh"
+
+//
+// Unique names for the output files. Every process gets a tag (job ID and array index of the batch system,
+// or a random UUID), claimed by creating Output/Runs/<tag>/ atomically. The file names are built from the tag,
+// the run ID and - for per-thread files - the thread ID, so master and workers agree on a name without looking
+// at the filesystem. Every file is listed in Output/Runs/<tag>/manifest.txt.
+// Created once in main() - see ColliRotate.cc
+//
+class OutputNaming
+{
+  public:
+    OutputNaming();
+   ~OutputNaming();
+
+    static OutputNaming* Instance() { return fgInstance; }
+
+  public:
+    G4String GetTag();
+    G4String GetRunFolder();                                   // Output/Runs/<tag>, created on the first call
+    G4String GetFileName(G4String prefix, G4int runID, G4String extension);   // <prefix>_<tag>_r<runID><extension>
+    G4long   GetSeed(G4int runID);                             // different for every tag and run
+
+    void     Register(G4String kind, G4String path);           // add a line to the manifest
+    void     SetWorker(G4int index);                           // forked pool process: tag <tag>_w<index>, see ProcessPool.cc
+
+  private:
+    G4String MakeTag() const;
+    void     ClaimRunFolder();
+
+    static OutputNaming* fgInstance;
+
+    G4String fTag;
+    G4String fRunFolder;
+};
+
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef OutputWriter_h
+#define OutputWriter_h 1
+
+#include "globals.hh"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class OutputMessenger;
+class HitFileWriter;
+
+//
+// Asynchronous output of the SD hits. The worker threads collect the hits of an event and push the finished event
+// into their own lock-free queue; a writer thread drains the queues, compresses and writes the records,
+// or writes them as a columnar .hits file - see HitFile.cc
+// Created once in main() - see ColliRotate.cc; the commands are in OutputMessenger.cc
+//
+class OutputWriter
+{
+  public:
+    OutputWriter();
+   ~OutputWriter();
+
+    static OutputWriter* Instance() { return fgInstance; }
+
+  public:
+    // one hit, in the units of the ntuples: MeV, cm, cm, ns
+    struct HitRecord {
+      G4long   fEvent;       // global event number
+      G4int    fNtuple;      // ntuple ID of the hit: 1 = N_SD1, 2 = g_SD1, 3 = N_SD2, 4 = g_SD2 - see RunAction.cc
+      G4double fEkin;
+      G4double fX;
+      G4double fY;
+      G4double fTime;
+    };
+
+    enum Format { kGzip = 0, kColumnar = 1 };
+
+    void SetEnabled(G4bool b)        { fEnabled = b; }
+    void SetFormat(G4int format)     { fFormat = format; }
+    void SetValueSize(G4int n)       { fValueSize = n; }
+    void SetQueueSize(G4int n)       { fQueueSize = n; }
+    void SetWriteNtuples(G4bool b)   { fWriteNtuples = b; }
+    void SetMergeNtuples(G4bool b)   { fMergeNtuples = b; }
+
+    G4bool IsActive()      const { return fActive; }
+    G4bool WriteNtuples()  const { return fWriteNtuples || !fActive; }   // G4AnalysisManager ntuples
+    G4bool MergeNtuples()  const { return fMergeNtuples; }   // false: one ROOT file per worker, see ColliMerge.cc
+
+    // master: start and stop the writer thread around a run. The extension is added to the file name.
+    void AddRunInfo(G4String key, G4String value);    // header of the columnar files, before BeginOfRun
+    void BeginOfRun(G4String fileName);
+    void EndOfRun();
+
+    // worker threads
+    void AddHit(G4int ntuple, G4double ekin, G4double x, G4double y, G4double time);
+    void EndOfEvent(G4long eventNumber);
+
+  private:
+    // single producer (one worker thread), single consumer (the writer thread) ring buffer of events.
+    // Events are swapped in and out, so the hit vectors keep their capacity and nothing is allocated per event.
+    class EventQueue
+    {
+      public:
+        explicit EventQueue(size_t capacity);
+
+        G4bool Push(std::vector<HitRecord>& event);   // false if the queue is full
+        G4bool Pop (std::vector<HitRecord>& event);   // false if the queue is empty
+        size_t Size() const;
+
+      private:
+        std::vector<std::vector<HitRecord>> fSlots;
+        size_t fMask;
+        alignas(64) std::atomic<size_t> fHead;        // next slot to pop, written by the consumer
+        alignas(64) std::atomic<size_t> fTail;        // next slot to push, written by the producer
+    };
+
+    struct ThreadData {
+      explicit ThreadData(size_t capacity) : fQueue(capacity) {}
+      EventQueue             fQueue;
+      std::vector<HitRecord> fEvent;                  // hits of the running event
+      G4long                 fEvents    = 0;
+      G4long                 fStalls    = 0;          // pushes which had to wait for the writer
+      size_t                 fMaxDepth  = 0;
+    };
+
+    void   WriterLoop();
+    G4bool Drain();
+    void   Flush();
+    ThreadData* GetThreadData() const;
+
+    static OutputWriter* fgInstance;
+
+    OutputMessenger* fOutputMessenger;
+
+    G4bool fEnabled;
+    G4bool fActive;
+    G4bool fWriteNtuples;
+    G4bool fMergeNtuples;
+    G4int  fQueueSize;
+    G4int  fFormat;
+    G4int  fValueSize;                                // bytes per value of the columnar files
+    G4String fRunInfo;
+
+    std::vector<std::unique_ptr<ThreadData>> fThreads;
+    std::thread       fWriterThread;
+    std::atomic<bool> fStop;
+    mutable std::atomic<long> fDropped;               // hits from threads without a queue
+
+    // writer thread only
+    G4String          fFileName;
+    void*             fFile;                          // gzFile
+    HitFileWriter*    fHitFile;
+    std::vector<char> fBuffer;
+    G4long            fHits;
+    G4long            fBytesRaw;
+    G4double          fBusyTime;                      // seconds spent compressing and writing
+};
+
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef PerfCounters_h
+#define PerfCounters_h 1
+
+#include "globals.hh"
+#include <memory>
+#include <vector>
+
+class PerfMessenger;
+
+//
+// Hardware performance counters (Linux perf_event_open): cycles, instructions, cache misses and branch misses per
+// event and per user-action callback, to tell our own stepping, tracking and SD code from the Geant4 internals.
+// Every thread reads its own counter group; the master prints the sums after the run summary - see PerfCounters.cc.
+// Commands in PerfMessenger.cc (/custom/perf/)
+//
+class PerfCounters
+{
+  public:
+    PerfCounters();
+   ~PerfCounters();
+
+    static PerfCounters* Instance() { return fgInstance; }
+
+  public:
+    enum Region { kStepping, kTracking, kSensitive, kEventAction, kNbOfRegions };
+    static const G4int kNbOfCounters = 4;                   // cycles, instructions, cache misses, branch misses
+
+    static G4bool IsEnabled() { return fgEnabled; }
+    void SetEnabled(G4bool b)        { fgEnabled = b; }
+    void SetSampling(G4int n)        { fgSampling = n; }     // read the counters around every n-th callback
+
+    // counts the enclosing callback:  PerfCounters::Scope perf(PerfCounters::kStepping);
+    class Scope {
+      public:
+        explicit Scope(Region region) : fRegion(region), fActive(IsEnabled() && Start(region)) {}
+       ~Scope() { if (fActive) Stop(fRegion); }
+      private:
+        Region fRegion;
+        G4bool fActive;
+    };
+
+    // EventAction: from the start of BeginOfEventAction to the start of EndOfEventAction
+    static void BeginOfEvent();
+    static void EndOfEvent();
+
+    // RunAction (master)
+    void BeginOfRun();
+    void EndOfRun() const;
+
+  private:
+    struct Sum {
+      G4double fValue[kNbOfCounters] = { 0. };
+      G4long   fCalls   = 0;
+      G4long   fSampled = 0;                                // calls with counter readings
+
+      void     Add(const Sum& other);
+      G4double PerCall(G4int i) const { return fSampled > 0 ? fValue[i]/fSampled : 0.; }
+    };
+
+    struct ThreadData {
+      G4int    fThread = 0;
+      G4int    fFd[kNbOfCounters] = { -1, -1, -1, -1 };     // fFd[0] leads the group
+      G4bool   fOpen = false;
+      G4double fStart[kNbOfRegions + 1][kNbOfCounters];     // the last one is the event
+      Sum      fRegions[kNbOfRegions];
+      Sum      fEvents;
+
+     ~ThreadData();
+    };
+
+    static ThreadData& Local() { return fgLocal ? *fgLocal : Register(); }
+    static ThreadData& Register();
+    static G4bool Open(ThreadData&);
+    static G4bool Read(const ThreadData&, G4double* values);
+    static G4bool Start(Region);
+    static void   Stop(Region);
+    static void   Print(const G4String& label, const Sum& sum, G4double callsPerEvent, G4double allCycles);
+
+    static PerfCounters*             fgInstance;
+    static G4bool                    fgEnabled;
+    static G4int                     fgSampling;
+    static G4ThreadLocal ThreadData* fgLocal;
+    static std::vector<std::unique_ptr<ThreadData>> fgThreadData;
+
+    PerfMessenger* fPerfMessenger;
+};
+
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef PerfMessenger_h
+#define PerfMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class PerfCounters;
+class G4UIdirectory;
+class G4UIcmdWithABool;
+class G4UIcmdWithAnInteger;
+
+
+class PerfMessenger: public G4UImessenger
+{
+  public:
+    PerfMessenger(PerfCounters*);
+   ~PerfMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    PerfCounters*              fPerfCounters;
+
+    G4UIdirectory*             fPerfDir;
+
+    G4UIcmdWithABool*          fEnableCmd;
+    G4UIcmdWithAnInteger*      fSamplingCmd;
+};
+
+
+#endif
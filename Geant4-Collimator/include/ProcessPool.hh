@@ -0,0 +1,54 @@
+#ifndef ProcessPool_h
+#define ProcessPool_h 1
+
+#include "globals.hh"
+#include <chrono>
+#include <sys/types.h>
+#include <vector>
+
+//
+// Pre-fork pool: geometry and physics (with the HP data) are set up once, then one process is forked per job.
+// The forked processes share the read-only tables with the parent through copy-on-write pages and write their
+// output under their own tag - see ProcessPool.cc. Created in main() for ColliRotate --prefork, see ColliRotate.cc
+//
+class ProcessPool
+{
+  public:
+    ProcessPool(G4int maxJobs);               // at most maxJobs processes at a time, 0 = all jobs at once
+   ~ProcessPool();
+
+  public:
+    void  AddJob(G4String spec);              // "job.mac" or "job.mac:alias=value,alias=value"
+    G4int Run();                              // returns the number of failed jobs
+
+  private:
+    // memory of a process in kB, from /proc/<pid>/smaps_rollup
+    struct Memory {
+      long fRss     = 0;
+      long fPss     = 0;                      // shared pages divided by the number of processes sharing them
+      long fPrivate = 0;                      // pages copied or allocated by this process
+    };
+
+    struct Job {
+      G4String fMacro;
+      std::vector<std::pair<G4String,G4String>> fAliases;
+      pid_t    fPid      = 0;
+      G4int    fStatus   = -1;
+      G4double fForkTime = 0.;                // ms
+      G4double fWallTime = 0.;                // s
+      Memory   fPeak;
+      std::chrono::steady_clock::time_point fStart;
+    };
+
+    G4bool StartJob(G4int index);             // false if the fork failed
+    [[noreturn]] void RunJob(G4int index);    // in the forked process
+    void   Report(G4double setupTime, const Memory& setup, long peakPss) const;
+    static Memory ReadMemory(pid_t pid);
+
+    G4int fMaxJobs;
+    std::chrono::steady_clock::time_point fStart;   // start of the program
+    std::vector<Job> fJobs;
+};
+
+
+#endif
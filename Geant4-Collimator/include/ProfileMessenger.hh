@@ -0,0 +1,31 @@
+#ifndef ProfileMessenger_h
+#define ProfileMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class StepProfiler;
+class G4UIdirectory;
+class G4UIcmdWithABool;
+class G4UIcmdWithAnInteger;
+
+
+class ProfileMessenger: public G4UImessenger
+{
+  public:
+    ProfileMessenger(StepProfiler*);
+   ~ProfileMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    StepProfiler*              fStepProfiler;
+
+    G4UIdirectory*             fProfileDir;
+
+    G4UIcmdWithABool*          fEnableCmd;
+    G4UIcmdWithAnInteger*      fSamplingCmd;
+};
+
+
+#endif
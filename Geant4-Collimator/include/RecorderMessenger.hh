@@ -0,0 +1,37 @@
+#ifndef RecorderMessenger_h
+#define RecorderMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class StepRecorder;
+class G4UIdirectory;
+class G4UIcommand;
+class G4UIcmdWithABool;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithAString;
+
+
+class RecorderMessenger: public G4UImessenger
+{
+  public:
+    RecorderMessenger(StepRecorder*);
+   ~RecorderMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    StepRecorder*              fStepRecorder;
+
+    G4UIdirectory*             fRecordDir;
+
+    G4UIcmdWithABool*          fEnableCmd;
+    G4UIcommand*               fEventsCmd;
+    G4UIcmdWithAString*        fParticleCmd;
+    G4UIcmdWithAString*        fVolumeCmd;
+    G4UIcommand*               fEnergyCmd;
+    G4UIcmdWithAnInteger*      fCompressionCmd;
+};
+
+
+#endif
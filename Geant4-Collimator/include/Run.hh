@@ -5,6 +5,7 @@
 #include "G4VProcess.hh"
 #include "globals.hh"
 #include <map>
+#include <iostream>
 
 class DetectorConstruction;
 class G4ParticleDefinition;
@@ -23,21 +24,36 @@ class Run : public G4Run
     void AddEdep (G4double edep);
     void AddEflow (G4double eflow);                   
     void ParticleFlux(G4String, G4double);
+    void CountKilledTrack(G4String, G4int, G4double);
+
+    // hit counters of the sensitive detectors, used for the convergence check - see RunControl.cc
+    enum Tally { kSD1Neutrons = 0, kSD2Gammas = 1, kNbOfTallies = 2 };
+    void     CountTally(G4int tally) { fTallies[tally]++; }
+    G4long   GetTally(G4int tally) const { return fTallies[tally]; }
+    G4double GetEnergyDeposit() const { return fEnergyDeposit; }
 
     G4int GetIonId (G4String);
 
     virtual void Merge(const G4Run*);
     void EndOfRun();     
+
+    // chained runs - G4Run counts events in a G4int, the segments of a chain are counted here in 64 bit
+    void   MergeSegment(const Run*);
+    G4long GetNbOfEvents() const { return fNbOfChainedEvents + numberOfEvent; }
+
+    // save and restore the accumulators for checkpoints - see RunControl.cc
+    void WriteState(std::ostream&) const;
+    G4bool ReadState(std::istream&);
    
   private:
     struct ParticleData {
      ParticleData()
        : fCount(0), fEmean(0.), fEmin(0.), fEmax(0.), fTmean(-1.) {}
-     ParticleData(G4int count, G4double ekin, G4double emin, G4double emax,
+     ParticleData(G4long count, G4double ekin, G4double emin, G4double emax,
                   G4double meanLife)
        : fCount(count), fEmean(ekin), fEmin(emin), fEmax(emax),
          fTmean(meanLife) {}
-     G4int     fCount;
+     G4long    fCount;
      G4double  fEmean;
      G4double  fEmin;
      G4double  fEmax;
@@ -48,6 +64,7 @@ class Run : public G4Run
     // utility function
     void Merge(std::map<G4String,ParticleData>& destinationMap,
                const std::map<G4String,ParticleData>& sourceMap) const;
+    void MergeSums(const Run*);
 
     static std::map<G4String,G4int> fgIonMap;
     static G4int fgIonId;
@@ -58,9 +75,20 @@ class Run : public G4Run
 
     G4double fEnergyDeposit, fEnergyDeposit2;
     G4double fEnergyFlow,    fEnergyFlow2;            
-    std::map<G4String,G4int>        fProcCounter;
+    G4long                          fNbOfChainedEvents;
+    G4long                          fTallies[kNbOfTallies];
+    std::map<G4String,G4long>       fProcCounter;
     std::map<G4String,ParticleData> fParticleDataMap1;                    
     std::map<G4String,ParticleData> fParticleDataMap2;
+
+    struct KilledData {
+     KilledData()
+       : fTimeKills(0), fEnergyKills(0), fEkinSum(0.) {}
+     G4long    fTimeKills;
+     G4long    fEnergyKills;
+     G4double  fEkinSum;
+    };
+    std::map<G4String,KilledData>   fKilledDataMap;
 };
 
 
@@ -0,0 +1,101 @@
+#ifndef RunControl_h
+#define RunControl_h 1
+
+#include "globals.hh"
+#include <array>
+#include <chrono>
+#include <vector>
+
+class DetectorConstruction;
+class RunMessenger;
+class Run;
+
+//
+// Segmented runs: a long run is split into segments of a few beamOn each, with a checkpoint after every segment.
+// Every event is seeded from (base seed, global event number), so a resumed run gives the same result as an
+// uninterrupted one. Created once in main() - see ColliRotate.cc; the commands are in RunMessenger.cc
+//
+class RunControl
+{
+  public:
+    RunControl(DetectorConstruction*);
+   ~RunControl();
+
+    static RunControl* Instance() { return fgInstance; }
+
+  public:
+    void BeamOn(G4long nofEvents);             // start a new segmented run
+    void Resume(G4long nofEvents, G4String tag = "");   // continue from the checkpoint of the chain tag (empty = the
+                                                          // newest one); 0 events = requested count of the checkpoint
+    void BeamOnUntilConverged(G4double relError, G4double timeBudget);   // run segments until all tallies converged
+
+    void SetSegmentSize(G4long n)     { fSegmentSize = n; }
+    void SetBaseSeed(G4long seed)     { fBaseSeed = seed; }
+    void SetSingleOutput(G4bool b)    { fSingleOutput = b; }
+    void SetShard(G4int index, G4int nofShards);   // command line --shard i/N, see ColliRotate.cc
+
+    // used by the user actions while a segmented run is in progress
+    G4bool IsActive()       const { return fActive; }
+    G4int  GetSegment()     const { return fSegment; }
+    G4long GetBaseSeed()    const { return fBaseSeed; }
+    G4long GetEventOffset() const { return fFirstEvent + fEventsDone; }   // global number of the first event of the segment
+
+    // one output file for the whole chain: opened by the first segment, closed by the last one - see RunAction.cc
+    G4bool IsSingleOutput() const { return fSingleOutput && !fConverge; }
+    G4bool IsFirstSegment() const { return fSegment == fFirstSegment; }
+    G4bool IsLastSegment()  const { return fLastSegment; }
+
+    void   SeedEvent(G4int eventID) const;    // PrimaryGeneratorAction - seed this event from the global event number
+    void   EndOfSegment(Run*);                // RunAction (master) - accumulate and write the checkpoint
+    void   AddOutputFile(G4String fileName);  // RunAction (master) - files written by the current segment
+
+    G4String GetCheckpointFolder() const;     // Output/Checkpoint_<chain tag>[_shard<i>]
+    G4String GetSegmentFileName() const;      // ROOT file of the running segment
+
+  private:
+    G4bool FindLastChain();
+    void   RunSegments();
+    G4bool Converged() const;
+    G4double BatchRelativeError(G4int tally) const;
+    void   WriteCheckpoint() const;
+    G4bool ReadCheckpoint();
+    void   WriteShardResult() const;
+
+    static RunControl* fgInstance;
+
+    DetectorConstruction* fDetector;
+    RunMessenger*         fRunMessenger;
+
+    G4bool   fActive;
+    G4String fChainTag;                                 // tag of the process which started the chain
+    G4long   fSegmentSize;
+    G4long   fBaseSeed;
+    G4long   fEventsRequested;
+    G4long   fEventsDone;
+    G4int    fSegment;
+    G4long   fFirstEvent;                               // global number of the first event of this shard
+    G4long   fEventsTotal;                              // events of all shards together
+    G4int    fShardIndex;
+    G4int    fNbOfShards;                               // 0 = not sharded
+    G4int    fFirstSegment;                             // first segment of this BeamOn/Resume
+    G4bool   fLastSegment;
+    G4bool   fSingleOutput;
+    G4bool   fChainSingleOutput;                        // the chain of the checkpoint writes a single output file
+
+    // convergence mode: every segment is one batch of the batch-means error estimate
+    static const G4int kNbOfBatchTallies = 3;          // SD1 neutrons, SD2 gammas, mean edep
+    static const G4int kMinNbOfBatches   = 10;
+    G4bool   fConverge;
+    G4double fTargetError;
+    G4double fTimeBudget;                               // seconds
+    G4double fElapsed;                                  // wall time of the finished segments, seconds
+    std::chrono::steady_clock::time_point fSegmentStart;
+    std::vector<std::array<G4double,kNbOfBatchTallies>> fBatches;   // per-event means of each batch
+
+    Run*                  fTotalRun;          // accumulated over all segments
+    std::vector<G4String> fOutputFiles;       // output files of the finished segments
+    std::vector<G4String> fSegmentFiles;      // output files of the running segment
+};
+
+
+#endif
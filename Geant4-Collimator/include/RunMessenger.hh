@@ -0,0 +1,36 @@
+#ifndef RunMessenger_h
+#define RunMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class RunControl;
+class G4UIdirectory;
+class G4UIcmdWithAString;
+class G4UIcommand;
+class G4UIcmdWithABool;
+
+
+class RunMessenger: public G4UImessenger
+{
+  public:
+    RunMessenger(RunControl*);
+   ~RunMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    RunControl*          fRunControl;
+
+    G4UIdirectory*       fRunDir;
+
+    G4UIcmdWithAString*  fBeamOnCmd;
+    G4UIcommand*         fResumeCmd;
+    G4UIcmdWithAString*  fSegmentCmd;
+    G4UIcmdWithAString*  fSeedCmd;
+    G4UIcommand*         fConvergeCmd;
+    G4UIcmdWithABool*    fSingleOutputCmd;
+};
+
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef StepProfiler_h
+#define StepProfiler_h 1
+
+#include "globals.hh"
+#include <memory>
+#include <vector>
+
+class ProfileMessenger;
+class G4Step;
+class G4VProcess;
+class G4LogicalVolume;
+class G4ParticleDefinition;
+
+//
+// Sampling step profiler: steps and sampled CPU time in a dense [volume][particle][process] table per thread,
+// indexed without strings - see StepProfiler.cc. The master adds the tables up by name and writes them as CSV
+// at the end of the run. Created once in main() - see ColliRotate.cc; the commands are in ProfileMessenger.cc
+//
+class StepProfiler
+{
+  public:
+    StepProfiler();
+   ~StepProfiler();
+
+    static StepProfiler* Instance() { return fgInstance; }
+
+  public:
+    static G4bool IsEnabled() { return fgEnabled; }
+    void SetEnabled(G4bool b)        { fgEnabled = b; }
+    void SetSampling(G4int n)        { fgSampling = n; }     // CPU time of every n-th step
+
+    static void Step(const G4Step*);  // SteppingAction
+
+    // RunAction (master)
+    void BeginOfRun();
+    void EndOfRun(G4int runID) const;
+
+  private:
+    static const G4int kMaxVolumes   = 256;                 // the last row collects the rest
+    static const G4int kMaxParticles = 64;                  // the last column collects the rest
+    static const G4int kMaxProcesses = 64;
+    static const G4int kVolumeSlots  = 1024;                // open addressing, logical volume pointer -> row
+    static const G4int kProcessSlots = 4096;                // open addressing, process pointer -> column
+
+    struct Cell {
+      G4long   fSteps = 0;
+      G4double fTime  = 0.;                                 // s, estimated from the samples
+    };
+
+    struct ThreadData {
+      G4int                 fRun = -1;
+      std::vector<Cell>     fTable;                         // a row per volume stepped through in this run
+      std::vector<std::pair<const G4LogicalVolume*,G4int>> fVolumeSlots;
+      std::vector<G4String> fVolumeNames;
+      std::vector<G4int>    fParticleColumn;                // by particle definition ID, -1 = not seen yet
+      std::vector<G4String> fParticleNames;
+      std::vector<std::pair<const G4VProcess*,G4int>> fProcessSlots;
+      std::vector<G4String> fProcessNames;
+      G4long                fCount  = 0;
+      G4bool                fMarked = false;
+      const void*           fMarkTrack = nullptr;
+      G4double              fMark = 0.;
+
+      void  Reset(G4int run);
+      G4int VolumeRow(const G4LogicalVolume*);
+      G4int ParticleColumn(const G4ParticleDefinition*);
+      G4int ProcessColumn(const G4VProcess*);
+    };
+
+    static ThreadData& Local() { return fgLocal ? *fgLocal : Register(); }
+    static ThreadData& Register();
+    static G4double CPUTime();
+
+    static StepProfiler*             fgInstance;
+    static G4bool                    fgEnabled;
+    static G4int                     fgSampling;
+    static G4int                     fgRun;                  // counted up by the master at each run
+    static G4ThreadLocal ThreadData* fgLocal;
+    static std::vector<std::unique_ptr<ThreadData>> fgThreadData;
+
+    ProfileMessenger* fProfileMessenger;
+};
+
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef StepRecorder_h
+#define StepRecorder_h 1
+
+#include "globals.hh"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class RecorderMessenger;
+class G4Event;
+class G4Step;
+class G4Track;
+class G4VProcess;
+class G4LogicalVolume;
+class G4ParticleDefinition;
+
+//
+// Binary step recorder: compact step records (StepTrace.hh) into a compressed stream per thread, filtered by
+// event range, particle, volume and energy - a replacement for /tracking/verbose when thousands of events have to
+// be traced. See StepRecorder.cc; the files are printed with StepPrint. Commands in RecorderMessenger.cc
+//
+class StepRecorder
+{
+  public:
+    StepRecorder();
+   ~StepRecorder();
+
+    static StepRecorder* Instance() { return fgInstance; }
+
+  public:
+    static G4bool IsEnabled() { return fgEnabled; }
+    void SetEnabled(G4bool b)                   { fgEnabled = b; }
+    void SetEvents(G4long first, G4long last)   { fFirstEvent = first; fLastEvent = last; }   // last < 0: open
+    void AddParticle(const G4String& name);     // "all" clears the filter
+    void AddVolume(const G4String& name);
+    void SetEnergyRange(G4double eMin, G4double eMax) { fEmin = eMin; fEmax = eMax; }
+    void SetCompression(G4int level)            { fCompression = level; }
+
+    // RunAction: master resolves the filters, every thread closes its file
+    void BeginOfRun();
+    void EndOfRun();
+
+    // user actions of the worker threads
+    void BeginOfEvent(const G4Event*);
+    static void Step(const G4Step* step) { ThreadData& data = Local(); if (data.fRecordEvent) data.Record(step); }
+
+  private:
+    struct ThreadData {
+      void*    fFile = nullptr;                                  // gzFile
+      G4String fFileName;
+      std::string fBuffer;
+      G4bool   fRecordEvent = false;
+      G4long   fEvent = 0;
+      G4int    fRun = 0;
+      G4bool   fEventWritten = false;
+      const G4Track* fTrack = nullptr;                           // last track with a record
+      G4int    fTrackID = -1;
+      G4long   fSteps = 0;
+      std::unordered_map<const G4LogicalVolume*,G4int> fVolumeIDs;   // volume table of the file, see Open()
+      std::unordered_map<const G4VProcess*,G4int> fProcessIDs;
+      std::unordered_map<const G4ParticleDefinition*,G4int> fParticleIDs;
+      std::unordered_map<std::string,G4int> fProcessNameIDs;     // one id per process name
+
+      void  Record(const G4Step*);
+      void  Open();
+      void  Close();
+      void  Write(const void* data, std::size_t size) { fBuffer.append((const char*)data, size); }
+      void  WriteName(uint8_t tag, G4int id, const G4String& name);
+      G4int VolumeID(const G4LogicalVolume*);
+      G4int ProcessID(const G4VProcess*);
+      G4int ParticleID(const G4ParticleDefinition*);
+    };
+
+    static ThreadData& Local() { return fgLocal ? *fgLocal : Register(); }
+    static ThreadData& Register();
+
+    static StepRecorder*             fgInstance;
+    static G4bool                    fgEnabled;
+    static G4ThreadLocal ThreadData* fgLocal;
+    static std::vector<std::unique_ptr<ThreadData>> fgThreadData;
+
+    RecorderMessenger* fRecorderMessenger;
+    G4long   fFirstEvent, fLastEvent;
+    std::vector<G4String> fParticleNames, fVolumeNames;
+    G4double fEmin, fEmax;
+    G4int    fCompression;
+
+    // the filters resolved at the start of the run, read by all threads
+    std::vector<const G4ParticleDefinition*> fParticles;
+    std::vector<const G4LogicalVolume*> fVolumes;
+};
+
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef StepTrace_h
+#define StepTrace_h 1
+
+// No Geant4 types in here - the pretty-printer StepPrint does not need Geant4 to read the files.
+#include <cstdint>
+
+//
+// Binary step traces (.steps.gz), written per thread by StepRecorder - see StepRecorder.cc, read by StepPrint.cc
+//
+// A gzip stream of records in native byte order, each starting with its one-byte Tag:
+//   Magic     kMagic, once at the start
+//   Name      Tag (kVolumeName, kProcessName, kParticleName), uint16 id, uint16 length, the characters;
+//             the volumes of the geometry right after the magic (dense ids of this file, in the order of the
+//             volume store), processes and particles before the first record using the id
+//   Event     EventRecord, before the first step of an event
+//   Track     TrackRecord, the start point of a track before its first recorded step
+//   Step      StepRecord, the post-step point
+// Units: mm, ns, MeV.
+//
+namespace StepTrace
+{
+  const char     kMagic[8]        = { 'C','R','S','T','E','P','0','1' };
+  const uint16_t kNoProcess       = 0;              // no process defined the step: user limit
+  const uint16_t kOutOfWorld      = 0xFFFF;         // the step left the world
+  const uint16_t kOtherVolume     = 0xFFFF;         // volumes beyond the first 65535 of the file
+
+  enum Tag : uint8_t { kEvent = 'E', kTrack = 'T', kStep = 'S',
+                       kVolumeName = 'V', kProcessName = 'P', kParticleName = 'Q' };
+
+#pragma pack(push, 1)
+  struct EventRecord {
+    int64_t  fEvent;                                // global event number
+    int32_t  fRun;
+  };
+
+  struct TrackRecord {
+    int32_t  fTrackID;
+    int32_t  fParentID;
+    uint16_t fParticle;
+    uint16_t fVolume;
+    float    fX, fY, fZ, fTime, fEkin;
+  };
+
+  struct StepRecord {
+    uint32_t fStep;                                 // step number in the track
+    uint16_t fVolume;                               // volume of the step
+    uint16_t fProcess;
+    float    fX, fY, fZ, fTime;                     // post-step point
+    float    fEkin;                                 // after the step
+    float    fEdep;
+    float    fStepLength;
+    float    fTrackLength;
+  };
+#pragma pack(pop)
+}
+
+
+#endif
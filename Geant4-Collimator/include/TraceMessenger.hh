@@ -0,0 +1,34 @@
+#ifndef TraceMessenger_h
+#define TraceMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class Tracer;
+class G4UIdirectory;
+class G4UIcmdWithABool;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithAString;
+
+
+class TraceMessenger: public G4UImessenger
+{
+  public:
+    TraceMessenger(Tracer*);
+   ~TraceMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    Tracer*                    fTracer;
+
+    G4UIdirectory*             fTraceDir;
+
+    G4UIcmdWithABool*          fEnableCmd;
+    G4UIcmdWithAnInteger*      fEventSamplingCmd;
+    G4UIcmdWithAnInteger*      fBufferSizeCmd;
+    G4UIcmdWithAString*        fWriteCmd;
+};
+
+
+#endif
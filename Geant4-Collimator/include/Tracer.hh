@@ -0,0 +1,86 @@
+#ifndef Tracer_h
+#define Tracer_h 1
+
+#include "globals.hh"
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class TraceMessenger;
+class G4VStateDependent;
+
+//
+// Timeline of the run phases as Chrome trace JSON (chrome://tracing, Perfetto): initialization, run actions, file
+// output, sampled events. Every thread records into a ring buffer of its own without locks; the buffers are written
+// at the end of main() - see Tracer.cc. Created once in main() (ColliRotate --trace); commands in TraceMessenger.cc
+//
+class Tracer
+{
+  public:
+    Tracer(G4bool enabled);
+   ~Tracer();
+
+    static Tracer* Instance() { return fgInstance; }
+
+  public:
+    static G4bool IsEnabled() { return fgEnabled; }
+    void SetEnabled(G4bool b)           { fgEnabled = b; }
+    void SetEventSampling(G4int n)      { fgEventSampling = n; }
+    void SetBufferSize(G4int n);                              // records per thread, for threads starting later
+    void Write(G4String fileName = "") const;                 // default Output/Trace/trace_<tag>.json
+
+    // a span from its construction to the end of the scope:  Tracer::Span span("EndOfRunAction");
+    // the name has to be a string literal, it is kept as a pointer
+    class Span {
+      public:
+        explicit Span(const char* name, G4long arg = -1)
+          : fName(name), fArg(arg), fStart(IsEnabled() ? Now() : -1.) {}
+       ~Span() { if (fStart >= 0.) Add(fName, fStart, fArg); }
+      private:
+        const char* fName;
+        G4long      fArg;
+        G4double    fStart;
+    };
+
+    static G4double Now()                 // microseconds since the start of the program
+      { return std::chrono::duration<G4double,std::micro>(std::chrono::steady_clock::now() - fgStart).count(); }
+    static void Add(const char* name, G4double start, G4long arg = -1);
+
+    // EventAction, every n-th event of each thread
+    static void BeginOfEvent(G4long eventID);
+    static void EndOfEvent();
+
+  private:
+    struct Record {
+      const char* fName;
+      G4double    fStart;
+      G4double    fDuration;
+      G4long      fArg;
+    };
+
+    struct ThreadData {
+      G4int               fThread = 0;
+      std::vector<Record> fRing;                            // size a power of 2
+      unsigned long long  fNext = 0;                        // records written so far
+      G4long              fEvents = 0;
+      G4long              fEventID = -1;
+      G4double            fEventStart = -1.;
+      G4VStateDependent*  fStateWatcher = nullptr;          // initialization phases, owned by the G4StateManager
+    };
+
+    static ThreadData& Local() { return fgLocal ? *fgLocal : Register(); }
+    static ThreadData& Register();
+
+    static Tracer*                   fgInstance;
+    static G4bool                    fgEnabled;
+    static G4int                     fgEventSampling;
+    static G4int                     fgBufferSize;
+    static const std::chrono::steady_clock::time_point fgStart;
+    static G4ThreadLocal ThreadData* fgLocal;
+    static std::vector<std::unique_ptr<ThreadData>> fgThreadData;
+
+    TraceMessenger* fTraceMessenger;
+};
+
+
+#endif
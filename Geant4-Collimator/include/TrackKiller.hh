@@ -0,0 +1,57 @@
+#ifndef TrackKiller_h
+#define TrackKiller_h 1
+
+#include "globals.hh"
+#include <vector>
+
+class G4Step;
+class G4Region;
+class G4ParticleDefinition;
+
+//
+// Kills tracks which are older than a global time limit or slower than a kinetic energy limit.
+// Works like G4NeutronKiller but for every particle species and per region. Limits are set with
+// the /custom/kill/ commands - see DetectorMessenger.cc
+//
+class TrackKiller
+{
+  public:
+    TrackKiller();
+   ~TrackKiller();
+
+  public:
+    // reason why a track was killed - used by Run to sort the killed-track statistics
+    enum KillReason { kNotKilled = 0, kTimeLimit = 1, kEnergyLimit = 2 };
+
+    // particle and region may be "all"; a limit of DBL_MAX (time) or 0 (energy) is inactive
+    void SetTimeLimit  (G4String particle, G4String region, G4double tmax);
+    void SetEnergyLimit(G4String particle, G4String region, G4double emin);
+    void ClearLimits();
+
+    // translate particle and region names to pointers - call in the master before the run starts
+    void Resolve();
+    void PrintLimits() const;
+
+    // returns kNotKilled or the reason why the track of this step should be killed
+    G4int Check(const G4Step*) const;
+
+    G4bool HasLimits() const { return !fLimits.empty(); }
+
+  private:
+    struct KillLimit {
+      G4String                    fParticleName;
+      G4String                    fRegionName;
+      const G4ParticleDefinition* fParticle;      // nullptr = all particles
+      const G4Region*             fRegion;        // nullptr = all regions
+      G4double                    fTimeMax;
+      G4double                    fEkinMin;
+      G4bool                      fResolved;
+    };
+
+    KillLimit& FindOrAddLimit(G4String particle, G4String region);
+
+    std::vector<KillLimit> fLimits;
+};
+
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef ValidatorMessenger_h
+#define ValidatorMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class GeometryValidator;
+class G4UIdirectory;
+class G4UIcmdWithAString;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithADoubleAndUnit;
+class G4UIcmdWithoutParameter;
+
+
+class ValidatorMessenger: public G4UImessenger
+{
+  public:
+    ValidatorMessenger(GeometryValidator*);
+   ~ValidatorMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    GeometryValidator*         fValidator;
+
+    G4UIdirectory*             fOverlapsDir;
+
+    G4UIcmdWithAString*        fModeCmd;
+    G4UIcmdWithAnInteger*      fResolutionCmd;
+    G4UIcmdWithADoubleAndUnit* fToleranceCmd;
+    G4UIcmdWithAnInteger*      fThreadsCmd;
+    G4UIcmdWithAString*        fCacheFileCmd;
+    G4UIcmdWithoutParameter*   fValidateCmd;
+};
+
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef WatchdogMessenger_h
+#define WatchdogMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class EventWatchdog;
+class G4UIdirectory;
+class G4UIcommand;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithADoubleAndUnit;
+
+
+class WatchdogMessenger: public G4UImessenger
+{
+  public:
+    WatchdogMessenger(EventWatchdog*);
+   ~WatchdogMessenger();
+
+    virtual void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    EventWatchdog*             fEventWatchdog;
+
+    G4UIdirectory*             fWatchdogDir;
+
+    G4UIcmdWithADoubleAndUnit* fThresholdCmd;
+    G4UIcmdWithAnInteger*      fMaxReportsCmd;
+    G4UIcommand*               fReplayCmd;
+};
+
+
+#endif
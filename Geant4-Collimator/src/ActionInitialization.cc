@@ -5,6 +5,7 @@
 #include "TrackingAction.hh"
 #include "SteppingAction.hh"
 #include "SteppingVerbose.hh"
+#include "Tracer.hh"
 
 ActionInitialization::ActionInitialization(DetectorConstruction* detector)
  : G4VUserActionInitialization(),
@@ -16,12 +17,14 @@ ActionInitialization::~ActionInitialization()
 
 void ActionInitialization::BuildForMaster() const
 {
+  Tracer::Span span("BuildForMaster");
   RunAction* runAction = new RunAction(fDetector, 0);
   SetUserAction(runAction);
 }
 
 void ActionInitialization::Build() const
 {
+  Tracer::Span span("Build");
   PrimaryGeneratorAction* primary = new PrimaryGeneratorAction(fDetector);
   SetUserAction(primary);
     
@@ -0,0 +1,166 @@
+/*
+Thread-scaling benchmark. ColliRotate --benchmark --threads N [--events E] [--seed S] [--csv file] bench.mac
+
+  1. the macro sets up the reference configuration, /run/numberOfThreads is given as the alias {threads}
+  2. a warm-up run of 10 events per thread initializes the workers (physics tables, first-event effects)
+  3. the measured run of E events is a segmented run with base seed S in one segment (see RunControl.cc):
+     every event is seeded from its global number, so all thread counts simulate exactly the same events
+
+One CSV row per benchmark is appended to the file (header written if new):
+  threads, events, seed, init_s, warmup_s, loop_s, run_s, events_per_s, merge_s, peak_rss_MB,
+  min_thread_events, max_thread_events, mean_busy_s, max_busy_s, imbalance
+and one row per thread to <file stem>_threads.csv: threads, thread, events, busy_s
+
+  loop_s     from the start of the run until the last worker leaves its event loop
+  merge_s    from there until the run is complete: merging of the worker runs and ntuples, output files
+  busy_s     per worker, from its BeginOfRunAction to its EndOfRunAction
+  imbalance  max_busy_s / mean_busy_s - 1, the fraction of the run the other threads wait for the slowest one
+*/
+
+#include "Benchmark.hh"
+#include "RunControl.hh"
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <sys/resource.h>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace {
+  G4Mutex benchmarkMutex = G4MUTEX_INITIALIZER;
+}
+
+Benchmark* Benchmark::fgInstance = nullptr;
+
+
+Benchmark::Benchmark(G4int nofThreads, G4long nofEvents, G4long seed, G4String csvFile)
+: fNbOfThreads(nofThreads), fNbOfEvents(nofEvents), fSeed(seed), fCSVFile(csvFile), fMeasuring(false)
+{
+  fgInstance = this;
+}
+
+
+Benchmark::~Benchmark()
+{
+  fgInstance = nullptr;
+}
+
+
+G4bool Benchmark::Run(G4String macroFile)
+{
+  G4UImanager* UImanager = G4UImanager::GetUIpointer();
+  G4RunManager* runManager = G4RunManager::GetRunManager();
+
+  auto start = Clock::now();
+  UImanager->ApplyCommand("/control/alias threads " + std::to_string(fNbOfThreads));
+  if (UImanager->ApplyCommand("/control/execute " + macroFile) != 0) return false;
+
+  G4int nofThreads = G4Threading::IsMultithreadedApplication() ? runManager->GetNumberOfThreads() : 1;
+  if (nofThreads != fNbOfThreads) {
+    G4cout << "\n--> warning from Benchmark : " << macroFile << " runs " << nofThreads << " threads instead of "
+           << fNbOfThreads << " - use /run/numberOfThreads {threads}" << G4endl;
+    fNbOfThreads = nofThreads;
+  }
+  auto initialized = Clock::now();
+
+  runManager->BeamOn(10*fNbOfThreads);
+  auto warm = Clock::now();
+
+  // measured run
+  fThreads.assign(fNbOfThreads, ThreadData());
+  fLoopEnd   = warm;
+  fMeasuring = true;
+  RunControl* runControl = RunControl::Instance();
+  runControl->SetBaseSeed(fSeed);
+  runControl->SetSegmentSize(fNbOfEvents);
+  runControl->BeamOn(fNbOfEvents);
+  fMeasuring = false;
+  auto done = Clock::now();
+
+  auto seconds = [](Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<G4double>(to - from).count();
+  };
+  WriteCSV(seconds(start, initialized), seconds(initialized, warm), seconds(warm, fLoopEnd), seconds(warm, done));
+  return true;
+}
+
+
+G4int Benchmark::ThreadIndex(G4bool isMaster) const
+{
+  // the master does not run events in MT mode; in sequential mode it is thread 0
+  if (isMaster && G4Threading::IsMultithreadedApplication()) return -1;
+  G4int index = std::max(0, G4Threading::G4GetThreadId());
+  return (index < (G4int)fThreads.size()) ? index : -1;
+}
+
+
+void Benchmark::BeginOfRun(G4bool isMaster)
+{
+  if (!fMeasuring) return;
+  G4int index = ThreadIndex(isMaster);
+  if (index < 0) return;
+
+  G4AutoLock lock(&benchmarkMutex);
+  fThreads[index].fStart = Clock::now();
+}
+
+
+void Benchmark::EndOfRun(G4bool isMaster, G4int nofEvents)
+{
+  if (!fMeasuring) return;
+  G4int index = ThreadIndex(isMaster);
+  if (index < 0) return;
+
+  auto now = Clock::now();
+  G4AutoLock lock(&benchmarkMutex);
+  ThreadData& data = fThreads[index];
+  data.fEvents += nofEvents;
+  data.fBusy   += std::chrono::duration<G4double>(now - data.fStart).count();
+  fLoopEnd = std::max(fLoopEnd, now);
+}
+
+
+void Benchmark::WriteCSV(G4double initTime, G4double warmupTime, G4double loopTime, G4double runTime) const
+{
+  G4long   minEvents = fThreads.empty() ? 0 : fThreads[0].fEvents, maxEvents = 0;
+  G4double sumBusy = 0., maxBusy = 0.;
+  for ( const auto& data : fThreads ) {
+    minEvents = std::min(minEvents, data.fEvents);
+    maxEvents = std::max(maxEvents, data.fEvents);
+    sumBusy  += data.fBusy;
+    maxBusy   = std::max(maxBusy, data.fBusy);
+  }
+  G4double meanBusy  = fThreads.empty() ? 0. : sumBusy/fThreads.size();
+  G4double imbalance = (meanBusy > 0.) ? maxBusy/meanBusy - 1. : 0.;
+  G4double mergeTime = runTime - loopTime;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  G4double peakRSS = usage.ru_maxrss/1024.;              // kB on Linux
+
+  G4bool newFile = !fs::exists(fCSVFile);
+  std::ofstream csv(fCSVFile, std::ios::app);
+  if (newFile) {
+    csv << "threads,events,seed,init_s,warmup_s,loop_s,run_s,events_per_s,merge_s,peak_rss_MB,"
+           "min_thread_events,max_thread_events,mean_busy_s,max_busy_s,imbalance\n";
+  }
+  csv << fNbOfThreads << "," << fNbOfEvents << "," << fSeed << "," << initTime << "," << warmupTime << ","
+      << loopTime << "," << runTime << "," << fNbOfEvents/runTime << "," << mergeTime << "," << peakRSS << ","
+      << minEvents << "," << maxEvents << "," << meanBusy << "," << maxBusy << "," << imbalance << "\n";
+
+  G4String threadFile = (fs::path(fCSVFile).parent_path() / fs::path(fCSVFile).stem()).string() + "_threads.csv";
+  newFile = !fs::exists(threadFile);
+  std::ofstream threadCsv(threadFile, std::ios::app);
+  if (newFile) threadCsv << "threads,thread,events,busy_s\n";
+  for (std::size_t i = 0; i < fThreads.size(); i++) {
+    threadCsv << fNbOfThreads << "," << i << "," << fThreads[i].fEvents << "," << fThreads[i].fBusy << "\n";
+  }
+
+  G4cout << "\n Benchmark: " << fNbOfThreads << " threads, " << fNbOfEvents/runTime << " events/s, imbalance "
+         << imbalance << ", merge " << mergeTime << " s, peak RSS " << peakRSS << " MB -> " << fCSVFile << G4endl;
+}
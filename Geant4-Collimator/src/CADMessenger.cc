@@ -0,0 +1,107 @@
+/*
+Commands for the CAD import with CADMesh (include/CADMesh.hh, the local additions in include/CADMeshExtensions.hh) -
+the options are static in CADMesh, so they apply to every FromOBJ/FromSTL/FromPLY call after the command.
+*/
+
+#include "CADMessenger.hh"
+
+#include "CADMesh.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4UIcmdWithoutParameter.hh"
+
+
+CADMessenger::CADMessenger()
+:G4UImessenger(),
+ fCADDir(nullptr),
+ fCacheCmd(nullptr), fPrintCacheCmd(nullptr), fClearCacheCmd(nullptr), fThreadsCmd(nullptr),
+ fDecimateCmd(nullptr), fPrimitivesCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fCADDir = new G4UIdirectory("/custom/cad/",broadcast);
+  fCADDir->SetGuidance("Options of the CAD file import (CADMesh).");
+
+  // Mesh cache on/off
+  fCacheCmd = new G4UIcmdWithABool("/custom/cad/cache",this);
+  fCacheCmd->SetGuidance("Keep the parsed meshes of every CAD file, keyed by path and modification time, so that");
+  fCacheCmd->SetGuidance("the parts of one file and the geometry rebuilds parse the file only once (default true)");
+  fCacheCmd->SetParameterName("flag",true);
+  fCacheCmd->SetDefaultValue(true);
+  fCacheCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Load times
+  fPrintCacheCmd = new G4UIcmdWithoutParameter("/custom/cad/printCache",this);
+  fPrintCacheCmd->SetGuidance("Print the cached files with their parse time and the time of a load from the cache");
+  fPrintCacheCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Drop all meshes
+  fClearCacheCmd = new G4UIcmdWithoutParameter("/custom/cad/clearCache",this);
+  fClearCacheCmd->SetGuidance("Forget all parsed and decimated meshes, the next geometry build parses the CAD files again");
+  fClearCacheCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Threads of the OBJ reader
+  fThreadsCmd = new G4UIcmdWithAnInteger("/custom/cad/threads",this);
+  fThreadsCmd->SetGuidance("Threads which parse the groups of an OBJ file and build their facets (default 0 = one per core)");
+  fThreadsCmd->SetParameterName("n",false);
+  fThreadsCmd->SetRange("n>=0");
+  fThreadsCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Simplification of the tessellated solids
+  fDecimateCmd = new G4UIcmdWithADoubleAndUnit("/custom/cad/decimate",this);
+  fDecimateCmd->SetGuidance("Collapse the edges of the closed CAD meshes as long as the surface stays within this distance");
+  fDecimateCmd->SetGuidance("of the original, fewer facets make the navigation faster (default 0 = off). The facets before");
+  fDecimateCmd->SetGuidance("and after and the largest deviation at the original vertices and facet centres (an estimate,");
+  fDecimateCmd->SetGuidance("not a bound) are printed per part. The decimated meshes are cached per mesh and tolerance.");
+  fDecimateCmd->SetGuidance("Compare the step rate with CADBench.");
+  fDecimateCmd->SetParameterName("tolerance",false);
+  fDecimateCmd->SetRange("tolerance>=0.");
+  fDecimateCmd->SetUnitCategory("Length");
+  fDecimateCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Native solids for the simple parts
+  fPrimitivesCmd = new G4UIcmdWithADoubleAndUnit("/custom/cad/primitives",this);
+  fPrimitivesCmd->SetGuidance("Build a G4Box, G4Tubs or G4Cons instead of the tessellated solid for the CAD parts which");
+  fPrimitivesCmd->SetGuidance("are one within this distance (rings, foils, flanges, tubes), default 0 = off. Every part");
+  fPrimitivesCmd->SetGuidance("is reported with the solid it was replaced by, or as kept.");
+  fPrimitivesCmd->SetParameterName("tolerance",false);
+  fPrimitivesCmd->SetRange("tolerance>=0.");
+  fPrimitivesCmd->SetUnitCategory("Length");
+  fPrimitivesCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+}
+
+
+CADMessenger::~CADMessenger()
+{
+  delete fCacheCmd;
+  delete fPrintCacheCmd;
+  delete fClearCacheCmd;
+  delete fThreadsCmd;
+  delete fDecimateCmd;
+  delete fPrimitivesCmd;
+  delete fCADDir;
+}
+
+
+void CADMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fCacheCmd )
+   { CADMesh::File::MeshCache::SetEnabled(fCacheCmd->GetNewBoolValue(newValue));}
+
+  if( command == fPrintCacheCmd )
+   { CADMesh::File::MeshCache::Print(G4cout);}
+
+  if( command == fClearCacheCmd )
+   { CADMesh::File::MeshCache::Clear();
+     CADMesh::DecimationCache::Clear();}
+
+  if( command == fThreadsCmd )
+   { CADMesh::File::ParallelOBJReader::SetThreads(fThreadsCmd->GetNewIntValue(newValue));}
+
+  if( command == fDecimateCmd )
+   { CADMesh::Decimator::SetDefaultTolerance(fDecimateCmd->GetNewDoubleValue(newValue));}
+
+  if( command == fPrimitivesCmd )
+   { CADMesh::PrimitiveFitter::SetDefaultTolerance(fPrimitivesCmd->GetNewDoubleValue(newValue));}
+}
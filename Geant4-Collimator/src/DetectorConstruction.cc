@@ -7,6 +7,8 @@ Remember to include the header-files in your simulation, e.g. if you want to pla
 
 #include "DetectorConstruction.hh"      //Header file where functions classes and variables may be defined (...)
 #include "DetectorMessenger.hh"         //Header file for own macro commands
+#include "CADMessenger.hh"              //commands for the CAD import (/custom/cad/)
+#include "Tracer.hh"                    //timeline of the run phases
 #include "G4RunManager.hh"              //Necessary. You need this.
 
 #include "G4NistManager.hh"             //for getting material definitions from the NIST database
@@ -45,15 +47,22 @@ Remember to include the header-files in your simulation, e.g. if you want to pla
 #include "G4PhysicalVolumeStore.hh"
 #include "G4LogicalVolumeStore.hh"
 #include "G4SolidStore.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4ProductionCuts.hh"
+#include "G4ProductionCutsTable.hh"
 
 #include "SensitiveDetector.hh"                     //the SensitiveDetector
+#include "TrackKiller.hh"                           //time and energy limits for tracks - see TrackKiller.cc
+#include "GeometryValidator.hh"                     //overlap checks of the built geometry - see GeometryValidator.cc
+#include "GeometryBuilder.hh"                       //geometry from a file (/custom/geo/file) - see GeometryBuilder.cc
 #include "CADMesh.hh"                   // for importing CAD-files (.stl, .obj, ...). Read all about it at: https://github.com/christopherpoole/CADMesh
 
 
 DetectorConstruction::DetectorConstruction()
 :G4VUserDetectorConstruction(),
- fAbsorMaterial(nullptr), fLAbsor(nullptr), world_mat(nullptr), fDetectorMessenger(nullptr),
- fScoringVolume(0)
+ fAbsorMaterial(nullptr), fLAbsor(nullptr), world_mat(nullptr), fDetectorMessenger(nullptr), fCADMessenger(nullptr),
+ fTrackKiller(nullptr), fGeometryValidator(nullptr), fGeometryBuilder(nullptr), fScoringVolume(0)
 {
   // World Size
   world_sizeXYZ = 20.*m;
@@ -82,16 +91,50 @@ DetectorConstruction::DetectorConstruction()
   //Print all defined materials to console
   G4cout << *(G4Material::GetMaterialTable()) << G4endl;
 
+  // time and energy limits for tracks, set with /custom/kill/ commands
+  fTrackKiller = new TrackKiller();
+
   // create commands for interactive definition of the geometry
   fDetectorMessenger = new DetectorMessenger(this);
+
+  // options of the CAD import, set with /custom/cad/ commands
+  fCADMessenger = new CADMessenger();
+
+  // overlap checks, set with /custom/overlaps/ commands
+  fGeometryValidator = new GeometryValidator();
+
+  // geometry from a file instead of ConstructVolumes, set with /custom/geo/file
+  fGeometryBuilder = new GeometryBuilder();
 }
 
 DetectorConstruction::~DetectorConstruction()
-{ delete fDetectorMessenger;}
+{ 
+  delete fDetectorMessenger;
+  delete fCADMessenger;
+  delete fTrackKiller;
+  delete fGeometryValidator;
+  delete fGeometryBuilder;
+}
 
 G4VPhysicalVolume* DetectorConstruction::Construct()
 {
-  return ConstructVolumes();
+  Tracer::Span span("Construct");
+  G4VPhysicalVolume* world = ConstructVolumes();
+  fGeometryValidator->Validate(world);          //checks the overlaps unless /custom/overlaps/mode is placement or off
+  return world;
+}
+
+//Remove the old logical volumes from the user regions before the volume stores are cleaned.
+//The regions themselves are kept, so kill limits and production cuts assigned to them stay valid.
+void DetectorConstruction::ClearRegions()
+{
+  for ( const G4String& name : {"Shielding", "Collimator"} ) {
+    G4Region* region = G4RegionStore::GetInstance()->GetRegion(name, false);
+    if (!region) continue;
+    while (region->GetNumberOfRootVolumes() > 0) {
+      region->RemoveRootLogicalVolume(*(region->GetRootLogicalVolumeIterator()), false);
+    }
+  }
 }
 
 //Define materials and compositions you want to use in the simulation
@@ -159,6 +202,16 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
 {
   // Cleanup old geometry
   G4GeometryManager::GetInstance()->OpenGeometry();
+  ClearRegions();
+
+  // check the overlaps in every G4PVPlacement only with /custom/overlaps/mode placement - by default the whole
+  // geometry is checked at once in Construct
+  G4bool checkOverlaps = fGeometryValidator->IsCheckedAtPlacement();
+
+  // geometry from a file (/custom/geo/file): the builder keeps the solids and volumes which did not change
+  if (fGeometryBuilder->HasFile()) return fGeometryBuilder->Build(checkOverlaps);
+
+  fGeometryBuilder->Forget();
   G4PhysicalVolumeStore::GetInstance()->Clean();
   G4LogicalVolumeStore::GetInstance()->Clean();
   G4SolidStore::GetInstance()->Clean();
@@ -194,7 +247,7 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
                       0,                     //its mother  volume
                       false,                 //boolean operation?
                       0,                     //copy number
-                      true);                 //overlaps checking?
+                      checkOverlaps);        //overlaps checking?
 
   //Make world-volume invisible
   auto logicWorldVisAtt = new G4VisAttributes(G4Color(1, 1, 1, 0.01)); //(r, g, b , transparency)
@@ -256,7 +309,7 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
               logicWorld,                                //its mother  volume
               true,                                //boolean operation?
               0,                                   //copy number
-              true);                               //overlaps checking?
+              checkOverlaps);                      //overlaps checking?
 
   //Make (in-)visible and give it a color
   //lRotationBox->SetVisAttributes (G4VisAttributes::GetInvisible());
@@ -304,13 +357,21 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
               lRotationBox,                                //its mother  volume
               true,                                //boolean operation?
               0,                                   //copy number
-              true);                               //overlaps checking?
+              checkOverlaps);                      //overlaps checking?
 
   //Colorcode PE
   auto logicShieldBoxVisAtt = new G4VisAttributes(G4Color(255./255, 226./255, 181./255, 0.5)); //(r, g, b , transparency)
   logicShieldBoxVisAtt->SetVisibility(true);
   lShieldBox->SetVisAttributes(logicShieldBoxVisAtt);
 
+  //Make the shielding a region so it can get its own track kill limits - see TrackKiller.cc
+  //The user regions share the default production cuts (so /run/setCut applies to them too), without cuts
+  //G4RunManagerKernel::CheckRegions warns at every initialization
+  G4ProductionCuts* defaultCuts = G4ProductionCutsTable::GetProductionCutsTable()->GetDefaultProductionCuts();
+  G4Region* ShieldingRegion = G4RegionStore::GetInstance()->FindOrCreateRegion("Shielding");
+  if (!ShieldingRegion->GetProductionCuts()) ShieldingRegion->SetProductionCuts(defaultCuts);
+  ShieldingRegion->AddRootLogicalVolume(lShieldBox);
+
   // 
   //Combine two boxes to Copper collimator and cut a air-cylinder because Tungsten Colli does not cover whole copper
   // 
@@ -357,13 +418,18 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
               lRotationBox,                     //its mother  volume
               true,                           //boolean operation?
               0,                              //copy number
-              true);                          //overlaps checking?
+              checkOverlaps);                 //overlaps checking?
 
   //Colorcode Copper
   auto logicCopperCollimatorVisAtt = new G4VisAttributes(G4Color(188./255, 80./255, 47./255, 0.8)); //(r, g, b , transparency)
   logicCopperCollimatorVisAtt->SetVisibility(true);
   lCuColli->SetVisAttributes(logicCopperCollimatorVisAtt);
 
+  //Make the collimator (copper and tungsten daughters) a region so it can get its own track kill limits - see TrackKiller.cc
+  G4Region* CollimatorRegion = G4RegionStore::GetInstance()->FindOrCreateRegion("Collimator");
+  if (!CollimatorRegion->GetProductionCuts()) CollimatorRegion->SetProductionCuts(defaultCuts);
+  CollimatorRegion->AddRootLogicalVolume(lCuColli);
+
   // 
   //Combine two cylinders to Tungsten collimator
   // 
@@ -399,7 +465,7 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
               lCuColli,                       //its mother volume - place TungstenCylinder in CopperBox
               true,                           //boolean operation?
               0,                              //copy number
-              true);                          //overlaps checking?
+              checkOverlaps);                 //overlaps checking?
 
   //Colorcode Tungsten
   auto logicTungstenInletVisAtt = new G4VisAttributes(G4Color(120./255, 124./255, 133./255, 0.8)); //(r, g, b , transparency)
@@ -442,7 +508,7 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
               lWColli,                      //its mother  volume
               false,                        //boolean operation?
               0,                            //copy number
-              true);                        //overlaps checking?
+              checkOverlaps);               //overlaps checking?
 
   //Make (in-)visible and give it a color
   auto logicConeVisAtt = new G4VisAttributes(G4Color(1, 1, 1, 0.8)); //(r, g, b , transparency)
@@ -473,7 +539,7 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
               lRotationBox,                           //mother  volume
               false,                          //boolean operation?
               0,                              //copy number
-              true);                          //overlaps checking?
+              checkOverlaps);                 //overlaps checking?
 
   //Make (in-)visible and give it a color
   auto logicCylinderVisAtt = new G4VisAttributes(G4Color(1, 0, 0, 0.8)); //(r, g, b , transparency)
@@ -500,7 +566,7 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
               lRotationBox,                    //its mother  volume
               false,                         //boolean operation?
               0,                             //copy number
-              true);                         //overlaps checking?
+              checkOverlaps);                //overlaps checking?
 
   //Make (in-)visible and give it a color
   auto lSD1VisAtt = new G4VisAttributes(G4Color(0, 0, 1, 0.8)); //(r, g, b , transparency)
@@ -526,7 +592,7 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
               lRotationBox,                    //its mother  volume
               false,                         //boolean operation?
               0,                             //copy number
-              true);                         //overlaps checking?
+              checkOverlaps);                //overlaps checking?
 
   //Make (in-)visible and give it a color
   auto lSD2VisAtt = new G4VisAttributes(G4Color(0, 0, 1, 0.8)); //(r, g, b , transparency)
@@ -667,6 +733,13 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
 //
 void DetectorConstruction::SetAbsorMaterial(G4String materialChoice)
 {
+  // the geometry file names the materials of its volumes, ConstructVolumes is not used
+  if (fGeometryBuilder->HasFile()) {
+    G4cout << "\n--> warning from DetectorConstruction::SetMaterial : the geometry is built from a file, "
+           << materialChoice << " is not used. Change the material of the volume in the file instead." << G4endl;
+    return;
+  }
+
   // search the material by its name
   G4Material* pttoMaterial = G4NistManager::Instance()->FindOrBuildMaterial(materialChoice);   
   
@@ -691,6 +764,7 @@ void DetectorConstruction::SetAbsorMaterial(G4String materialChoice)
 void DetectorConstruction::change_a(G4double value)
 {
   a = value;
+  fGeometryBuilder->SetParameter("a", a);
   G4RunManager::GetRunManager()->ReinitializeGeometry();
   G4cout  << "\n a is now " << G4BestUnit(a,"Length") << G4endl;
 }
@@ -699,6 +773,7 @@ void DetectorConstruction::change_a(G4double value)
 void DetectorConstruction::change_b(G4double value)
 {
   b = value;
+  fGeometryBuilder->SetParameter("b", b);
   G4RunManager::GetRunManager()->ReinitializeGeometry();
   G4cout  << "\n b is now " << G4BestUnit(b,"Length") << G4endl;
 }
@@ -707,6 +782,7 @@ void DetectorConstruction::change_b(G4double value)
 void DetectorConstruction::change_c(G4double value)
 {
   c = value;
+  fGeometryBuilder->SetParameter("c", c);
   G4RunManager::GetRunManager()->ReinitializeGeometry();
   G4cout  << "\n c is now " << G4BestUnit(c,"Length") << G4endl;
 }
@@ -715,6 +791,7 @@ void DetectorConstruction::change_c(G4double value)
 void DetectorConstruction::change_d(G4double value)
 {
   d = value;
+  fGeometryBuilder->SetParameter("d", d);
   G4RunManager::GetRunManager()->ReinitializeGeometry();
   G4cout  << "\n d is now " << G4BestUnit(d,"Length") << G4endl;
 }
@@ -723,6 +800,7 @@ void DetectorConstruction::change_d(G4double value)
 void DetectorConstruction::change_e(G4double value)
 {
   e = value;
+  fGeometryBuilder->SetParameter("e", e);
   G4RunManager::GetRunManager()->ReinitializeGeometry();
   G4cout  << "\n e is now " << G4BestUnit(e,"Angle") << G4endl;
 }
@@ -731,15 +809,33 @@ void DetectorConstruction::change_e(G4double value)
 void DetectorConstruction::change_f(G4double value)
 {
   f = value;
+  fGeometryBuilder->SetParameter("f", f);
   G4RunManager::GetRunManager()->ReinitializeGeometry();
   G4cout  << "\n f is now " << G4BestUnit(f,"Length") << G4endl;
 }
 
+// Geometry from a file instead of ConstructVolumes - see GeometryBuilder.cc
+void DetectorConstruction::SetGeometryFile(G4String fileName)
+{
+  fGeometryBuilder->SetFile(fileName);
+  G4RunManager::GetRunManager()->ReinitializeGeometry();
+  G4cout  << "\n the geometry is now " << (fGeometryBuilder->HasFile() ? fileName : "the one of ConstructVolumes") << G4endl;
+}
+
+// Change a parameter of the geometry file
+void DetectorConstruction::SetGeometryParameter(G4String name, G4String expression)
+{
+  fGeometryBuilder->SetParameter(name, expression);
+  G4RunManager::GetRunManager()->ReinitializeGeometry();
+  G4cout  << "\n " << name << " is now " << expression << G4endl;
+}
+
 //
 //Assign Detectors and Scorers to Volume
 //
 void DetectorConstruction::ConstructSDandField()
 {
+  Tracer::Span span("ConstructSDandField");
   G4SDManager::GetSDMpointer()->SetVerboseLevel(1);
 
   //
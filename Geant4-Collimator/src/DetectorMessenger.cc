@@ -6,6 +6,7 @@ The actual functions can be found in files where they change variables, e.g. Det
 #include "DetectorMessenger.hh"
 
 #include "DetectorConstruction.hh"
+#include "TrackKiller.hh"
 #include "G4UIdirectory.hh"               //to create directories to sort your custom commands
 #include "G4UIcommand.hh"
 #include "G4UIparameter.hh"
@@ -17,12 +18,16 @@ The actual functions can be found in files where they change variables, e.g. Det
 #include "G4UIcmdWithADoubleAndUnit.hh"   //for commands with a double and a unit
 #include "G4UIcmdWithoutParameter.hh"     //for commands without a parameter
 
+#include <sstream>
+
 DetectorMessenger::DetectorMessenger(DetectorConstruction * Det)
 :G4UImessenger(), 
  fDetector(Det), fTestemDir(nullptr), fDetDir(nullptr), 
  fOutFoldCmd(nullptr),
  fMaterCmd(nullptr),
- fchange_aCmd(nullptr), fchange_bCmd(nullptr), fchange_cCmd(nullptr), fchange_dCmd(nullptr), fchange_eCmd(nullptr), fchange_fCmd(nullptr)
+ fchange_aCmd(nullptr), fchange_bCmd(nullptr), fchange_cCmd(nullptr), fchange_dCmd(nullptr), fchange_eCmd(nullptr), fchange_fCmd(nullptr),
+ fGeoFileCmd(nullptr), fGeoParamCmd(nullptr),
+ fKillDir(nullptr), fKillTimeCmd(nullptr), fKillEnergyCmd(nullptr), fKillClearCmd(nullptr)
 {
   //Create a directory for your custom commands
   fTestemDir = new G4UIdirectory("/custom/");
@@ -46,6 +51,7 @@ DetectorMessenger::DetectorMessenger(DetectorConstruction * Det)
   // Change Material dummyMat
   fMaterCmd = new G4UIcmdWithAString("/custom/geo/setMat",this);
   fMaterCmd->SetGuidance("Select material of the box.");
+  fMaterCmd->SetGuidance("Not used with a geometry file (/custom/geo/file), which names the material of every volume.");
   fMaterCmd->SetParameterName("choice",false);
   fMaterCmd->AvailableForStates(G4State_PreInit,G4State_Idle); 
 
@@ -97,6 +103,59 @@ DetectorMessenger::DetectorMessenger(DetectorConstruction * Det)
   fchange_fCmd->SetRange("0. <= f <= 3.76");  //Distance to Inlet is 4cm, target is 0.24cm thick = 3.76cm of space
   fchange_fCmd->SetUnitCategory("Length");
   fchange_fCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Geometry from a file - see GeometryBuilder.cc and Collimator.geo
+  fGeoFileCmd = new G4UIcmdWithAString("/custom/geo/file",this);
+  fGeoFileCmd->SetGuidance("Build the geometry from this file instead of ConstructVolumes (none = ConstructVolumes)");
+  fGeoFileCmd->SetGuidance("solids and volumes whose parameters did not change are kept between the builds");
+  fGeoFileCmd->SetParameterName("fileName",false);
+  fGeoFileCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Change a parameter of the geometry file, e.g. /custom/geo/param TargetLen 3*mm
+  fGeoParamCmd = new G4UIcommand("/custom/geo/param",this);
+  fGeoParamCmd->SetGuidance("Replace the expression of a parameter of the geometry file (units in the expression)");
+  fGeoParamCmd->SetParameter(new G4UIparameter("name",'s',false));
+  fGeoParamCmd->SetParameter(new G4UIparameter("expression",'s',false));
+  fGeoParamCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  //Create a sub-directory for better sorting - time and energy limits for tracks
+  fKillDir = new G4UIdirectory("/custom/kill/",broadcast);
+  fKillDir->SetGuidance("Kill tracks above a global time or below a kinetic energy - see TrackKiller.cc");
+
+  // Kill tracks older than a global time limit
+  // e.g. /custom/kill/timeLimit neutron Shielding 10 us
+  fKillTimeCmd = new G4UIcommand("/custom/kill/timeLimit",this);
+  fKillTimeCmd->SetGuidance("Kill tracks of a particle in a region above this global time");
+  fKillTimeCmd->SetGuidance("particle and region can be 'all'; regions: Shielding, Collimator, DefaultRegionForTheWorld");
+  fKillTimeCmd->SetParameter(new G4UIparameter("particle",'s',false));
+  fKillTimeCmd->SetParameter(new G4UIparameter("region",'s',false));
+  G4UIparameter* tmaxPrm = new G4UIparameter("tmax",'d',false);
+  tmaxPrm->SetParameterRange("tmax>0.");
+  fKillTimeCmd->SetParameter(tmaxPrm);
+  G4UIparameter* tunitPrm = new G4UIparameter("unit",'s',false);
+  tunitPrm->SetParameterCandidates(G4UIcommand::UnitsList("Time"));
+  fKillTimeCmd->SetParameter(tunitPrm);
+  fKillTimeCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Kill tracks slower than a kinetic energy limit
+  // e.g. /custom/kill/energyLimit neutron all 0.5 eV
+  fKillEnergyCmd = new G4UIcommand("/custom/kill/energyLimit",this);
+  fKillEnergyCmd->SetGuidance("Kill tracks of a particle in a region below this kinetic energy");
+  fKillEnergyCmd->SetGuidance("particle and region can be 'all'; regions: Shielding, Collimator, DefaultRegionForTheWorld");
+  fKillEnergyCmd->SetParameter(new G4UIparameter("particle",'s',false));
+  fKillEnergyCmd->SetParameter(new G4UIparameter("region",'s',false));
+  G4UIparameter* eminPrm = new G4UIparameter("emin",'d',false);
+  eminPrm->SetParameterRange("emin>=0.");
+  fKillEnergyCmd->SetParameter(eminPrm);
+  G4UIparameter* eunitPrm = new G4UIparameter("unit",'s',false);
+  eunitPrm->SetParameterCandidates(G4UIcommand::UnitsList("Energy"));
+  fKillEnergyCmd->SetParameter(eunitPrm);
+  fKillEnergyCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Remove all limits
+  fKillClearCmd = new G4UIcmdWithoutParameter("/custom/kill/clear",this);
+  fKillClearCmd->SetGuidance("Remove all time and energy limits");
+  fKillClearCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
 }
 
 
@@ -118,6 +177,16 @@ DetectorMessenger::~DetectorMessenger()
   delete fchange_dCmd;
   delete fchange_eCmd;
   delete fchange_fCmd;
+
+  // Geometry file
+  delete fGeoFileCmd;
+  delete fGeoParamCmd;
+
+  // Time and energy limits
+  delete fKillTimeCmd;
+  delete fKillEnergyCmd;
+  delete fKillClearCmd;
+  delete fKillDir;
 }
 
 void DetectorMessenger::SetNewValue(G4UIcommand* command,G4String newValue)
@@ -148,4 +217,34 @@ void DetectorMessenger::SetNewValue(G4UIcommand* command,G4String newValue)
 
   if( command == fchange_fCmd )
    { fDetector->change_f(fchange_fCmd->GetNewDoubleValue(newValue));}
+
+  // Geometry file
+  if( command == fGeoFileCmd )
+   { fDetector->SetGeometryFile(newValue);}
+
+  if( command == fGeoParamCmd )
+   {
+     G4String name, expression;
+     std::istringstream is(newValue);
+     is >> name;
+     std::getline(is >> std::ws, expression);                 // "..." keeps the spaces of an expression
+     if (expression.size() > 1 && expression.front() == '"' && expression.back() == '"')
+       expression = expression.substr(1, expression.size() - 2);
+     fDetector->SetGeometryParameter(name, expression);
+   }
+
+  // Time and energy limits
+  if( command == fKillTimeCmd || command == fKillEnergyCmd )
+   { 
+     G4String particle, region, value, unit;
+     std::istringstream is(newValue);
+     is >> particle >> region >> value >> unit;
+     G4double limit = G4UIcommand::ConvertToDimensionedDouble((value + " " + unit).c_str());
+
+     if( command == fKillTimeCmd ) fDetector->GetTrackKiller()->SetTimeLimit(particle, region, limit);
+     else                          fDetector->GetTrackKiller()->SetEnergyLimit(particle, region, limit);
+   }
+
+  if( command == fKillClearCmd )
+   { fDetector->GetTrackKiller()->ClearLimits();}
 }
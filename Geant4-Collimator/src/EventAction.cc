@@ -12,6 +12,13 @@ Understand what this does and comment it
 #include "G4UnitsTable.hh"
 
 #include "RunAction.hh"
+#include "RunControl.hh"
+#include "OutputWriter.hh"
+#include "LoopCounters.hh"
+#include "EventWatchdog.hh"
+#include "PerfCounters.hh"
+#include "Tracer.hh"
+#include "StepRecorder.hh"
 
 #include "Analysis.hh"
 #include "G4SDManager.hh"
@@ -74,11 +81,16 @@ G4double EventAction::GetSum(G4THitsMap<G4double>* hitsMap) const
   return sumValue;  
 } 
 
-void EventAction::BeginOfEventAction(const G4Event*)
+void EventAction::BeginOfEventAction(const G4Event* event)
 {
+  Tracer::BeginOfEvent(event->GetEventID());
   fTotalEnergyDeposit = 0.;
   fTotalEnergyFlow = 0.; 
 
+  LOOP_COUNT(BeginOfEvent());
+  PerfCounters::BeginOfEvent();
+  if (StepRecorder::IsEnabled()) StepRecorder::Instance()->BeginOfEvent(event);
+
 /*
   //variable initialisation per event 
   //from B1
@@ -107,10 +119,25 @@ void EventAction::AddEflow(G4double Eflow)
 
 void EventAction::EndOfEventAction(const G4Event* event)
 {
+  Tracer::EndOfEvent();
+  PerfCounters::EndOfEvent();
+  PerfCounters::Scope perf(PerfCounters::kEventAction);
+  LOOP_COUNT(EndOfEvent());
+  if (EventWatchdog::IsEnabled()) EventWatchdog::Instance()->EndOfEvent(event);
+
   Run* run = static_cast<Run*>(G4RunManager::GetRunManager()->GetNonConstCurrentRun());
              
   run->AddEdep (fTotalEnergyDeposit);             
   run->AddEflow(fTotalEnergyFlow);
+
+  // hand the hits of this event to the writer thread - see OutputWriter.cc
+  OutputWriter* outputWriter = OutputWriter::Instance();
+  if (outputWriter && outputWriter->IsActive()) {
+    G4long eventNumber = event->GetEventID();
+    RunControl* runControl = RunControl::Instance();
+    if (runControl && runControl->IsActive()) eventNumber += runControl->GetEventOffset();
+    outputWriter->EndOfEvent(eventNumber);
+  }
                
   //G4AnalysisManager::Instance()->FillH1(1,fTotalEnergyDeposit);
   //G4AnalysisManager::Instance()->FillH1(3,fTotalEnergyFlow);  
@@ -0,0 +1,189 @@
+/*
+Slow-event watchdog. A single event - a deep hadronic cascade, a looping track - can take seconds or never finish,
+and stalls its worker at the end of the run. With /custom/watchdog/threshold the watchdog
+  - saves the state of the random engine before the primaries of every event are generated (in memory)
+  - checks the wall time of the event every 256 steps; when it is above the threshold, the saved state is written
+    to Output/SlowEvents/<tag>_r<run>_e<event>.rndm at once, so it is there even if the event never ends
+  - counts from then on the steps per volume and process
+  - appends a summary to Output/SlowEvents/slow_events.txt at the end of the event: event, thread, wall time,
+    tracks, steps, the volumes and processes with most steps and the replay command
+
+/custom/watchdog/replay <file> [verbose] restores the engine state in the next event and runs it with
+/tracking/verbose (SteppingVerbose.cc). The replay has to use the same macro (geometry, source, physics) as the run.
+*/
+
+#include "EventWatchdog.hh"
+#include "WatchdogMessenger.hh"
+#include "RunControl.hh"
+#include "OutputNaming.hh"
+
+#include "G4Event.hh"
+#include "G4Run.hh"
+#include "G4RunManager.hh"
+#include "G4Step.hh"
+#include "G4VProcess.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4UImanager.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+// get folderName from where it is defined (RunAction.cc) - the really dirty way
+extern std::string folderName;
+
+namespace {
+  G4Mutex watchdogMutex = G4MUTEX_INITIALIZER;
+}
+
+EventWatchdog* EventWatchdog::fgInstance = nullptr;
+G4double EventWatchdog::fgThreshold = 0.;
+G4ThreadLocal EventWatchdog::ThreadData* EventWatchdog::fgLocal = nullptr;
+std::vector<std::unique_ptr<EventWatchdog::ThreadData>> EventWatchdog::fgThreadData;
+
+
+EventWatchdog::EventWatchdog()
+: fWatchdogMessenger(nullptr), fMaxReports(20), fNbOfReports(0)
+{
+  fgInstance = this;
+  fWatchdogMessenger = new WatchdogMessenger(this);
+}
+
+
+EventWatchdog::~EventWatchdog()
+{
+  delete fWatchdogMessenger;
+  fgInstance = nullptr;
+}
+
+
+EventWatchdog::ThreadData& EventWatchdog::Register()
+{
+  G4AutoLock lock(&watchdogMutex);
+  fgThreadData.push_back(std::make_unique<ThreadData>());
+  fgLocal = fgThreadData.back().get();
+  return *fgLocal;
+}
+
+
+void EventWatchdog::BeginOfEvent(G4Event* event)
+{
+  // replay: the engine continues from the saved state instead of the seeds of this event
+  G4bool replay = !fReplayState.empty();
+  if (replay) {
+    std::istringstream is(fReplayState);
+    G4Random::restoreFullState(is);
+    G4cout << "\n Replaying the event with the saved engine state" << G4endl;
+  }
+  if (!IsEnabled()) return;
+
+  ThreadData& data = Local();
+  data.fEvent = event->GetEventID();
+  RunControl* runControl = RunControl::Instance();
+  if (runControl && runControl->IsActive()) data.fEvent += runControl->GetEventOffset();
+  data.fRun    = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+  data.fTracks = data.fSteps = 0;
+  data.fSlow   = false;
+  data.fStateFile.clear();
+  data.fVolumes.clear();
+  data.fProcesses.clear();
+  data.fStart  = std::chrono::steady_clock::now();
+
+  // the replayed event is slow by definition and must not report itself with the state of another event
+  if (replay) {
+    data.fSlow = true;
+    data.fEngineState.clear();
+    return;
+  }
+
+  std::ostringstream os;
+  G4Random::saveFullState(os);
+  data.fEngineState = os.str();
+}
+
+
+void EventWatchdog::StartReport(ThreadData& data)
+{
+  data.fSlow = true;
+  if (fNbOfReports++ >= fMaxReports) return;
+
+  G4String folder = folderName + "/SlowEvents";
+  std::error_code ec;
+  fs::create_directories(folder, ec);
+  G4String tag = OutputNaming::Instance() ? OutputNaming::Instance()->GetTag() : G4String("run");
+  data.fStateFile = folder + "/" + tag + "_r" + std::to_string(data.fRun) + "_e" + std::to_string(data.fEvent) + ".rndm";
+  std::ofstream(data.fStateFile) << data.fEngineState;
+
+  G4cout << "\n--> warning from EventWatchdog : event " << data.fEvent << " runs longer than " << fgThreshold
+         << " s, engine state saved to " << data.fStateFile << G4endl;
+}
+
+
+void EventWatchdog::CountStep(const G4Step* step)
+{
+  ThreadData& data = Local();
+  if (data.fStateFile.empty()) return;
+
+  const G4VPhysicalVolume* volume = step->GetPreStepPoint()->GetPhysicalVolume();
+  const G4VProcess* process = step->GetPostStepPoint()->GetProcessDefinedStep();
+  data.fVolumes[volume ? volume->GetName() : G4String("none")]++;
+  data.fProcesses[process ? process->GetProcessName() : G4String("none")]++;
+}
+
+
+void EventWatchdog::EndOfEvent(const G4Event*)
+{
+  if (!IsEnabled() || !fReplayState.empty()) return;
+
+  ThreadData& data = Local();
+  G4double elapsed = Elapsed(data);
+  if (!data.fSlow && elapsed > fgThreshold) StartReport(data);    // few, slow steps
+  if (data.fStateFile.empty()) return;
+
+  // the entries with most steps
+  auto top = [](const std::map<G4String,G4long>& counts) {
+    std::vector<std::pair<G4long,G4String>> sorted;
+    for ( const auto& count : counts ) sorted.push_back({ count.second, count.first });
+    std::sort(sorted.rbegin(), sorted.rend());
+    std::ostringstream os;
+    for (std::size_t i = 0; i < sorted.size() && i < 5; i++) os << "  " << sorted[i].second << " " << sorted[i].first;
+    return os.str();
+  };
+
+  std::ostringstream report;
+  report << "event " << data.fEvent << "  run " << data.fRun << "  thread " << G4Threading::G4GetThreadId()
+         << "  time " << elapsed << " s  tracks " << data.fTracks << "  steps " << data.fSteps << "\n";
+  RunControl* runControl = RunControl::Instance();
+  if (runControl && runControl->IsActive()) report << "  baseSeed   " << runControl->GetBaseSeed() << "\n";
+  report << "  volumes   " << top(data.fVolumes)   << "\n"
+         << "  processes " << top(data.fProcesses) << "\n"
+         << "  replay    /custom/watchdog/replay " << data.fStateFile << "\n";
+
+  G4AutoLock lock(&watchdogMutex);
+  std::ofstream(folderName + "/SlowEvents/slow_events.txt", std::ios::app) << report.str();
+  G4cout << "\n Slow " << report.str() << G4endl;
+}
+
+
+void EventWatchdog::Replay(G4String fileName, G4int verboseLevel)
+{
+  std::ifstream in(fileName);
+  if (!in) {
+    G4cout << "\n--> warning from EventWatchdog : can not read " << fileName << G4endl;
+    return;
+  }
+  std::ostringstream state;
+  state << in.rdbuf();
+
+  G4UImanager* UImanager = G4UImanager::GetUIpointer();
+  fReplayState = state.str();
+  UImanager->ApplyCommand("/tracking/verbose " + std::to_string(verboseLevel));
+  G4RunManager::GetRunManager()->BeamOn(1);
+  UImanager->ApplyCommand("/tracking/verbose 0");
+  fReplayState.clear();
+}
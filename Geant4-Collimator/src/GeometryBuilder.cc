@@ -0,0 +1,441 @@
+/*
+Geometry from a text file instead of the literals in DetectorConstruction::ConstructVolumes. Select it with
+  /custom/geo/file Collimator.geo            ("none" goes back to ConstructVolumes)
+  /custom/geo/param name expression          replaces the expression of a parameter of the file
+/custom/geo/change_a ... change_f set the parameters a ... f of the file as well.
+
+One statement per line, words are separated by spaces, "..." is one word (names with spaces, expressions with
+spaces), # starts a comment. Every number is an expression of the CLHEP evaluator: units (mm, cm, m, deg, ...),
+pi, the functions of <cmath> and the parameters above the line, e.g. 10*cm+a or (TargetLen+f)/2.
+
+  param   name expression
+  solid   name box          dx dy dz                                         half lengths
+  solid   name tubs         rmin rmax dz [sphi dphi]
+  solid   name cons         rmin1 rmax1 rmin2 rmax2 dz [sphi dphi]
+  solid   name sphere       rmin rmax [sphi dphi [stheta dtheta]]
+  solid   name union|subtraction|intersection  solidA solidB x y z [rotate rx ry rz]
+  volume  name solid material [color r g b alpha] [invisible] [region name]
+  place   name volume mother|- x y z [rotate rx ry rz] [copy n] [many]
+
+The materials are the ones of DetectorConstruction::DefineMaterials or of the NIST database; /custom/geo/setMat is
+rejected while a file is set. Rotations are about x, then y, then z, of the frame as in ConstructVolumes. The one
+placement without mother (-) is the world.
+
+Every build creates new physical volumes. A solid is identified by a hash of its type, its evaluated parameters and
+the hashes of its constituents, a logical volume by its name, the hash of its solid, its material and its colour.
+Solids and volumes whose hash is in the cache of the last build are taken from there, so a change of the cone
+parameter b rebuilds the two cones, their union and the logical volume "Collimator Shape", nothing else. What the
+new geometry does not use is deleted.
+*/
+
+#include "GeometryBuilder.hh"
+#include "Tracer.hh"
+
+#include "G4Box.hh"
+#include "G4Tubs.hh"
+#include "G4Cons.hh"
+#include "G4Sphere.hh"
+#include "G4UnionSolid.hh"
+#include "G4SubtractionSolid.hh"
+#include "G4IntersectionSolid.hh"
+#include "G4DisplacedSolid.hh"
+#include "G4LogicalVolume.hh"
+#include "G4PVPlacement.hh"
+#include "G4Material.hh"
+#include "G4NistManager.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4ProductionCuts.hh"
+#include "G4ProductionCutsTable.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4SolidStore.hh"
+#include "G4PhysicalConstants.hh"
+
+#include "CLHEP/Evaluator/Evaluator.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+  // FNV-1a, 64 bit
+  uint64_t Hash(const std::string& text)
+  {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  // words of a line; "..." is one word, # starts a comment
+  std::vector<G4String> Tokenize(const std::string& line)
+  {
+    std::vector<G4String> tokens;
+    std::size_t i = 0;
+    while (i < line.size()) {
+      if (std::isspace((unsigned char)line[i])) { i++; continue; }
+      if (line[i] == '#') break;
+      std::size_t end;
+      if (line[i] == '"') {
+        end = std::min(line.find('"', i+1), line.size());
+        tokens.push_back(line.substr(i+1, end-i-1));
+        i = end + 1;
+        continue;
+      }
+      end = i;
+      while (end < line.size() && !std::isspace((unsigned char)line[end]) && line[end] != '#') end++;
+      tokens.push_back(line.substr(i, end-i));
+      i = end;
+    }
+    return tokens;
+  }
+
+  G4bool IsBoolean(const G4String& type)
+  {
+    return type == "union" || type == "subtraction" || type == "intersection";
+  }
+
+  // number of expressions a solid takes
+  G4bool ValidArguments(const G4String& type, std::size_t n)
+  {
+    if (type == "box")    return n == 3;
+    if (type == "tubs")   return n == 3 || n == 5;
+    if (type == "cons")   return n == 5 || n == 7;
+    if (type == "sphere") return n == 2 || n == 4 || n == 6;
+    if (IsBoolean(type))  return n == 3 || n == 6;
+    return false;
+  }
+}
+
+
+GeometryBuilder::GeometryBuilder()
+: fFileName("none")
+{}
+
+GeometryBuilder::~GeometryBuilder()
+{}
+
+
+void GeometryBuilder::SetFile(G4String fileName)
+{
+  fFileName = fileName;
+}
+
+void GeometryBuilder::SetParameter(G4String name, G4String expression)
+{
+  fOverrides[name] = expression;
+}
+
+void GeometryBuilder::SetParameter(G4String name, G4double value)
+{
+  std::ostringstream os;
+  os << std::setprecision(17) << value;
+  fOverrides[name] = os.str();
+}
+
+
+G4bool GeometryBuilder::Read(std::vector<Statement>& statements) const
+{
+  std::ifstream file(fFileName);
+  if (!file) return false;
+  std::string line;
+  G4int number = 0;
+  while (std::getline(file, line)) {
+    number++;
+    std::vector<G4String> tokens = Tokenize(line);
+    if (!tokens.empty()) statements.push_back({ number, tokens });
+  }
+  return true;
+}
+
+
+G4VPhysicalVolume* GeometryBuilder::Build(G4bool checkOverlaps)
+{
+  Tracer::Span span("GeometryBuilder");
+
+  std::vector<Statement> statements;
+  if (!Read(statements)) {
+    G4ExceptionDescription msg;
+    msg << "can not read the geometry file " << fFileName;
+    G4Exception("GeometryBuilder::Build()", "GeometryBuilder001", FatalException, msg);
+    return nullptr;
+  }
+
+  // the placements are always new - the cached volumes lose their daughters
+  for ( auto volume : *G4LogicalVolumeStore::GetInstance() ) volume->ClearDaughters();
+  G4PhysicalVolumeStore::GetInstance()->Clean();
+  fRotations.clear();
+  ClearRegions();
+
+  HepTool::Evaluator evaluator;
+  evaluator.setStdMath();
+  evaluator.setSystemOfUnits(1.e+3, 1./1.60217e-25, 1.e+9, 1./1.60217e-10, 1.0, 1.0, 1.0);   // mm, MeV, ns
+
+  std::map<G4String,std::pair<uint64_t,G4VSolid*>> solids;           // of this build, by name
+  std::map<G4String,std::pair<uint64_t,G4LogicalVolume*>> volumes;
+  std::set<G4String> parameters;
+  G4VPhysicalVolume* world = nullptr;
+  G4int nbOfNewSolids = 0, nbOfNewVolumes = 0, nbOfPlacements = 0;
+
+  G4String error;
+  auto value = [&](const G4String& expression) {
+    G4double result = evaluator.evaluate(expression.c_str());
+    if (evaluator.status() != HepTool::Evaluator::OK && error.empty())
+      error = "can not evaluate '" + expression + "': " + G4String(evaluator.error_name());
+    return result;
+  };
+
+  const Statement* statement = nullptr;
+  for ( const auto& current : statements ) {
+    statement = &current;
+    const std::vector<G4String>& t = current.fTokens;
+    const G4String& keyword = t[0];
+    std::ostringstream content;                       // what the hash of a solid or volume is computed from
+    content << std::setprecision(17) << keyword;
+
+    if (keyword == "param") {
+      if (t.size() != 3) { error = "usage: param name expression"; break; }
+      auto replaced = fOverrides.find(t[1]);
+      G4double result = value(replaced != fOverrides.end() ? replaced->second : t[2]);
+      evaluator.setVariable(t[1].c_str(), result);
+      parameters.insert(t[1]);
+    }
+
+    else if (keyword == "solid") {
+      if (t.size() < 3) { error = "usage: solid name type parameters"; break; }
+      const G4String& name = t[1];
+      const G4String& type = t[2];
+      if (solids.count(name)) { error = "solid '" + name + "' is defined twice"; break; }
+      content << " " << name << " " << type;
+
+      // constituents of a boolean solid
+      std::size_t first = 3;
+      G4VSolid* solidA = nullptr;
+      G4VSolid* solidB = nullptr;
+      if (IsBoolean(type)) {
+        if (t.size() < 5 || !solids.count(t[3]) || !solids.count(t[4])) {
+          error = "usage: solid name " + type + " solidA solidB x y z [rotate rx ry rz] - with solids defined above";
+          break;
+        }
+        solidA = solids[t[3]].second;
+        solidB = solids[t[4]].second;
+        content << " " << solids[t[3]].first << " " << solids[t[4]].first;
+        first = 5;
+      }
+      std::vector<G4double> p;
+      for (std::size_t i = first; i < t.size(); i++) {
+        if (IsBoolean(type) && i == first + 3 && t[i] == "rotate") continue;
+        p.push_back(value(t[i]));
+        content << " " << p.back();
+      }
+      if (!error.empty()) break;
+      if (!ValidArguments(type, p.size())) { error = "wrong number of parameters for a solid of type '" + type + "'"; break; }
+
+      uint64_t key = Hash(content.str());
+      auto cached = fSolids.find(key);
+      G4VSolid* solid = (cached != fSolids.end()) ? cached->second : nullptr;
+      if (!solid) {
+        if (type == "box") solid = new G4Box(name, p[0], p[1], p[2]);
+        else if (type == "tubs")
+          solid = new G4Tubs(name, p[0], p[1], p[2], p.size() > 3 ? p[3] : 0., p.size() > 3 ? p[4] : twopi);
+        else if (type == "cons")
+          solid = new G4Cons(name, p[0], p[1], p[2], p[3], p[4], p.size() > 5 ? p[5] : 0., p.size() > 5 ? p[6] : twopi);
+        else if (type == "sphere")
+          solid = new G4Sphere(name, p[0], p[1], p.size() > 2 ? p[2] : 0., p.size() > 2 ? p[3] : twopi,
+                                                 p.size() > 4 ? p[4] : 0., p.size() > 4 ? p[5] : pi);
+        else {
+          G4ThreeVector translation(p[0], p[1], p[2]);
+          G4RotationMatrix rotation;                  // copied by the boolean solid
+          if (p.size() == 6) { rotation.rotateX(p[3]); rotation.rotateY(p[4]); rotation.rotateZ(p[5]); }
+          G4RotationMatrix* rotationB = (p.size() == 6) ? &rotation : nullptr;
+          if (type == "union")             solid = new G4UnionSolid       (name, solidA, solidB, rotationB, translation);
+          else if (type == "subtraction")  solid = new G4SubtractionSolid (name, solidA, solidB, rotationB, translation);
+          else                             solid = new G4IntersectionSolid(name, solidA, solidB, rotationB, translation);
+        }
+        fSolids[key] = solid;
+        nbOfNewSolids++;
+      }
+      solids[name] = { key, solid };
+    }
+
+    else if (keyword == "volume") {
+      if (t.size() < 4 || !solids.count(t[2])) { error = "usage: volume name solid material [options] - with a solid defined above"; break; }
+      const G4String& name = t[1];
+      if (volumes.count(name)) { error = "volume '" + name + "' is defined twice"; break; }
+      G4Material* material = G4Material::GetMaterial(t[3], false);
+      if (!material) material = G4NistManager::Instance()->FindOrBuildMaterial(t[3]);
+      if (!material) { error = "unknown material '" + t[3] + "'"; break; }
+      content << " " << name << " " << solids[t[2]].first << " " << material->GetName();
+
+      G4VisAttributes visAttributes;
+      std::vector<G4String> regions;
+      for (std::size_t i = 4; i < t.size(); ) {
+        if (t[i] == "color" && i + 4 < t.size()) {
+          G4double r = value(t[i+1]), g = value(t[i+2]), b = value(t[i+3]), alpha = value(t[i+4]);
+          visAttributes.SetColour(r, g, b, alpha);
+          content << " color " << r << " " << g << " " << b << " " << alpha;
+          i += 5;
+        }
+        else if (t[i] == "invisible")                  { visAttributes.SetVisibility(false); content << " invisible"; i++; }
+        else if (t[i] == "region" && i + 1 < t.size()) { regions.push_back(t[i+1]); i += 2; }
+        else { error = "unknown option '" + t[i] + "' of volume '" + name + "'"; break; }
+      }
+      if (!error.empty()) break;
+
+      uint64_t key = Hash(content.str());
+      auto cached = fVolumes.find(key);
+      if (cached == fVolumes.end()) {
+        cached = fVolumes.insert({ key, { new G4LogicalVolume(solids[t[2]].second, material, name), visAttributes } }).first;
+        cached->second.fVolume->SetVisAttributes(&cached->second.fVisAttributes);
+        nbOfNewVolumes++;
+      }
+      G4LogicalVolume* volume = cached->second.fVolume;
+      for ( const auto& region : regions ) {
+        // the default production cuts, as for the regions of ConstructVolumes
+        G4Region* userRegion = G4RegionStore::GetInstance()->FindOrCreateRegion(region);
+        if (!userRegion->GetProductionCuts()) {
+          userRegion->SetProductionCuts(G4ProductionCutsTable::GetProductionCutsTable()->GetDefaultProductionCuts());
+        }
+        userRegion->AddRootLogicalVolume(volume);
+        fRegions.insert(region);
+      }
+      volumes[name] = { key, volume };
+    }
+
+    else if (keyword == "place") {
+      if (t.size() < 7 || !volumes.count(t[2]) || (t[3] != "-" && !volumes.count(t[3]))) {
+        error = "usage: place name volume mother|- x y z [options] - with volumes defined above";
+        break;
+      }
+      G4LogicalVolume* mother = (t[3] == "-") ? nullptr : volumes[t[3]].second;
+      if (!mother && world) { error = "a second world '" + t[1] + "' - only one placement without mother"; break; }
+      G4ThreeVector position(value(t[4]), value(t[5]), value(t[6]));
+      G4RotationMatrix* rotation = nullptr;
+      G4int copyNo = 0;
+      G4bool many = false;
+      for (std::size_t i = 7; i < t.size(); ) {
+        if (t[i] == "rotate" && i + 3 < t.size()) {
+          fRotations.push_back(std::unique_ptr<G4RotationMatrix>(new G4RotationMatrix()));
+          rotation = fRotations.back().get();
+          rotation->rotateX(value(t[i+1]));
+          rotation->rotateY(value(t[i+2]));
+          rotation->rotateZ(value(t[i+3]));
+          i += 4;
+        }
+        else if (t[i] == "copy" && i + 1 < t.size()) { copyNo = (G4int)std::lround(value(t[i+1])); i += 2; }
+        else if (t[i] == "many")                     { many = true; i++; }
+        else { error = "unknown option '" + t[i] + "' of placement '" + t[1] + "'"; break; }
+      }
+      if (!error.empty()) break;
+
+      G4VPhysicalVolume* placement =
+        new G4PVPlacement(rotation, position, volumes[t[2]].second, t[1], mother, many, copyNo, checkOverlaps);
+      if (!mother) world = placement;
+      nbOfPlacements++;
+    }
+
+    else { error = "unknown statement '" + keyword + "'"; break; }
+
+    if (!error.empty()) break;
+  }
+  if (error.empty() && !world) {
+    statement = nullptr;
+    error = "no world - place it with 'place World volume - 0 0 0'";
+  }
+  if (!error.empty()) {
+    G4ExceptionDescription msg;
+    msg << fFileName;
+    if (statement) msg << ":" << statement->fLine;
+    msg << ": " << error;
+    G4Exception("GeometryBuilder::Build()", "GeometryBuilder002", FatalException, msg);
+    return nullptr;
+  }
+
+  // delete what the old geometry had and this one does not use
+  std::set<G4VSolid*> usedSolids;
+  std::set<G4LogicalVolume*> usedVolumes;
+  for ( const auto& solid : solids )   usedSolids.insert(solid.second.second);
+  for ( const auto& volume : volumes ) usedVolumes.insert(volume.second.second);
+  RemoveStale(usedSolids, usedVolumes);
+
+  for ( const auto& replaced : fOverrides ) {
+    if (!parameters.count(replaced.first))
+      G4cout << "\n--> warning from GeometryBuilder : " << fFileName << " has no parameter '" << replaced.first
+             << "', setting it has no effect" << G4endl;
+  }
+  G4cout << "\n GeometryBuilder: " << fFileName << " - new " << nbOfNewSolids << " of " << solids.size()
+         << " solids and " << nbOfNewVolumes << " of " << volumes.size() << " logical volumes, "
+         << nbOfPlacements << " placements" << G4endl;
+
+  return world;
+}
+
+
+void GeometryBuilder::ClearRegions()
+{
+  for ( const auto& name : fRegions ) {
+    G4Region* region = G4RegionStore::GetInstance()->GetRegion(name, false);
+    if (!region) continue;
+    while (region->GetNumberOfRootVolumes() > 0) {
+      region->RemoveRootLogicalVolume(*(region->GetRootLogicalVolumeIterator()), false);
+    }
+  }
+  fRegions.clear();
+}
+
+
+void GeometryBuilder::RemoveStale(std::set<G4VSolid*> solids, const std::set<G4LogicalVolume*>& volumes)
+{
+  // the constituents of the used solids are used, also the displaced solids which booleans create in the store
+  std::vector<G4VSolid*> open(solids.begin(), solids.end());
+  while (!open.empty()) {
+    G4VSolid* solid = open.back();
+    open.pop_back();
+    std::vector<G4VSolid*> parts = { solid->GetConstituentSolid(0), solid->GetConstituentSolid(1) };
+    if (G4DisplacedSolid* displaced = solid->GetDisplacedSolidPtr()) parts.push_back(displaced->GetConstituentMovedSolid());
+    for ( auto part : parts ) {
+      if (part && solids.insert(part).second) open.push_back(part);
+    }
+  }
+
+  // the stores shrink while volumes and solids are deleted - iterate over copies
+  G4LogicalVolumeStore* volumeStore = G4LogicalVolumeStore::GetInstance();
+  std::vector<G4LogicalVolume*> oldVolumes(volumeStore->begin(), volumeStore->end());
+  for ( auto volume : oldVolumes ) {
+    if (!volumes.count(volume)) delete volume;
+  }
+  for (auto cached = fVolumes.begin(); cached != fVolumes.end(); ) {
+    if (volumes.count(cached->second.fVolume)) ++cached;
+    else cached = fVolumes.erase(cached);
+  }
+
+  // a boolean solid resets the transformation of its displaced solid when deleted - the booleans go first
+  G4SolidStore* solidStore = G4SolidStore::GetInstance();
+  std::vector<G4VSolid*> oldSolids;
+  for ( auto solid : *solidStore ) {
+    if (!solids.count(solid)) oldSolids.push_back(solid);
+  }
+  std::stable_partition(oldSolids.begin(), oldSolids.end(),
+                        [](G4VSolid* solid) { return solid->GetConstituentSolid(0) != nullptr; });
+  for ( auto solid : oldSolids ) delete solid;
+  for (auto cached = fSolids.begin(); cached != fSolids.end(); ) {
+    if (solids.count(cached->second)) ++cached;
+    else cached = fSolids.erase(cached);
+  }
+}
+
+
+void GeometryBuilder::Forget()
+{
+  ClearRegions();
+  fRotations.clear();
+  fSolids.clear();
+  fVolumes.clear();
+}
@@ -0,0 +1,339 @@
+/*
+Overlap checks of the geometry after it is built. With pSurfChk=true every G4PVPlacement checks itself against its
+mother and its sisters while ConstructVolumes runs: one volume after the other, on the master, and again after every
+/custom/geo/change_x, even if the geometry is the same as in an earlier run. For the tessellated CAD parts this takes
+most of the initialisation.
+
+Here the checks run once the whole geometry is built, in DetectorConstruction::Construct:
+  1. the surface points of every placement are sampled in this thread (GetPointOnSurface of boolean solids is not
+     thread-safe), with an engine of its own, so the random sequence of the run does not depend on the checks
+  2. the points are tested against the mother and the sisters with the bounding boxes overlapping, like
+     G4PVPlacement::CheckOverlaps does, spread over threads
+  3. the overlaps are printed as warnings, in the order of the placements
+A geometry is identified by a hash of its placement tree (names, copy numbers, transformations, materials and the
+parameters of the solids from StreamInfo). It is written with the result to the cache file, and a geometry which
+passed before with at least as many points and at most the same tolerance is not checked again.
+
+  /custom/overlaps/mode deferred|placement|off     default deferred; placement is the old check in G4PVPlacement
+  /custom/overlaps/resolution n                    surface points per placement (default 1000, as G4PVPlacement)
+  /custom/overlaps/tolerance value unit            default 0
+  /custom/overlaps/threads n                       0 = one per core
+  /custom/overlaps/cacheFile name                  default OverlapCache.txt, "none" = no cache
+  /custom/overlaps/validate                        check the current geometry now, ignoring the cache
+*/
+
+#include "GeometryValidator.hh"
+#include "ValidatorMessenger.hh"
+#include "Tracer.hh"
+
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4Material.hh"
+#include "G4RotationMatrix.hh"
+#include "G4Threading.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+#include "CLHEP/Random/MixMaxRng.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+  // FNV-1a, 64 bit
+  void HashBytes(uint64_t& hash, const std::string& bytes)
+  {
+    for (unsigned char c : bytes) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+  }
+
+  std::string HashString(uint64_t hash)
+  {
+    std::ostringstream os;
+    os << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return os.str();
+  }
+
+  // a logical volume with its daughters; volumes placed more than once are hashed once
+  uint64_t HashLogical(G4LogicalVolume* logical, std::map<G4LogicalVolume*,uint64_t>& hashes)
+  {
+    auto found = hashes.find(logical);
+    if (found != hashes.end()) return found->second;
+
+    std::ostringstream os;
+    os << std::setprecision(17) << logical->GetName() << "\n"
+       << (logical->GetMaterial() ? logical->GetMaterial()->GetName() : G4String("none")) << "\n";
+    logical->GetSolid()->StreamInfo(os);
+
+    for (std::size_t i = 0; i < logical->GetNoDaughters(); i++) {
+      G4VPhysicalVolume* daughter = logical->GetDaughter(i);
+      const G4RotationMatrix* rotation = daughter->GetRotation();
+      os << daughter->GetName() << " " << daughter->GetCopyNo() << " " << daughter->IsReplicated() << " "
+         << daughter->GetTranslation() << " ";
+      if (rotation) os << rotation->xx() << " " << rotation->xy() << " " << rotation->xz() << " "
+                       << rotation->yx() << " " << rotation->yy() << " " << rotation->yz() << " "
+                       << rotation->zx() << " " << rotation->zy() << " " << rotation->zz();
+      os << " " << HashString(HashLogical(daughter->GetLogicalVolume(), hashes)) << "\n";
+    }
+
+    uint64_t hash = 14695981039346656037ULL;
+    HashBytes(hash, os.str());
+    hashes[logical] = hash;
+    return hash;
+  }
+
+  G4bool BoxesOverlap(const G4ThreeVector& min1, const G4ThreeVector& max1,
+                      const G4ThreeVector& min2, const G4ThreeVector& max2, G4double tolerance)
+  {
+    return min1.x() + tolerance < max2.x() && min2.x() + tolerance < max1.x()
+        && min1.y() + tolerance < max2.y() && min2.y() + tolerance < max1.y()
+        && min1.z() + tolerance < max2.z() && min2.z() + tolerance < max1.z();
+  }
+}
+
+
+GeometryValidator::GeometryValidator()
+: fMode(kDeferred), fResolution(1000), fTolerance(0.), fThreads(0), fCacheFile("OverlapCache.txt"),
+  fWorld(nullptr), fMessenger(nullptr)
+{
+  fMessenger = new ValidatorMessenger(this);
+}
+
+GeometryValidator::~GeometryValidator()
+{
+  delete fMessenger;
+}
+
+
+uint64_t GeometryValidator::GeometryHash(G4VPhysicalVolume* world)
+{
+  std::map<G4LogicalVolume*,uint64_t> hashes;
+  uint64_t hash = 14695981039346656037ULL;
+  HashBytes(hash, world->GetName() + " " + HashString(HashLogical(world->GetLogicalVolume(), hashes)));
+  return hash;
+}
+
+
+G4int GeometryValidator::Validate(G4VPhysicalVolume* world)
+{
+  fWorld = world;
+  if (fMode != kDeferred || !world) return 0;
+
+  uint64_t hash = GeometryHash(world);
+  if (IsCached(hash)) {
+    G4cout << "\n GeometryValidator: geometry " << HashString(hash) << " passed the overlap checks before ("
+           << fCacheFile << "), not checked again" << G4endl;
+    return 0;
+  }
+  return Run(world, hash);
+}
+
+G4int GeometryValidator::ValidateNow()
+{
+  if (!fWorld) {
+    G4cout << "\n--> warning from GeometryValidator : no geometry yet - /run/initialize first" << G4endl;
+    return 0;
+  }
+  return Run(fWorld, GeometryHash(fWorld));
+}
+
+
+G4int GeometryValidator::Run(G4VPhysicalVolume* world, uint64_t hash)
+{
+  Tracer::Span span("CheckOverlaps");
+  auto start = std::chrono::steady_clock::now();
+
+  // 1. surface points, with an engine of its own - the run gets the same random numbers with and without the checks
+  std::vector<Check> checks;
+  CLHEP::HepRandomEngine* runEngine = G4Random::getTheEngine();
+  CLHEP::MixMaxRng pointEngine(12345);
+  G4Random::setTheEngine(&pointEngine);
+  Prepare(world, checks);
+  G4Random::setTheEngine(runEngine);
+
+  // 2. the checks, each placement by one thread
+  G4int nbOfThreads = (fThreads > 0) ? fThreads : G4Threading::G4GetNumberOfCores();
+  nbOfThreads = std::max(1, std::min(nbOfThreads, (G4int)checks.size()));
+  std::atomic<std::size_t> next(0);
+  auto work = [&]() {
+    for (std::size_t i = next++; i < checks.size(); i = next++) CheckOne(checks, i);
+  };
+  std::vector<std::thread> threads;
+  for (G4int t = 1; t < nbOfThreads; t++) threads.emplace_back(work);
+  work();
+  for ( auto& thread : threads ) thread.join();
+
+  // 3. report
+  G4int nbOfOverlaps = 0;
+  for ( const auto& check : checks ) {
+    for ( const auto& overlap : check.fOverlaps ) {
+      nbOfOverlaps++;
+      G4cout << "\n--> warning from GeometryValidator : '" << check.fVolume->GetName() << "'";
+      if (overlap.fProtrudes)
+        G4cout << " protrudes from its mother '" << overlap.fOther << "' by " << G4BestUnit(overlap.fDepth,"Length");
+      else if (overlap.fDepth < 0.)
+        G4cout << " contains its sister '" << overlap.fOther << "' completely";
+      else
+        G4cout << " overlaps with '" << overlap.fOther << "' by " << G4BestUnit(overlap.fDepth,"Length");
+      G4cout << " at " << G4BestUnit(overlap.fPoint,"Length") << " (frame of the mother)" << G4endl;
+    }
+  }
+  G4double seconds = std::chrono::duration<G4double>(std::chrono::steady_clock::now() - start).count();
+  G4int precision = G4cout.precision(3);
+  G4cout << "\n GeometryValidator: " << checks.size() << " placements with " << fResolution << " points each, "
+         << seconds << " s on " << nbOfThreads << " threads: ";
+  if (nbOfOverlaps == 0) G4cout << "no overlaps";
+  else                   G4cout << nbOfOverlaps << " overlaps";
+  G4cout << "  (geometry " << HashString(hash) << ")" << G4endl;
+  G4cout.precision(precision);
+
+  AddToCache(hash, nbOfOverlaps);
+  return nbOfOverlaps;
+}
+
+
+void GeometryValidator::Prepare(G4VPhysicalVolume* world, std::vector<Check>& checks) const
+{
+  std::set<G4LogicalVolume*> visited;
+  std::vector<G4LogicalVolume*> mothers = { world->GetLogicalVolume() };
+  while (!mothers.empty()) {
+    G4LogicalVolume* mother = mothers.back();
+    mothers.pop_back();
+    if (!visited.insert(mother).second) continue;
+
+    std::size_t first = checks.size();
+    for (std::size_t i = 0; i < mother->GetNoDaughters(); i++) {
+      G4VPhysicalVolume* daughter = mother->GetDaughter(i);
+      mothers.push_back(daughter->GetLogicalVolume());
+      if (daughter->IsReplicated()) continue;        // replicas and parameterisations are not checked, as in Geant4
+
+      Check check;
+      check.fVolume    = daughter;
+      check.fTransform = G4AffineTransform(daughter->GetRotation(), daughter->GetTranslation());
+      G4VSolid* solid  = daughter->GetLogicalVolume()->GetSolid();
+      check.fPoints.reserve(fResolution);
+      for (G4int n = 0; n < fResolution; n++)
+        check.fPoints.push_back(check.fTransform.TransformPoint(solid->GetPointOnSurface()));
+
+      // extent in the frame of the mother from the corners of the bounding box
+      G4ThreeVector pMin, pMax;
+      solid->BoundingLimits(pMin, pMax);
+      check.fMin = G4ThreeVector( DBL_MAX,  DBL_MAX,  DBL_MAX);
+      check.fMax = G4ThreeVector(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+      for (G4int corner = 0; corner < 8; corner++) {
+        G4ThreeVector p = check.fTransform.TransformPoint(G4ThreeVector((corner & 1) ? pMax.x() : pMin.x(),
+                                                                        (corner & 2) ? pMax.y() : pMin.y(),
+                                                                        (corner & 4) ? pMax.z() : pMin.z()));
+        check.fMin.set(std::min(check.fMin.x(), p.x()), std::min(check.fMin.y(), p.y()), std::min(check.fMin.z(), p.z()));
+        check.fMax.set(std::max(check.fMax.x(), p.x()), std::max(check.fMax.y(), p.y()), std::max(check.fMax.z(), p.z()));
+      }
+      checks.push_back(check);
+    }
+
+    // only sisters with overlapping bounding boxes can overlap
+    for (std::size_t i = first; i < checks.size(); i++) {
+      for (std::size_t j = first; j < checks.size(); j++) {
+        if (i != j && BoxesOverlap(checks[i].fMin, checks[i].fMax, checks[j].fMin, checks[j].fMax, fTolerance))
+          checks[i].fSisters.push_back(j);
+      }
+    }
+  }
+}
+
+
+// runs in the threads: reads the points of all placements, writes only the overlaps of its own
+void GeometryValidator::CheckOne(std::vector<Check>& checks, std::size_t index) const
+{
+  Check& check = checks[index];
+
+  // points of the daughter outside of the mother
+  G4VSolid* motherSolid = check.fVolume->GetMotherLogical()->GetSolid();
+  Overlap protrusion = { check.fVolume->GetMotherLogical()->GetName(), 0., G4ThreeVector(), true };
+  for ( const auto& point : check.fPoints ) {
+    if (motherSolid->Inside(point) != kOutside) continue;
+    G4double depth = motherSolid->DistanceToIn(point);
+    if (depth > fTolerance && depth > protrusion.fDepth) {
+      protrusion.fDepth = depth;
+      protrusion.fPoint = point;
+    }
+  }
+  if (protrusion.fDepth > 0.) check.fOverlaps.push_back(protrusion);
+
+  // points of the daughter inside of a sister
+  G4VSolid* solid = check.fVolume->GetLogicalVolume()->GetSolid();
+  G4AffineTransform toDaughter = check.fTransform.Inverse();
+  for (std::size_t s : check.fSisters) {
+    const Check& sister = checks[s];
+    G4VSolid* sisterSolid = sister.fVolume->GetLogicalVolume()->GetSolid();
+    G4AffineTransform toSister = sister.fTransform.Inverse();
+
+    Overlap overlap = { sister.fVolume->GetName(), 0., G4ThreeVector(), false };
+    for ( const auto& point : check.fPoints ) {
+      G4ThreeVector local = toSister.TransformPoint(point);
+      if (sisterSolid->Inside(local) != kInside) continue;
+      G4double depth = sisterSolid->DistanceToOut(local);
+      if (depth > fTolerance && depth > overlap.fDepth) {
+        overlap.fDepth = depth;
+        overlap.fPoint = point;
+      }
+    }
+    // a sister completely inside of the daughter has no point of the daughter in it
+    if (overlap.fDepth == 0. && !sister.fPoints.empty()
+        && solid->Inside(toDaughter.TransformPoint(sister.fPoints.front())) == kInside) {
+      overlap.fDepth = -1.;
+      overlap.fPoint = sister.fPoints.front();
+    }
+    if (overlap.fDepth != 0.) check.fOverlaps.push_back(overlap);
+  }
+}
+
+
+// a geometry which passed with at least as many points and at most the same tolerance
+G4bool GeometryValidator::IsCached(uint64_t hash) const
+{
+  if (fCacheFile == "none") return false;
+  std::ifstream file(fCacheFile);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream is(line);
+    std::string entry;
+    G4int resolution = 0, overlaps = 0;
+    G4double tolerance = 0.;
+    if (!(is >> entry >> resolution >> tolerance >> overlaps)) continue;
+    if (entry == HashString(hash) && overlaps == 0 && resolution >= fResolution && tolerance*mm <= fTolerance)
+      return true;
+  }
+  return false;
+}
+
+// appends one line - written at once, so processes sharing the file do not mix their lines
+void GeometryValidator::AddToCache(uint64_t hash, G4int overlaps) const
+{
+  if (fCacheFile == "none") return;
+  G4bool exists = std::ifstream(fCacheFile).good();
+  std::ofstream file(fCacheFile, std::ios::app);
+  if (!file) {
+    G4cout << "\n--> warning from GeometryValidator : can not write " << fCacheFile << G4endl;
+    return;
+  }
+  std::time_t now = std::time(nullptr);
+  std::ostringstream line;
+  if (!exists) line << "# geometry, points per placement, tolerance [mm], overlaps, date\n";
+  line << HashString(hash) << " " << fResolution << " " << std::setprecision(17) << fTolerance/mm << " "
+       << overlaps << " " << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M:%S") << "\n";
+  file << line.str();
+}
@@ -0,0 +1,215 @@
+/*
+Compact columnar hit files. The ROOT ntuples carry a lot of machinery for what is mostly four columns per SD;
+here every ntuple becomes a table of fixed columns, written in chunks of up to 65536 rows. Each column of a chunk is
+one contiguous array, padded to 8 bytes, so a memory-mapped file can be used directly as float/double arrays.
+
+The header text holds the schema and the run parameters as "key value" lines (see OutputWriter::BeginOfRun and
+RunAction::BeginOfRunAction), e.g.
+  column 0 Ekin MeV
+  table 1 N_SD1
+  runID 0
+  events 1000000
+  absorber G4_Pb
+  absorberThickness_cm 5.000000
+  engineSeed 987654321
+  baseSeed 12345                 (baseSeed and eventOffset only in segmented runs)
+  eventOffset 0
+*/
+
+#include "HitFile.hh"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+HitFileWriter::HitFileWriter()
+: fFile(nullptr), fValueSize(4), fChunkRows(65536), fBytesWritten(0)
+{ }
+
+
+HitFileWriter::~HitFileWriter()
+{
+  Close();
+}
+
+
+bool HitFileWriter::Open(const std::string& fileName, uint32_t valueSize, const std::string& text)
+{
+  Close();
+
+  fFile = std::fopen(fileName.c_str(), "wb");
+  if (!fFile) return false;
+
+  fValueSize    = (valueSize == 8) ? 8 : 4;
+  fBytesWritten = 0;
+  for ( auto& table : fTables ) {
+    table.fEvents.clear();
+    for ( auto& column : table.fColumns ) column.clear();
+  }
+
+  HitFile::FileHeader header;
+  std::memcpy(header.fMagic, HitFile::kMagic, sizeof(header.fMagic));
+  header.fValueSize = fValueSize;
+  header.fTextSize  = text.size();
+  WritePadded(&header, sizeof(header));
+  WritePadded(text.data(), text.size());
+
+  return true;
+}
+
+
+void HitFileWriter::WritePadded(const void* data, uint64_t size)
+{
+  static const char zeros[8] = { 0 };
+  std::fwrite(data, 1, size, fFile);
+  std::fwrite(zeros, 1, HitFile::Padded(size) - size, fFile);
+  fBytesWritten += HitFile::Padded(size);
+}
+
+
+void HitFileWriter::Fill(uint32_t table, int64_t event, double ekin, double x, double y, double time)
+{
+  if (!fFile || table >= HitFile::kNbOfTables) return;
+
+  Table& data = fTables[table];
+  data.fEvents.push_back(event);
+  data.fColumns[0].push_back(ekin);
+  data.fColumns[1].push_back(x);
+  data.fColumns[2].push_back(y);
+  data.fColumns[3].push_back(time);
+
+  if (data.fEvents.size() >= fChunkRows) WriteChunk(table);
+}
+
+
+void HitFileWriter::WriteChunk(uint32_t table)
+{
+  Table& data = fTables[table];
+  uint32_t rows = data.fEvents.size();
+  if (rows == 0) return;
+
+  uint64_t columnSize = HitFile::Padded((uint64_t)rows*fValueSize);
+
+  HitFile::ChunkHeader header;
+  header.fTable = table;
+  header.fRows  = rows;
+  header.fSize  = (uint64_t)rows*sizeof(int64_t) + HitFile::kNbOfColumns*columnSize;
+  WritePadded(&header, sizeof(header));
+  WritePadded(data.fEvents.data(), (uint64_t)rows*sizeof(int64_t));
+
+  for ( auto& column : data.fColumns ) {
+    if (fValueSize == 8) {
+      WritePadded(column.data(), (uint64_t)rows*sizeof(double));
+    }
+    else {
+      fScratch.resize((size_t)rows*sizeof(float));
+      float* values = reinterpret_cast<float*>(fScratch.data());
+      for (uint32_t i = 0; i < rows; i++) values[i] = (float)column[i];
+      WritePadded(values, (uint64_t)rows*sizeof(float));
+    }
+    column.clear();
+  }
+  data.fEvents.clear();
+}
+
+
+void HitFileWriter::Close()
+{
+  if (!fFile) return;
+
+  for (uint32_t table = 0; table < HitFile::kNbOfTables; table++) WriteChunk(table);
+  std::fclose(fFile);
+  fFile = nullptr;
+}
+
+
+HitFileReader::HitFileReader()
+: fData(nullptr), fSize(0), fValueSize(0)
+{ }
+
+
+HitFileReader::~HitFileReader()
+{
+  Close();
+}
+
+
+bool HitFileReader::Open(const std::string& fileName)
+{
+  Close();
+
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(HitFile::FileHeader)) { ::close(fd); return false; }
+
+  void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) return false;
+
+  fData = static_cast<const char*>(data);
+  fSize = st.st_size;
+
+  const HitFile::FileHeader* header = reinterpret_cast<const HitFile::FileHeader*>(fData);
+  uint64_t offset = sizeof(HitFile::FileHeader) + HitFile::Padded(header->fTextSize);
+  // the columns are read as float or double by the value size, anything else is not a hit file of ours
+  if (std::memcmp(header->fMagic, HitFile::kMagic, sizeof(header->fMagic)) != 0 || offset > fSize
+      || (header->fValueSize != 4 && header->fValueSize != 8)) {
+    Close();
+    return false;
+  }
+  fValueSize = header->fValueSize;
+  fText.assign(fData + sizeof(HitFile::FileHeader), header->fTextSize);
+
+  // index the chunks - a chunk cut off by a crash is ignored
+  while (offset + sizeof(HitFile::ChunkHeader) <= fSize) {
+    const HitFile::ChunkHeader* chunkHeader = reinterpret_cast<const HitFile::ChunkHeader*>(fData + offset);
+    offset += sizeof(HitFile::ChunkHeader);
+    if (offset + chunkHeader->fSize > fSize) break;
+
+    // a complete chunk must have the columns of the header's value size
+    uint64_t expected = HitFile::Padded((uint64_t)chunkHeader->fRows*sizeof(int64_t))
+                      + HitFile::kNbOfColumns*HitFile::Padded((uint64_t)chunkHeader->fRows*fValueSize);
+    if (chunkHeader->fSize != expected || chunkHeader->fTable >= HitFile::kNbOfTables) {
+      Close();
+      return false;
+    }
+
+    Chunk chunk;
+    chunk.fTable  = chunkHeader->fTable;
+    chunk.fRows   = chunkHeader->fRows;
+    chunk.fEvents = reinterpret_cast<const int64_t*>(fData + offset);
+    uint64_t columnOffset = offset + HitFile::Padded((uint64_t)chunk.fRows*sizeof(int64_t));
+    for (uint32_t c = 0; c < HitFile::kNbOfColumns; c++) {
+      chunk.fColumns[c] = fData + columnOffset;
+      columnOffset += HitFile::Padded((uint64_t)chunk.fRows*fValueSize);
+    }
+    fChunks.push_back(chunk);
+
+    offset += chunkHeader->fSize;
+  }
+
+  return true;
+}
+
+
+void HitFileReader::Close()
+{
+  if (fData) ::munmap(const_cast<char*>(fData), fSize);
+  fData = nullptr;
+  fSize = 0;
+  fText.clear();
+  fChunks.clear();
+}
+
+
+uint64_t HitFileReader::GetNbOfRows(uint32_t table) const
+{
+  uint64_t rows = 0;
+  for ( const auto& chunk : fChunks ) if (chunk.fTable == table) rows += chunk.fRows;
+  return rows;
+}
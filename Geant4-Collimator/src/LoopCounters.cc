@@ -0,0 +1,192 @@
+/*
+Event-loop counters, to see which configurations are expensive and why: a slow run has either many tracks per event
+(showers, low cuts), many steps per track (step limits, fine geometry) or slow steps (HP physics, tessellated
+solids) - the counters tell these apart.
+
+Every thread counts into its own ThreadData (thread_local, allocated on first use and kept in a list). At the end of
+the run the master prints per thread
+  events, tracks/event, steps/event, secondaries/event, ms/event
+and for all threads together the quantiles of these distributions and the log2 histogram of the wall time per event.
+With /custom/loop/dumpInterval every thread also prints its own line during the run.
+*/
+
+#include "LoopCounters.hh"
+#include "LoopMessenger.hh"
+
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace {
+  G4Mutex loopCountersMutex = G4MUTEX_INITIALIZER;
+  std::vector<std::unique_ptr<LoopCounters::ThreadData>> threadData;    // all threads, owned here
+}
+
+LoopCounters* LoopCounters::fgInstance = nullptr;
+G4bool LoopCounters::fgEnabled = false;
+G4double LoopCounters::fgDumpInterval = 0.;
+G4ThreadLocal LoopCounters::ThreadData* LoopCounters::fgLocal = nullptr;
+
+
+LoopCounters::LoopCounters()
+: fLoopMessenger(nullptr)
+{
+  fgInstance = this;
+  fLoopMessenger = new LoopMessenger(this);
+}
+
+
+LoopCounters::~LoopCounters()
+{
+  delete fLoopMessenger;
+  fgInstance = nullptr;
+}
+
+
+void LoopCounters::Distribution::Fill(G4long value)
+{
+  G4int bin = 0;
+  for (G4long v = value; v > 0 && bin < kNbOfBins - 1; v >>= 1) bin++;
+  fBins[bin]++;
+  fEntries++;
+  fSum  += value;
+  fSum2 += (G4double)value*value;
+  if (value > fMax) fMax = value;
+}
+
+
+void LoopCounters::Distribution::Add(const Distribution& other)
+{
+  fEntries += other.fEntries;
+  fSum     += other.fSum;
+  fSum2    += other.fSum2;
+  if (other.fMax > fMax) fMax = other.fMax;
+  for (G4int i = 0; i < kNbOfBins; i++) fBins[i] += other.fBins[i];
+}
+
+
+G4double LoopCounters::Distribution::Quantile(G4double q) const
+{
+  G4long count = 0;
+  for (G4int i = 0; i < kNbOfBins; i++) {
+    count += fBins[i];
+    if (count >= q*fEntries) return (i == 0) ? 0. : std::ldexp(1., i);
+  }
+  return fMax;
+}
+
+
+LoopCounters::ThreadData& LoopCounters::Register()
+{
+  auto data = std::make_unique<ThreadData>();
+  data->fThread   = G4Threading::G4GetThreadId();
+  data->fLastDump = std::chrono::steady_clock::now();
+
+  G4AutoLock lock(&loopCountersMutex);
+  fgLocal = data.get();
+  threadData.push_back(std::move(data));
+  return *fgLocal;
+}
+
+
+void LoopCounters::BeginOfEvent()
+{
+  ThreadData& data = Local();
+  data.fTracks = data.fSteps = data.fSecondaries = 0;
+  data.fEventStart = std::chrono::steady_clock::now();
+}
+
+
+void LoopCounters::EndOfEvent()
+{
+  ThreadData& data = Local();
+  auto now = std::chrono::steady_clock::now();
+  data.fTracksPerEvent.Fill(data.fTracks);
+  data.fStepsPerEvent.Fill(data.fSteps);
+  data.fSecondariesPerEvent.Fill(data.fSecondaries);
+  data.fTimePerEvent.Fill(std::chrono::duration_cast<std::chrono::nanoseconds>(now - data.fEventStart).count());
+
+  if (fgDumpInterval > 0. && std::chrono::duration<G4double>(now - data.fLastDump).count() > fgDumpInterval) {
+    data.fLastDump = now;
+    Print(data, "now");
+  }
+}
+
+
+void LoopCounters::BeginOfRun()
+{
+  // before the workers start: no thread is counting
+  G4AutoLock lock(&loopCountersMutex);
+  auto now = std::chrono::steady_clock::now();
+  for ( auto& data : threadData ) {
+    G4int thread = data->fThread;
+    *data = ThreadData();
+    data->fThread   = thread;
+    data->fLastDump = now;
+  }
+}
+
+
+void LoopCounters::Print(const ThreadData& data, const G4String& label)
+{
+  G4cout << std::setw(7)  << label
+         << std::setw(10) << data.fTimePerEvent.fEntries
+         << std::setw(11) << data.fTracksPerEvent.Mean()
+         << std::setw(11) << data.fStepsPerEvent.Mean()
+         << std::setw(13) << data.fSecondariesPerEvent.Mean()
+         << std::setw(11) << data.fTimePerEvent.Mean()*1.e-6 << G4endl;
+}
+
+
+void LoopCounters::EndOfRun() const
+{
+  if (!fgEnabled) return;
+
+  G4AutoLock lock(&loopCountersMutex);
+  G4int dfprec = G4cout.precision(4);
+
+  G4cout << "\n ========================= Event loop ========================="
+         << "\n thread    events  tracks/ev   steps/ev  secondar./ev   ms/event" << G4endl;
+
+  ThreadData total;
+  for ( const auto& data : threadData ) {
+    if (data->fTimePerEvent.fEntries == 0) continue;
+    Print(*data, (data->fThread < 0) ? G4String("master") : G4String(std::to_string(data->fThread)));
+    total.fTracksPerEvent.Add(data->fTracksPerEvent);
+    total.fStepsPerEvent.Add(data->fStepsPerEvent);
+    total.fSecondariesPerEvent.Add(data->fSecondariesPerEvent);
+    total.fTimePerEvent.Add(data->fTimePerEvent);
+  }
+  Print(total, "all");
+
+  // quantiles: bin edges, so within a factor of 2
+  auto quantiles = [](const G4String& name, const Distribution& d, G4double scale) {
+    G4cout << " " << std::left << std::setw(16) << name << std::right
+           << "  median < " << std::setw(9) << d.Quantile(0.5)*scale
+           << "  90% < "    << std::setw(9) << d.Quantile(0.9)*scale
+           << "  99% < "    << std::setw(9) << d.Quantile(0.99)*scale
+           << "  max "      << std::setw(9) << d.fMax*scale << G4endl;
+  };
+  G4cout << G4endl;
+  quantiles("tracks/event",      total.fTracksPerEvent,      1.);
+  quantiles("steps/event",       total.fStepsPerEvent,       1.);
+  quantiles("secondaries/event", total.fSecondariesPerEvent, 1.);
+  quantiles("ms/event",          total.fTimePerEvent,        1.e-6);
+
+  // wall time histogram
+  G4cout << "\n wall time per event:" << G4endl;
+  const Distribution& time = total.fTimePerEvent;
+  G4long maxCount = 1;
+  for ( auto count : time.fBins ) maxCount = std::max(maxCount, count);
+  for (G4int i = 1; i < Distribution::kNbOfBins; i++) {
+    if (time.fBins[i] == 0) continue;
+    G4cout << "  [" << std::setw(10) << std::ldexp(1., i - 1)*1.e-3 << ", " << std::setw(10) << std::ldexp(1., i)*1.e-3
+           << ") us " << std::setw(10) << time.fBins[i] << "  "
+           << std::string(std::lround(50.*time.fBins[i]/maxCount), '#') << G4endl;
+  }
+  G4cout << " ==============================================================" << G4endl;
+  G4cout.precision(dfprec);
+}
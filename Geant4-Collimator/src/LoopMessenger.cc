@@ -0,0 +1,64 @@
+/*
+Commands for the event-loop counters - see LoopCounters.cc
+*/
+
+#include "LoopMessenger.hh"
+
+#include "LoopCounters.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4SystemOfUnits.hh"
+
+
+LoopMessenger::LoopMessenger(LoopCounters* counters)
+:G4UImessenger(),
+ fLoopCounters(counters), fLoopDir(nullptr),
+ fEnableCmd(nullptr), fDumpCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fLoopDir = new G4UIdirectory("/custom/loop/",broadcast);
+  fLoopDir->SetGuidance("Counters of the event loop: events, tracks, steps, secondaries and time per event.");
+
+  // Counters on/off
+  fEnableCmd = new G4UIcmdWithABool("/custom/loop/enable",this);
+  fEnableCmd->SetGuidance("Count per thread and print the summary at the end of the run (default false)");
+#ifndef COLLI_LOOP_COUNTERS
+  fEnableCmd->SetGuidance("Not available: compiled without WITH_LOOP_COUNTERS");
+#endif
+  fEnableCmd->SetParameterName("flag",true);
+  fEnableCmd->SetDefaultValue(true);
+  fEnableCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Periodic output
+  fDumpCmd = new G4UIcmdWithADoubleAndUnit("/custom/loop/dumpInterval",this);
+  fDumpCmd->SetGuidance("Every thread prints its counters after this wall time during the run (0 = only at the end)");
+  fDumpCmd->SetParameterName("interval",false);
+  fDumpCmd->SetRange("interval>=0.");
+  fDumpCmd->SetUnitCategory("Time");
+  fDumpCmd->SetDefaultUnit("s");
+  fDumpCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+}
+
+
+LoopMessenger::~LoopMessenger()
+{
+  delete fEnableCmd;
+  delete fDumpCmd;
+  delete fLoopDir;
+}
+
+
+void LoopMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fEnableCmd ) {
+#ifdef COLLI_LOOP_COUNTERS
+    fLoopCounters->SetEnabled(fEnableCmd->GetNewBoolValue(newValue));
+#else
+    G4cout << "\n--> warning from LoopMessenger : compiled without WITH_LOOP_COUNTERS, no counters" << G4endl;
+#endif
+  }
+
+  if( command == fDumpCmd )
+   { fLoopCounters->SetDumpInterval(fDumpCmd->GetNewDoubleValue(newValue)/s);}
+}
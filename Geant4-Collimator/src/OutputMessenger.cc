@@ -0,0 +1,100 @@
+/*
+Commands for the asynchronous hit output - see OutputWriter.cc and HitFile.cc
+*/
+
+#include "OutputMessenger.hh"
+
+#include "OutputWriter.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithAString.hh"
+
+
+OutputMessenger::OutputMessenger(OutputWriter* writer)
+:G4UImessenger(),
+ fOutputWriter(writer), fOutputDir(nullptr),
+ fAsyncCmd(nullptr), fQueueSizeCmd(nullptr), fNtuplesCmd(nullptr),
+ fFormatCmd(nullptr), fPrecisionCmd(nullptr), fMergeCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fOutputDir = new G4UIdirectory("/custom/output/",broadcast);
+  fOutputDir->SetGuidance("Output of the sensitive detector hits.");
+
+  // Writer thread on/off
+  fAsyncCmd = new G4UIcmdWithABool("/custom/output/async",this);
+  fAsyncCmd->SetGuidance("Write the SD hits from a separate writer thread into a compressed file (default false)");
+  fAsyncCmd->SetParameterName("flag",true);
+  fAsyncCmd->SetDefaultValue(true);
+  fAsyncCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Queue length per worker thread
+  fQueueSizeCmd = new G4UIcmdWithAnInteger("/custom/output/queueSize",this);
+  fQueueSizeCmd->SetGuidance("Number of events each worker thread can queue for the writer (default 1024)");
+  fQueueSizeCmd->SetParameterName("n",false);
+  fQueueSizeCmd->SetRange("n>0");
+  fQueueSizeCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Keep the G4AnalysisManager ntuples
+  fNtuplesCmd = new G4UIcmdWithABool("/custom/output/ntuples",this);
+  fNtuplesCmd->SetGuidance("Fill the SD ntuples of the ROOT file as well while the writer thread is on (default true)");
+  fNtuplesCmd->SetParameterName("flag",true);
+  fNtuplesCmd->SetDefaultValue(true);
+  fNtuplesCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // File format of the writer thread
+  fFormatCmd = new G4UIcmdWithAString("/custom/output/format",this);
+  fFormatCmd->SetGuidance("gzip: compressed hit records (.hits.gz), columnar: memory-mappable columns (.hits)");
+  fFormatCmd->SetParameterName("format",false);
+  fFormatCmd->SetCandidates("gzip columnar");
+  fFormatCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Value type of the columnar files
+  fPrecisionCmd = new G4UIcmdWithAString("/custom/output/precision",this);
+  fPrecisionCmd->SetGuidance("float32 or float64 columns in the columnar files (default float)");
+  fPrecisionCmd->SetParameterName("type",false);
+  fPrecisionCmd->SetCandidates("float double");
+  fPrecisionCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Ntuple merging into the master file
+  fMergeCmd = new G4UIcmdWithABool("/custom/output/mergeNtuples",this);
+  fMergeCmd->SetGuidance("true: the master collects the ntuple rows of all workers into one file (default)");
+  fMergeCmd->SetGuidance("false: every worker writes its own file <name>_t<thread>.root, merge them with ColliMerge");
+  fMergeCmd->SetParameterName("flag",true);
+  fMergeCmd->SetDefaultValue(true);
+  fMergeCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+}
+
+
+OutputMessenger::~OutputMessenger()
+{
+  delete fAsyncCmd;
+  delete fQueueSizeCmd;
+  delete fNtuplesCmd;
+  delete fFormatCmd;
+  delete fPrecisionCmd;
+  delete fMergeCmd;
+  delete fOutputDir;
+}
+
+
+void OutputMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fAsyncCmd )
+   { fOutputWriter->SetEnabled(fAsyncCmd->GetNewBoolValue(newValue));}
+
+  if( command == fQueueSizeCmd )
+   { fOutputWriter->SetQueueSize(fQueueSizeCmd->GetNewIntValue(newValue));}
+
+  if( command == fNtuplesCmd )
+   { fOutputWriter->SetWriteNtuples(fNtuplesCmd->GetNewBoolValue(newValue));}
+
+  if( command == fFormatCmd )
+   { fOutputWriter->SetFormat(newValue == "columnar" ? OutputWriter::kColumnar : OutputWriter::kGzip);}
+
+  if( command == fPrecisionCmd )
+   { fOutputWriter->SetValueSize(newValue == "double" ? 8 : 4);}
+
+  if( command == fMergeCmd )
+   { fOutputWriter->SetMergeNtuples(fMergeCmd->GetNewBoolValue(newValue));}
+}
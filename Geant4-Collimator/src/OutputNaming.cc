@@ -0,0 +1,183 @@
+/*
+Output naming without probing the filesystem. The old scheme looped over ID_<pid>.root, ID_<pid+1>.root, ... until
+a name was free - in the master and in every worker, racing against other processes on the same shared folder.
+
+Now every process has a tag:
+  - batch job:  job<JOB_ID>_<ARRAY_INDEX>[_p<TASK>] from the SLURM, PBS/Torque, SGE or LSF environment
+  - otherwise:  a random UUID
+The tag is claimed with mkdir of Output/Runs/<tag>, which is atomic; only if a job ID is re-used the mkdir fails and
+the tag gets a suffix. The manifest in that folder lists every file the process wrote, e.g.
+  tag   job4711_3
+  host  node17
+  pid   12345
+  file  root   Output/Root Files/ID_job4711_3_r0.root
+*/
+
+#include "OutputNaming.hh"
+
+#include "G4AutoLock.hh"
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+// get folderName from where it is defined (RunAction.cc) - the really dirty way
+extern std::string folderName;
+
+namespace {
+  G4Mutex manifestMutex = G4MUTEX_INITIALIZER;
+}
+
+OutputNaming* OutputNaming::fgInstance = nullptr;
+
+
+OutputNaming::OutputNaming()
+{
+  fgInstance = this;
+  fTag = MakeTag();
+}
+
+
+OutputNaming::~OutputNaming()
+{
+  fgInstance = nullptr;
+}
+
+
+G4String OutputNaming::MakeTag() const
+{
+  // job ID and array index of the common batch systems
+  const char* jobVars[][2] = { { "SLURM_ARRAY_JOB_ID", "SLURM_ARRAY_TASK_ID" },
+                               { "SLURM_JOB_ID",       nullptr               },
+                               { "PBS_JOBID",          "PBS_ARRAYID"         },
+                               { "JOB_ID",             "SGE_TASK_ID"         },
+                               { "LSB_JOBID",          "LSB_JOBINDEX"        } };
+
+  std::string tag;
+  for ( const auto& vars : jobVars ) {
+    const char* job = std::getenv(vars[0]);
+    if (!job) continue;
+    tag = std::string("job") + job;
+    const char* index = vars[1] ? std::getenv(vars[1]) : nullptr;
+    if (index && std::string(index) != "undefined") tag += std::string("_") + index;
+    // several tasks of one job step
+    const char* task = std::getenv("SLURM_PROCID");
+    if (task && std::string(task) != "0") tag += std::string("_p") + task;
+    break;
+  }
+
+  if (tag.empty()) {
+    // random UUID (version 4)
+    std::random_device device;
+    std::seed_seq seq{ device(), device(), (unsigned)getpid(),
+                       (unsigned)std::chrono::high_resolution_clock::now().time_since_epoch().count() };
+    std::mt19937_64 engine(seq);
+    unsigned long long hi = engine(), lo = engine();
+    hi = (hi & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL;
+    lo = (lo & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;
+
+    std::ostringstream uuid;
+    uuid << std::hex << std::setfill('0')
+         << std::setw(8) << (hi >> 32) << "-" << std::setw(4) << ((hi >> 16) & 0xFFFF) << "-"
+         << std::setw(4) << (hi & 0xFFFF) << "-" << std::setw(4) << (lo >> 48) << "-"
+         << std::setw(12) << (lo & 0xFFFFFFFFFFFFULL);
+    tag = uuid.str();
+  }
+
+  // keep the tag usable as part of a file name
+  for ( auto& c : tag ) {
+    if (!std::isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.') c = '_';
+  }
+  return tag;
+}
+
+
+void OutputNaming::ClaimRunFolder()
+{
+  G4String parent = folderName + "/Runs";
+  std::error_code ec;
+  fs::create_directories(parent, ec);
+
+  // mkdir is atomic: exactly one process gets a given folder
+  G4String tag = fTag;
+  for (G4int attempt = 2; ; attempt++) {
+    if (::mkdir((parent + "/" + tag).c_str(), 0755) == 0) break;
+    if (errno != EEXIST) {
+      G4cout << "\n--> warning from OutputNaming : can not create " << parent + "/" + tag << G4endl;
+      break;
+    }
+    tag = fTag + "_" + std::to_string(attempt);
+  }
+  fTag       = tag;
+  fRunFolder = parent + "/" + tag;
+
+  char host[256] = "unknown";
+  gethostname(host, sizeof(host) - 1);
+  std::time_t now = std::time(nullptr);
+
+  std::ofstream manifest(fRunFolder + "/manifest.txt");
+  manifest << "tag   " << fTag << "\n"
+           << "host  " << host << "\n"
+           << "pid   " << getpid() << "\n"
+           << "start " << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M:%S") << "\n";
+}
+
+
+G4String OutputNaming::GetTag()
+{
+  GetRunFolder();
+  return fTag;
+}
+
+
+G4String OutputNaming::GetRunFolder()
+{
+  G4AutoLock lock(&manifestMutex);
+  if (fRunFolder.empty()) ClaimRunFolder();
+  return fRunFolder;
+}
+
+
+G4String OutputNaming::GetFileName(G4String prefix, G4int runID, G4String extension)
+{
+  return prefix + "_" + GetTag() + "_r" + std::to_string(runID) + extension;
+}
+
+
+G4long OutputNaming::GetSeed(G4int runID)
+{
+  // hash of the tag and the run ID, in the range of the old pid seeds
+  G4String tag = GetTag();
+  unsigned long long hash = 1469598103934665603ULL;
+  for ( char c : tag ) hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+  hash = (hash ^ (unsigned long long)runID) * 1099511628211ULL;
+  return 1 + (G4long)(hash % 2147483646ULL);
+}
+
+
+void OutputNaming::Register(G4String kind, G4String path)
+{
+  G4String runFolder = GetRunFolder();
+
+  G4AutoLock lock(&manifestMutex);
+  std::ofstream manifest(runFolder + "/manifest.txt", std::ios::app);
+  manifest << "file  " << std::left << std::setw(6) << kind << " " << path << "\n";
+}
+
+
+void OutputNaming::SetWorker(G4int index)
+{
+  // the parent's run folder and manifest stay with the parent
+  fTag = GetTag() + "_w" + std::to_string(index);
+  fRunFolder.clear();
+}
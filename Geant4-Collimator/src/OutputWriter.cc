@@ -0,0 +1,291 @@
+/*
+Asynchronous output of the SD hits. With SetNtupleMerging(true) every AddNtupleRow of a worker ends up in the
+merge of the master, and the file writes happen on the simulation threads. Here the workers only append the hits
+of the running event to a vector; at the end of the event the vector is pushed into a single-producer single-consumer
+queue of the thread. The writer thread drains all queues, encodes the hits and writes them through zlib.
+A worker only waits if its queue is full, i.e. the writer can not keep up - this is counted as a stall.
+
+File layout (gzip): a text header of two lines, then fixed records of 44 bytes in native byte order
+  int64 event, int32 ntuple, float64 Ekin [MeV], float64 X [cm], float64 Y [cm], float64 time [ns]
+With /custom/output/format columnar the writer thread fills a HitFileWriter instead - see HitFile.cc
+*/
+
+#include "OutputWriter.hh"
+#include "OutputMessenger.hh"
+#include "HitFile.hh"
+#include "OutputNaming.hh"
+
+#include "G4RunManager.hh"
+#include "G4Threading.hh"
+
+#include "zlib.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace {
+  // size of the blocks handed to zlib
+  const size_t kChunkSize  = 1 << 20;
+  const size_t kRecordSize = sizeof(G4long) + sizeof(G4int) + 4*sizeof(G4double);
+}
+
+OutputWriter* OutputWriter::fgInstance = nullptr;
+
+
+OutputWriter::EventQueue::EventQueue(size_t capacity)
+: fHead(0), fTail(0)
+{
+  // power of two, so the index wraps with a mask
+  size_t size = 1;
+  while (size < capacity) size <<= 1;
+  fSlots.resize(size);
+  fMask = size - 1;
+}
+
+
+G4bool OutputWriter::EventQueue::Push(std::vector<HitRecord>& event)
+{
+  size_t tail = fTail.load(std::memory_order_relaxed);
+  if (tail - fHead.load(std::memory_order_acquire) == fSlots.size()) return false;
+
+  // the slot holds an emptied vector from the consumer - swap it back to the producer
+  fSlots[tail & fMask].swap(event);
+  event.clear();
+  fTail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+
+G4bool OutputWriter::EventQueue::Pop(std::vector<HitRecord>& event)
+{
+  size_t head = fHead.load(std::memory_order_relaxed);
+  if (head == fTail.load(std::memory_order_acquire)) return false;
+
+  event.clear();
+  event.swap(fSlots[head & fMask]);
+  fHead.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+
+size_t OutputWriter::EventQueue::Size() const
+{
+  return fTail.load(std::memory_order_acquire) - fHead.load(std::memory_order_acquire);
+}
+
+
+OutputWriter::OutputWriter()
+: fOutputMessenger(nullptr),
+  fEnabled(false), fActive(false), fWriteNtuples(true), fMergeNtuples(true), fQueueSize(1024),
+  fFormat(kGzip), fValueSize(4),
+  fStop(false), fDropped(0),
+  fFile(nullptr), fHitFile(nullptr), fHits(0), fBytesRaw(0), fBusyTime(0.)
+{
+  fgInstance = this;
+  fOutputMessenger = new OutputMessenger(this);
+}
+
+
+OutputWriter::~OutputWriter()
+{
+  EndOfRun();
+  delete fHitFile;
+  delete fOutputMessenger;
+  fgInstance = nullptr;
+}
+
+
+OutputWriter::ThreadData* OutputWriter::GetThreadData() const
+{
+  G4int id = G4Threading::G4GetThreadId();
+  if (id < 0) id = 0;                                  // sequential mode
+  if (id >= (G4int)fThreads.size()) {
+    fDropped++;
+    return nullptr;
+  }
+  return fThreads[id].get();
+}
+
+
+void OutputWriter::AddRunInfo(G4String key, G4String value)
+{
+  fRunInfo += key + " " + value + "\n";
+}
+
+
+void OutputWriter::BeginOfRun(G4String fileName)
+{
+  if (!fEnabled || fActive) { fRunInfo = ""; return; }
+
+  G4bool opened = false;
+  if (fFormat == kColumnar) {
+    fFileName = fileName + ".hits";
+    G4String text = "column 0 Ekin MeV\ncolumn 1 X cm\ncolumn 2 Y cm\ncolumn 3 time ns\n"
+                    "table 1 N_SD1\ntable 2 g_SD1\ntable 3 N_SD2\ntable 4 g_SD2\n" + fRunInfo;
+    if (!fHitFile) fHitFile = new HitFileWriter;
+    opened = fHitFile->Open(fFileName, fValueSize, text);
+  }
+  else {
+    fFileName = fileName + ".hits.gz";
+    fFile = gzopen(fFileName.c_str(), "wb6");
+    if (fFile) {
+      const char* header = "ColliRotateHits 1\n"
+                           "event:i64 ntuple:i32 Ekin_MeV:f64 X_cm:f64 Y_cm:f64 time_ns:f64\n";
+      gzwrite((gzFile)fFile, header, std::strlen(header));
+      opened = true;
+    }
+  }
+  fRunInfo = "";
+
+  if (!opened) {
+    G4cout << "\n--> warning from OutputWriter::BeginOfRun : can not open " << fFileName
+           << ", no asynchronous output for this run" << G4endl;
+    return;
+  }
+  if (OutputNaming::Instance()) OutputNaming::Instance()->Register("hits", fFileName);
+
+  // one queue per worker thread, created before the workers start
+  G4int nofThreads = std::max(1, G4RunManager::GetRunManager()->GetNumberOfThreads());
+  fThreads.clear();
+  for (G4int i = 0; i < nofThreads; i++) fThreads.emplace_back(new ThreadData(fQueueSize));
+
+  fBuffer.clear();
+  fBuffer.reserve(kChunkSize + kRecordSize);
+  fHits = fBytesRaw = 0;
+  fBusyTime = 0.;
+  fDropped = 0;
+  fStop    = false;
+  fActive  = true;
+
+  fWriterThread = std::thread(&OutputWriter::WriterLoop, this);
+}
+
+
+void OutputWriter::AddHit(G4int ntuple, G4double ekin, G4double x, G4double y, G4double time)
+{
+  ThreadData* data = GetThreadData();
+  if (!data) return;
+
+  data->fEvent.push_back({0, ntuple, ekin, x, y, time});
+}
+
+
+void OutputWriter::EndOfEvent(G4long eventNumber)
+{
+  ThreadData* data = GetThreadData();
+  if (!data) return;
+
+  data->fEvents++;
+  if (data->fEvent.empty()) return;
+
+  for ( auto& hit : data->fEvent ) hit.fEvent = eventNumber;
+
+  if (!data->fQueue.Push(data->fEvent)) {
+    data->fStalls++;
+    while (!data->fQueue.Push(data->fEvent)) std::this_thread::yield();
+  }
+  data->fMaxDepth = std::max(data->fMaxDepth, data->fQueue.Size());
+}
+
+
+void OutputWriter::WriterLoop()
+{
+  while (!fStop.load(std::memory_order_acquire)) {
+    if (!Drain()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // the workers have finished - write what is left
+  while (Drain()) {}
+  Flush();
+}
+
+
+G4bool OutputWriter::Drain()
+{
+  auto start = std::chrono::steady_clock::now();
+  G4bool drained = false;
+  std::vector<HitRecord> event;
+
+  for ( auto& data : fThreads ) {
+    while (data->fQueue.Pop(event)) {
+      drained = true;
+      fHits += event.size();
+      if (fFormat == kColumnar) {
+        for ( const auto& hit : event ) fHitFile->Fill(hit.fNtuple, hit.fEvent, hit.fEkin, hit.fX, hit.fY, hit.fTime);
+        continue;
+      }
+      for ( const auto& hit : event ) {
+        size_t pos = fBuffer.size();
+        fBuffer.resize(pos + kRecordSize);
+        char* p = fBuffer.data() + pos;
+        std::memcpy(p, &hit.fEvent,  sizeof(G4long));   p += sizeof(G4long);
+        std::memcpy(p, &hit.fNtuple, sizeof(G4int));    p += sizeof(G4int);
+        std::memcpy(p, &hit.fEkin,   sizeof(G4double)); p += sizeof(G4double);
+        std::memcpy(p, &hit.fX,      sizeof(G4double)); p += sizeof(G4double);
+        std::memcpy(p, &hit.fY,      sizeof(G4double)); p += sizeof(G4double);
+        std::memcpy(p, &hit.fTime,   sizeof(G4double));
+      }
+      if (fBuffer.size() >= kChunkSize) Flush();
+    }
+  }
+
+  if (drained) fBusyTime += std::chrono::duration<G4double>(std::chrono::steady_clock::now() - start).count();
+  return drained;
+}
+
+
+void OutputWriter::Flush()
+{
+  if (fBuffer.empty() || !fFile) return;
+
+  gzwrite((gzFile)fFile, fBuffer.data(), fBuffer.size());
+  fBytesRaw += fBuffer.size();
+  fBuffer.clear();
+}
+
+
+void OutputWriter::EndOfRun()
+{
+  if (!fActive) return;
+
+  // called by the master after the workers' EndOfRunAction, so no more events are pushed
+  fStop = true;
+  fWriterThread.join();
+  if (fFormat == kColumnar) {
+    fHitFile->Close();
+    fBytesRaw = fHits*(sizeof(G4long) + HitFile::kNbOfColumns*fValueSize);
+  }
+  else {
+    gzclose((gzFile)fFile);
+    fFile = nullptr;
+  }
+  fActive = false;
+
+  std::error_code ec;
+  G4double bytesFile = fs::file_size(fFileName.c_str(), ec);
+  G4double mbRaw     = fBytesRaw/1048576.;
+
+  G4int dfprec = G4cout.precision(3);
+  G4cout << "\n Asynchronous output : " << fFileName << G4endl;
+  G4cout << "  hits = " << fHits << ";  " << mbRaw << " MB raw, "
+         << bytesFile/1048576. << " MB in the file" << G4endl;
+  G4cout << "  writer busy = " << fBusyTime << " s;  throughput = "
+         << (fBusyTime > 0. ? mbRaw/fBusyTime : 0.) << " MB/s" << G4endl;
+  G4cout << "  thread   events   max queue depth   stalls" << G4endl;
+  for (size_t i = 0; i < fThreads.size(); i++) {
+    const ThreadData& data = *fThreads[i];
+    G4cout << "  " << std::setw(6) << i << std::setw(9) << data.fEvents
+           << std::setw(18) << data.fMaxDepth << std::setw(9) << data.fStalls << G4endl;
+  }
+  if (fDropped > 0) {
+    G4cout << "\n--> warning from OutputWriter::EndOfRun : " << fDropped
+           << " hits from threads without a queue were not written" << G4endl;
+  }
+  G4cout.precision(dfprec);
+
+  fThreads.clear();
+}
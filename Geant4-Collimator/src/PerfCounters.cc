@@ -0,0 +1,254 @@
+/*
+Hardware performance counters around the event loop (Linux only). With /custom/perf/enable every thread opens one
+perf_event_open group of four counters - cycles, instructions, cache misses, branch misses - for itself, in user
+space only, when it first needs it. The group is read with one read() call:
+  - per event, from the start of BeginOfEventAction to the start of EndOfEventAction: the whole event loop
+  - per user-action callback, with PerfCounters::Scope at the top of SteppingAction, TrackingAction (pre and post),
+    the SD ProcessHits and EndOfEventAction. Reading costs a system call, so only every n-th callback of each kind is
+    read (/custom/perf/sampling, default 100) and the sums are scaled up to all calls.
+What is left of the event cycles after stepping, tracking and SD callbacks is Geant4: navigation, physics, stacking.
+
+After the run summary the master prints per thread the event counters - a falling IPC and rising cache misses per
+kilo-instruction with more threads point to a memory-bound loop - and per callback the cost per call and the share of
+all cycles. The counters are multiplexed when the PMU is shared; the values are scaled by time enabled / running.
+
+perf_event_open fails in containers and with /proc/sys/kernel/perf_event_paranoid > 2; the counters then stay off
+with a warning.
+*/
+
+#include "PerfCounters.hh"
+#include "PerfMessenger.hh"
+
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  G4Mutex perfCountersMutex = G4MUTEX_INITIALIZER;
+  std::atomic<G4bool> warned(false);
+
+  const char* regionNames[] = { "stepping", "tracking", "sensitive", "endOfEvent" };
+}
+
+PerfCounters* PerfCounters::fgInstance = nullptr;
+G4bool PerfCounters::fgEnabled = false;
+G4int PerfCounters::fgSampling = 100;
+G4ThreadLocal PerfCounters::ThreadData* PerfCounters::fgLocal = nullptr;
+std::vector<std::unique_ptr<PerfCounters::ThreadData>> PerfCounters::fgThreadData;
+
+
+PerfCounters::PerfCounters()
+: fPerfMessenger(nullptr)
+{
+  fgInstance = this;
+  fPerfMessenger = new PerfMessenger(this);
+}
+
+
+PerfCounters::~PerfCounters()
+{
+  delete fPerfMessenger;
+  fgInstance = nullptr;
+}
+
+
+PerfCounters::ThreadData::~ThreadData()
+{
+#ifdef __linux__
+  for ( G4int fd : fFd ) if (fd >= 0) close(fd);
+#endif
+}
+
+
+void PerfCounters::Sum::Add(const Sum& other)
+{
+  for (G4int i = 0; i < kNbOfCounters; i++) fValue[i] += other.fValue[i];
+  fCalls   += other.fCalls;
+  fSampled += other.fSampled;
+}
+
+
+PerfCounters::ThreadData& PerfCounters::Register()
+{
+  auto data = std::make_unique<ThreadData>();
+  data->fThread = G4Threading::G4GetThreadId();
+  data->fOpen   = Open(*data);       // counts this thread from now on
+
+  G4AutoLock lock(&perfCountersMutex);
+  fgLocal = data.get();
+  fgThreadData.push_back(std::move(data));
+  return *fgLocal;
+}
+
+
+G4bool PerfCounters::Open(ThreadData& data)
+{
+#ifdef __linux__
+  const unsigned long long configs[kNbOfCounters] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+  for (G4int i = 0; i < kNbOfCounters; i++) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = configs[i];
+    attr.disabled       = (i == 0);              // the group starts with its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // this thread, any CPU
+    data.fFd[i] = (G4int)syscall(SYS_perf_event_open, &attr, 0, -1, (i == 0) ? -1 : data.fFd[0], 0);
+    if (data.fFd[i] < 0) {
+      if (!warned.exchange(true))
+        G4cout << "\n--> warning from PerfCounters : perf_event_open failed (" << std::strerror(errno)
+               << "), no hardware counters - see /proc/sys/kernel/perf_event_paranoid" << G4endl;
+      return false;
+    }
+  }
+  ioctl(data.fFd[0], PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+  ioctl(data.fFd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+#else
+  (void)data;
+  if (!warned.exchange(true))
+    G4cout << "\n--> warning from PerfCounters : hardware counters only on Linux" << G4endl;
+  return false;
+#endif
+}
+
+
+G4bool PerfCounters::Read(const ThreadData& data, G4double* values)
+{
+#ifdef __linux__
+  // PERF_FORMAT_GROUP: nr, time enabled, time running, the values in the order of opening
+  unsigned long long buffer[3 + kNbOfCounters];
+  if (read(data.fFd[0], buffer, sizeof(buffer)) != (ssize_t)sizeof(buffer)) return false;
+  G4double scale = (buffer[2] > 0) ? (G4double)buffer[1]/buffer[2] : 0.;
+  for (G4int i = 0; i < kNbOfCounters; i++) values[i] = buffer[3 + i]*scale;
+  return true;
+#else
+  (void)data; (void)values;
+  return false;
+#endif
+}
+
+
+G4bool PerfCounters::Start(Region region)
+{
+  ThreadData& data = Local();
+  if (!data.fOpen) return false;
+  if (++data.fRegions[region].fCalls % fgSampling != 0) return false;
+  return Read(data, data.fStart[region]);
+}
+
+
+void PerfCounters::Stop(Region region)
+{
+  ThreadData& data = *fgLocal;
+  G4double now[kNbOfCounters];
+  if (!Read(data, now)) return;
+
+  Sum& sum = data.fRegions[region];
+  for (G4int i = 0; i < kNbOfCounters; i++) sum.fValue[i] += now[i] - data.fStart[region][i];
+  sum.fSampled++;
+}
+
+
+void PerfCounters::BeginOfEvent()
+{
+  if (!fgEnabled) return;
+  ThreadData& data = Local();
+  if (data.fOpen) Read(data, data.fStart[kNbOfRegions]);
+}
+
+
+void PerfCounters::EndOfEvent()
+{
+  if (!fgEnabled) return;
+  ThreadData& data = Local();
+  G4double now[kNbOfCounters];
+  if (!data.fOpen || !Read(data, now)) return;
+
+  for (G4int i = 0; i < kNbOfCounters; i++) data.fEvents.fValue[i] += now[i] - data.fStart[kNbOfRegions][i];
+  data.fEvents.fCalls++;
+  data.fEvents.fSampled++;
+}
+
+
+void PerfCounters::BeginOfRun()
+{
+  // before the workers start: no thread is counting
+  G4AutoLock lock(&perfCountersMutex);
+  for ( auto& data : fgThreadData ) {
+    data->fEvents = Sum();
+    for ( auto& region : data->fRegions ) region = Sum();
+  }
+}
+
+
+void PerfCounters::Print(const G4String& label, const Sum& sum, G4double callsPerEvent, G4double allCycles)
+{
+  G4double instructions = sum.PerCall(1);
+  G4double kiloInstr    = (instructions > 0.) ? instructions*1.e-3 : 1.;
+  G4cout << " " << std::left << std::setw(12) << label << std::right
+         << std::setw(11) << callsPerEvent
+         << std::setw(13) << sum.PerCall(0)*1.e-3
+         << std::setw(8)  << (sum.PerCall(0) > 0. ? instructions/sum.PerCall(0) : 0.)
+         << std::setw(12) << sum.PerCall(2)/kiloInstr
+         << std::setw(12) << sum.PerCall(3)/kiloInstr
+         << std::setw(9)  << (allCycles > 0. ? 100.*sum.PerCall(0)*sum.fCalls/allCycles : 0.) << G4endl;
+}
+
+
+void PerfCounters::EndOfRun() const
+{
+  if (!fgEnabled) return;
+
+  G4AutoLock lock(&perfCountersMutex);
+  Sum events, regions[kNbOfRegions];
+  for ( const auto& data : fgThreadData ) {
+    events.Add(data->fEvents);
+    for (G4int r = 0; r < kNbOfRegions; r++) regions[r].Add(data->fRegions[r]);
+  }
+  if (events.fSampled == 0) return;
+
+  // all cycles: the events and the end-of-event actions after them
+  G4double allCycles = events.fValue[0] + regions[kEventAction].PerCall(0)*regions[kEventAction].fCalls;
+  G4double nbOfEvents = (G4double)events.fCalls;
+
+  G4int dfprec = G4cout.precision(3);
+  G4cout << "\n ===================== Hardware counters ====================="
+         << "\n per event      events   kcycles/ev     IPC  cmiss/kins  bmiss/kins  % cycles" << G4endl;
+  for ( const auto& data : fgThreadData ) {
+    if (data->fEvents.fSampled == 0) continue;
+    Print((data->fThread < 0) ? G4String("master") : G4String("thread " + std::to_string(data->fThread)),
+          data->fEvents, (G4double)data->fEvents.fCalls, allCycles);
+  }
+  Print("all", events, nbOfEvents, allCycles);
+
+  // callbacks, scaled from the sampled calls to all calls; the rest of the event is Geant4
+  G4cout << "\n per callback  calls/ev  kcycles/call     IPC  cmiss/kins  bmiss/kins  % cycles" << G4endl;
+  Sum geant4 = events;
+  for (G4int r = 0; r < kNbOfRegions; r++) {
+    if (regions[r].fCalls == 0) continue;
+    Print(regionNames[r], regions[r], regions[r].fCalls/nbOfEvents, allCycles);
+    if (r == kEventAction || regions[r].fSampled == 0) continue;
+    for (G4int i = 0; i < kNbOfCounters; i++) geant4.fValue[i] -= regions[r].PerCall(i)*regions[r].fCalls;
+  }
+  Print("Geant4", geant4, 1., allCycles);
+  G4cout << " (sampled 1/" << fgSampling << " callbacks)"
+         << "\n =============================================================" << G4endl;
+  G4cout.precision(dfprec);
+}
@@ -0,0 +1,54 @@
+/*
+Commands for the hardware performance counters - see PerfCounters.cc
+*/
+
+#include "PerfMessenger.hh"
+
+#include "PerfCounters.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+
+
+PerfMessenger::PerfMessenger(PerfCounters* counters)
+:G4UImessenger(),
+ fPerfCounters(counters), fPerfDir(nullptr),
+ fEnableCmd(nullptr), fSamplingCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fPerfDir = new G4UIdirectory("/custom/perf/",broadcast);
+  fPerfDir->SetGuidance("Hardware performance counters per event and per user-action callback (Linux perf_event_open).");
+
+  // Counters on/off
+  fEnableCmd = new G4UIcmdWithABool("/custom/perf/enable",this);
+  fEnableCmd->SetGuidance("Read cycles, instructions, cache and branch misses and print them after the run summary");
+  fEnableCmd->SetGuidance("(default false)");
+  fEnableCmd->SetParameterName("flag",true);
+  fEnableCmd->SetDefaultValue(true);
+  fEnableCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Sampling of the callbacks
+  fSamplingCmd = new G4UIcmdWithAnInteger("/custom/perf/sampling",this);
+  fSamplingCmd->SetGuidance("Read the counters around every n-th callback of each kind (default 100, 1 = every call)");
+  fSamplingCmd->SetParameterName("n",false);
+  fSamplingCmd->SetRange("n>=1");
+  fSamplingCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+}
+
+
+PerfMessenger::~PerfMessenger()
+{
+  delete fEnableCmd;
+  delete fSamplingCmd;
+  delete fPerfDir;
+}
+
+
+void PerfMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fEnableCmd )
+   { fPerfCounters->SetEnabled(fEnableCmd->GetNewBoolValue(newValue));}
+
+  if( command == fSamplingCmd )
+   { fPerfCounters->SetSampling(fSamplingCmd->GetNewIntValue(newValue));}
+}
@@ -13,6 +13,8 @@ Comment it more
 #include "G4GeneralParticleSource.hh"     //Necessary if you want to use the GeneralParticleSource
 
 #include "DetectorConstruction.hh"
+#include "RunControl.hh"
+#include "EventWatchdog.hh"
 #include "Randomize.hh"
 
 //
@@ -50,5 +52,13 @@ PrimaryGeneratorAction::~PrimaryGeneratorAction()
 
 void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
 {
+  // segmented runs seed every event from the global event number - see RunControl.cc
+  RunControl* runControl = RunControl::Instance();
+  if (runControl && runControl->IsActive()) runControl->SeedEvent(anEvent->GetEventID());
+
+  // engine state for the replay of slow events - see EventWatchdog.cc
+  EventWatchdog* watchdog = EventWatchdog::Instance();
+  if (watchdog) watchdog->BeginOfEvent(anEvent);
+
   fParticleBeam->GeneratePrimaryVertex(anEvent);
 }
\ No newline at end of file
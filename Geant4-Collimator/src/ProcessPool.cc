@@ -0,0 +1,226 @@
+/*
+Pre-fork pool for running several macro variants. Separate ColliRotate processes each load the geometry and the
+HP cross-section data again - minutes and about a GB per process. Here the setup macro (geometry, physics,
+/run/initialize) runs once, a run of 0 events builds the physics tables, and then every job is a fork() of that
+process: the tables are shared copy-on-write, only the pages a job writes to are copied.
+
+The pool runs the sequential run manager (see ColliRotate.cc): fork() only keeps the calling thread, so the
+processes take the place of the worker threads. Every job gets the tag <tag>_w<i>, so its output files, seeds and
+manifest are its own (Output/Runs/<tag>_w<i>/, with the output of the job in log.txt).
+
+While the jobs run, the pool samples /proc/<pid>/smaps_rollup and reports at the end
+  - the setup time, paid once instead of once per process, and the time of the fork() itself
+  - per job: peak RSS, peak PSS (shared pages divided among the sharing processes) and private memory
+  - the peak PSS of parent and jobs together, against N independent processes (setup RSS + private memory each)
+*/
+
+#include "ProcessPool.hh"
+#include "OutputNaming.hh"
+
+#include "G4RunManager.hh"
+#include "G4StateManager.hh"
+#include "G4UImanager.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+
+ProcessPool::ProcessPool(G4int maxJobs)
+: fMaxJobs(maxJobs), fStart(std::chrono::steady_clock::now())
+{ }
+
+
+ProcessPool::~ProcessPool()
+{ }
+
+
+void ProcessPool::AddJob(G4String spec)
+{
+  Job job;
+  std::size_t colon = spec.find(':');
+  job.fMacro = spec.substr(0, colon);
+
+  // parameter set: /control/alias for each name=value, used as {name} in the macro
+  if (colon != std::string::npos) {
+    std::istringstream is(spec.substr(colon + 1));
+    std::string alias;
+    while (std::getline(is, alias, ',')) {
+      std::size_t equal = alias.find('=');
+      if (equal == std::string::npos) continue;
+      job.fAliases.push_back({ alias.substr(0, equal), alias.substr(equal + 1) });
+    }
+  }
+  fJobs.push_back(job);
+}
+
+
+G4int ProcessPool::Run()
+{
+  if (fJobs.empty()) return 0;
+
+  if (G4StateManager::GetStateManager()->GetCurrentState() != G4State_Idle) {
+    G4Exception("ProcessPool::Run()", "ProcessPool001", JustWarning,
+                "The setup macro has to initialize the run manager (/run/initialize) - no jobs started.");
+    return fJobs.size();
+  }
+
+  // build the physics tables in the parent, so the jobs inherit them
+  G4RunManager::GetRunManager()->BeamOn(0);
+  G4double setupTime = std::chrono::duration<G4double>(std::chrono::steady_clock::now() - fStart).count();
+  Memory setup = ReadMemory(getpid());
+
+  // the jobs' tags are derived from this one
+  OutputNaming::Instance()->GetTag();
+  G4cout << "\n Process pool: setup done after " << setupTime << " s, starting " << fJobs.size() << " jobs" << G4endl;
+  std::cout.flush();
+
+  G4int maxJobs = (fMaxJobs > 0) ? fMaxJobs : (G4int)fJobs.size();
+  G4int next = 0, running = 0;
+  long peakPss = 0;
+  while (next < (G4int)fJobs.size() || running > 0) {
+    while (running < maxJobs && next < (G4int)fJobs.size()) {
+      // a job whose fork failed is finished, with status 127
+      if (StartJob(next++)) running++;
+    }
+
+    // memory of parent and running jobs together
+    long pss = ReadMemory(getpid()).fPss;
+    for ( auto& job : fJobs ) {
+      if (job.fPid == 0 || job.fStatus >= 0) continue;
+      Memory memory = ReadMemory(job.fPid);
+      job.fPeak.fRss     = std::max(job.fPeak.fRss,     memory.fRss);
+      job.fPeak.fPss     = std::max(job.fPeak.fPss,     memory.fPss);
+      job.fPeak.fPrivate = std::max(job.fPeak.fPrivate, memory.fPrivate);
+      pss += memory.fPss;
+    }
+    peakPss = std::max(peakPss, pss);
+
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+      for ( auto& job : fJobs ) {
+        if (job.fPid != pid) continue;
+        job.fStatus   = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        job.fWallTime = std::chrono::duration<G4double>(std::chrono::steady_clock::now() - job.fStart).count();
+        running--;
+      }
+    }
+    if (running > 0) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+
+  Report(setupTime, setup, peakPss);
+
+  G4int failed = 0;
+  for ( const auto& job : fJobs ) if (job.fStatus != 0) failed++;
+  return failed;
+}
+
+
+G4bool ProcessPool::StartJob(G4int index)
+{
+  Job& job = fJobs[index];
+  job.fStart = std::chrono::steady_clock::now();
+
+  pid_t pid = fork();
+  if (pid == 0) RunJob(index);
+
+  job.fForkTime = std::chrono::duration<G4double,std::milli>(std::chrono::steady_clock::now() - job.fStart).count();
+  if (pid < 0) {
+    G4cout << "\n--> warning from ProcessPool : fork failed for " << job.fMacro << " (" << std::strerror(errno) << ")" << G4endl;
+    job.fStatus = 127;
+    return false;
+  }
+  job.fPid = pid;
+  G4cout << " job " << index << " (" << job.fMacro << ") started, pid " << pid << G4endl;
+  return true;
+}
+
+
+void ProcessPool::RunJob(G4int index)
+{
+  const Job& job = fJobs[index];
+
+  // own tag and run folder, the output of the job goes to its log file
+  OutputNaming* naming = OutputNaming::Instance();
+  naming->SetWorker(index);
+  G4String log = naming->GetRunFolder() + "/log.txt";
+  std::cout.flush();
+  int fd = ::open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    ::dup2(fd, STDOUT_FILENO);
+    ::dup2(fd, STDERR_FILENO);
+    ::close(fd);
+  }
+  naming->Register("log", log);
+
+  G4UImanager* UImanager = G4UImanager::GetUIpointer();
+  for ( const auto& alias : job.fAliases ) {
+    UImanager->ApplyCommand("/control/alias " + alias.first + " " + alias.second);
+  }
+  G4int status = UImanager->ApplyCommand("/control/execute " + job.fMacro);
+
+  // no destructors: the run manager and the tables belong to the parent
+  std::cout.flush();
+  std::cerr.flush();
+  std::fflush(nullptr);
+  _exit(status == 0 ? 0 : 1);
+}
+
+
+ProcessPool::Memory ProcessPool::ReadMemory(pid_t pid)
+{
+  Memory memory;
+  std::ifstream in("/proc/" + std::to_string(pid) + "/smaps_rollup");
+  std::string line;
+  while (std::getline(in, line)) {
+    // "Rss:   123456 kB", after the address range line
+    std::istringstream is(line);
+    std::string key;
+    long value = 0;
+    if (!(is >> key >> value)) continue;
+    if      (key == "Rss:")           memory.fRss = value;
+    else if (key == "Pss:")           memory.fPss = value;
+    else if (key == "Private_Clean:") memory.fPrivate += value;
+    else if (key == "Private_Dirty:") memory.fPrivate += value;
+  }
+  return memory;
+}
+
+
+void ProcessPool::Report(G4double setupTime, const Memory& setup, long peakPss) const
+{
+  G4int dfprec = G4cout.precision(4);
+  auto MB = [](long kB) { return kB/1024.; };
+
+  G4cout << "\n ======================== Process pool ========================"
+         << "\n setup (geometry, physics tables): " << setupTime << " s, RSS " << MB(setup.fRss) << " MB"
+         << "\n\n job  status  wall [s]  fork [ms]  peak RSS [MB]  peak PSS [MB]  private [MB]  macro" << G4endl;
+
+  long independent = 0;
+  for (std::size_t i = 0; i < fJobs.size(); i++) {
+    const Job& job = fJobs[i];
+    G4cout << std::setw(4)  << i << std::setw(8) << job.fStatus
+           << std::setw(10) << job.fWallTime << std::setw(11) << job.fForkTime
+           << std::setw(15) << MB(job.fPeak.fRss) << std::setw(15) << MB(job.fPeak.fPss)
+           << std::setw(14) << MB(job.fPeak.fPrivate) << "  " << job.fMacro << G4endl;
+    independent += setup.fRss + job.fPeak.fPrivate;
+  }
+
+  // an independent process would hold its own copy of everything the setup allocated
+  G4cout << "\n peak memory of the pool (PSS of parent and jobs): " << MB(peakPss) << " MB"
+         << "\n " << fJobs.size() << " independent processes (estimated):       " << MB(independent) << " MB"
+         << "\n setup time: " << setupTime << " s once, instead of " << setupTime*fJobs.size() << " s of "
+         << fJobs.size() << " independent processes"
+         << "\n ==============================================================" << G4endl;
+  G4cout.precision(dfprec);
+}
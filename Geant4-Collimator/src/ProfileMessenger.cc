@@ -0,0 +1,54 @@
+/*
+Commands for the step profiler - see StepProfiler.cc
+*/
+
+#include "ProfileMessenger.hh"
+
+#include "StepProfiler.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+
+
+ProfileMessenger::ProfileMessenger(StepProfiler* profiler)
+:G4UImessenger(),
+ fStepProfiler(profiler), fProfileDir(nullptr),
+ fEnableCmd(nullptr), fSamplingCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fProfileDir = new G4UIdirectory("/custom/profile/",broadcast);
+  fProfileDir->SetGuidance("Steps and sampled CPU time per volume, particle and process.");
+
+  // Profiler on/off
+  fEnableCmd = new G4UIcmdWithABool("/custom/profile/enable",this);
+  fEnableCmd->SetGuidance("Profile the steps and write Output/Profile/StepProfile_<tag>_r<run>.csv at the end of the run");
+  fEnableCmd->SetGuidance("(default false)");
+  fEnableCmd->SetParameterName("flag",true);
+  fEnableCmd->SetDefaultValue(true);
+  fEnableCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Sampling period
+  fSamplingCmd = new G4UIcmdWithAnInteger("/custom/profile/sampling",this);
+  fSamplingCmd->SetGuidance("Read the CPU time around every n-th step (default 64, 1 = every step)");
+  fSamplingCmd->SetParameterName("n",false);
+  fSamplingCmd->SetRange("n>=1");
+  fSamplingCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+}
+
+
+ProfileMessenger::~ProfileMessenger()
+{
+  delete fEnableCmd;
+  delete fSamplingCmd;
+  delete fProfileDir;
+}
+
+
+void ProfileMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fEnableCmd )
+   { fStepProfiler->SetEnabled(fEnableCmd->GetNewBoolValue(newValue));}
+
+  if( command == fSamplingCmd )
+   { fStepProfiler->SetSampling(fSamplingCmd->GetNewIntValue(newValue));}
+}
@@ -0,0 +1,122 @@
+/*
+Commands for the binary step recorder - see StepRecorder.cc
+*/
+
+#include "RecorderMessenger.hh"
+
+#include "StepRecorder.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcommand.hh"
+#include "G4UIparameter.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithAString.hh"
+
+#include <sstream>
+
+
+RecorderMessenger::RecorderMessenger(StepRecorder* recorder)
+:G4UImessenger(),
+ fStepRecorder(recorder), fRecordDir(nullptr),
+ fEnableCmd(nullptr), fEventsCmd(nullptr), fParticleCmd(nullptr), fVolumeCmd(nullptr),
+ fEnergyCmd(nullptr), fCompressionCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fRecordDir = new G4UIdirectory("/custom/record/",broadcast);
+  fRecordDir->SetGuidance("Binary step records per thread (Output/StepTrace/*.steps.gz), printed with StepPrint.");
+
+  // Recorder on/off
+  fEnableCmd = new G4UIcmdWithABool("/custom/record/enable",this);
+  fEnableCmd->SetGuidance("Record the steps which pass the filters (default false)");
+  fEnableCmd->SetParameterName("flag",true);
+  fEnableCmd->SetDefaultValue(true);
+  fEnableCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Event range
+  fEventsCmd = new G4UIcommand("/custom/record/events",this);
+  fEventsCmd->SetGuidance("Record the events first..last (global event numbers, last -1 = no limit)");
+  G4UIparameter* firstPrm = new G4UIparameter("first",'i',false);
+  firstPrm->SetParameterRange("first>=0");
+  fEventsCmd->SetParameter(firstPrm);
+  G4UIparameter* lastPrm = new G4UIparameter("last",'i',true);
+  lastPrm->SetDefaultValue(-1);
+  fEventsCmd->SetParameter(lastPrm);
+  fEventsCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Particle filter
+  fParticleCmd = new G4UIcmdWithAString("/custom/record/particle",this);
+  fParticleCmd->SetGuidance("Record only this particle - repeat the command for more, \"all\" clears the filter");
+  fParticleCmd->SetParameterName("name",false);
+  fParticleCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Volume filter
+  fVolumeCmd = new G4UIcmdWithAString("/custom/record/volume",this);
+  fVolumeCmd->SetGuidance("Record only steps in this logical volume - repeat the command for more, \"all\" clears");
+  fVolumeCmd->SetParameterName("name",false);
+  fVolumeCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Energy filter
+  fEnergyCmd = new G4UIcommand("/custom/record/energy",this);
+  fEnergyCmd->SetGuidance("Record only steps starting with a kinetic energy in [min, max] (max 0 = no limit)");
+  G4UIparameter* minPrm = new G4UIparameter("min",'d',false);
+  minPrm->SetParameterRange("min>=0.");
+  fEnergyCmd->SetParameter(minPrm);
+  G4UIparameter* maxPrm = new G4UIparameter("max",'d',false);
+  maxPrm->SetParameterRange("max>=0.");
+  fEnergyCmd->SetParameter(maxPrm);
+  G4UIparameter* unitPrm = new G4UIparameter("unit",'s',true);
+  unitPrm->SetDefaultUnit("MeV");
+  fEnergyCmd->SetParameter(unitPrm);
+  fEnergyCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // zlib level
+  fCompressionCmd = new G4UIcmdWithAnInteger("/custom/record/compression",this);
+  fCompressionCmd->SetGuidance("zlib compression level of the step files (default 1: fast)");
+  fCompressionCmd->SetParameterName("level",false);
+  fCompressionCmd->SetRange("level>=0 && level<=9");
+  fCompressionCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+}
+
+
+RecorderMessenger::~RecorderMessenger()
+{
+  delete fEnableCmd;
+  delete fEventsCmd;
+  delete fParticleCmd;
+  delete fVolumeCmd;
+  delete fEnergyCmd;
+  delete fCompressionCmd;
+  delete fRecordDir;
+}
+
+
+void RecorderMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fEnableCmd )
+   { fStepRecorder->SetEnabled(fEnableCmd->GetNewBoolValue(newValue));}
+
+  if( command == fEventsCmd ) {
+    G4long first = 0, last = -1;
+    std::istringstream is(newValue);
+    is >> first >> last;
+    fStepRecorder->SetEvents(first, last);
+  }
+
+  if( command == fParticleCmd )
+   { fStepRecorder->AddParticle(newValue);}
+
+  if( command == fVolumeCmd )
+   { fStepRecorder->AddVolume(newValue);}
+
+  if( command == fEnergyCmd ) {
+    G4double eMin = 0., eMax = 0.;
+    G4String unit = "MeV";
+    std::istringstream is(newValue);
+    is >> eMin >> eMax >> unit;
+    G4double scale = G4UIcommand::ValueOf(unit);
+    fStepRecorder->SetEnergyRange(eMin*scale, eMax*scale);
+  }
+
+  if( command == fCompressionCmd )
+   { fStepRecorder->SetCompression(fCompressionCmd->GetNewIntValue(newValue));}
+}
@@ -2,6 +2,8 @@
 #include "DetectorConstruction.hh"
 #include "PrimaryGeneratorAction.hh"
 #include "Analysis.hh"
+#include "TrackKiller.hh"
+#include "OutputNaming.hh"
 
 #include "G4Threading.hh"
 #include "G4AutoLock.hh"
@@ -9,6 +11,7 @@
 #include "G4SystemOfUnits.hh"
 
 #include <filesystem>
+#include <limits>
 namespace fs = std::filesystem;
 
 // get folderName from where it is defined (RunAction.cc) - the really dirty way 
@@ -37,10 +40,11 @@ G4int Run::fgIonId = kMaxHisto1;
 
 Run::Run(DetectorConstruction* det)
 : G4Run(),
-  fDetector(det), fParticle(nullptr), fEkin(0.)
+  fDetector(det), fParticle(nullptr), fEkin(0.), fNbOfChainedEvents(0)
 {
   fEnergyDeposit = fEnergyDeposit2 = 0.;
   fEnergyFlow    = fEnergyFlow2    = 0.;
+  for (G4int i = 0; i < kNbOfTallies; i++) fTallies[i] = 0;
 }
 
 
@@ -86,7 +90,7 @@ void Run::SetPrimary(G4ParticleDefinition* particle, G4double energy)
 void Run::CountProcesses(const G4VProcess* process) 
 {
   G4String procName = process->GetProcessName();
-  std::map<G4String,G4int>::iterator it = fProcCounter.find(procName);
+  std::map<G4String,G4long>::iterator it = fProcCounter.find(procName);
   if ( it == fProcCounter.end()) {
     fProcCounter[procName] = 1;
   }
@@ -148,6 +152,14 @@ void Run::ParticleFlux(G4String name, G4double Ekin)
   }   
 }
 
+void Run::CountKilledTrack(G4String name, G4int reason, G4double Ekin)
+{
+  KilledData& data = fKilledDataMap[name];
+  if (reason == TrackKiller::kTimeLimit) data.fTimeKills++;
+  else                                   data.fEnergyKills++;
+  data.fEkinSum += Ekin;
+}
+
 G4int Run::GetIonId(G4String ionName)
 {
    G4AutoLock lock(&ionIdMapMutex);
@@ -164,8 +176,24 @@ G4int Run::GetIonId(G4String ionName)
 
 void Run::Merge(const G4Run* run)
 {
-  const Run* localRun = static_cast<const Run*>(run);
+  MergeSums(static_cast<const Run*>(run));
   
+  G4Run::Merge(run); 
+} 
+
+
+//Accumulate a finished segment of a chained run - see RunControl.cc
+//The events go to the 64 bit counter, numberOfEvent of G4Run would overflow after 2^31 events.
+void Run::MergeSegment(const Run* run)
+{
+  MergeSums(run);
+
+  fNbOfChainedEvents += run->GetNbOfEvents();
+}
+
+
+void Run::MergeSums(const Run* localRun)
+{
   //primary particle info
   //
   fParticle = localRun->fParticle;
@@ -177,11 +205,12 @@ void Run::Merge(const G4Run* run)
   fEnergyDeposit2  += localRun->fEnergyDeposit2;
   fEnergyFlow      += localRun->fEnergyFlow;
   fEnergyFlow2     += localRun->fEnergyFlow2;
+  for (G4int i = 0; i < kNbOfTallies; i++) fTallies[i] += localRun->fTallies[i];
       
   //map: processes count
   for ( const auto& procCounter : localRun->fProcCounter ) {
     G4String procName = procCounter.first;
-    G4int localCount = procCounter.second;
+    G4long localCount = procCounter.second;
     if ( fProcCounter.find(procName) == fProcCounter.end()) {
       fProcCounter[procName] = localCount;
     }
@@ -195,9 +224,85 @@ void Run::Merge(const G4Run* run)
   
   //map: particles flux count       
   Merge(fParticleDataMap2, localRun->fParticleDataMap2);    
-  
-  G4Run::Merge(run); 
-} 
+
+  //map: killed tracks count
+  for ( const auto& killedData : localRun->fKilledDataMap ) {
+    KilledData& data = fKilledDataMap[killedData.first];
+    data.fTimeKills   += killedData.second.fTimeKills;
+    data.fEnergyKills += killedData.second.fEnergyKills;
+    data.fEkinSum     += killedData.second.fEkinSum;
+  }
+}
+
+
+//Write all accumulators as plain text. Doubles get full precision, so a restored run is bit-identical.
+void Run::WriteState(std::ostream& out) const
+{
+  G4int dfprec = out.precision(std::numeric_limits<G4double>::max_digits10);
+
+  out << "events " << GetNbOfEvents() << "\n";
+  out << "edep "   << fEnergyDeposit << " " << fEnergyDeposit2 << "\n";
+  out << "eflow "  << fEnergyFlow    << " " << fEnergyFlow2    << "\n";
+  out << "tallies";
+  for (G4int i = 0; i < kNbOfTallies; i++) out << " " << fTallies[i];
+  out << "\n";
+
+  for ( const auto& procCounter : fProcCounter ) {
+    out << "process " << procCounter.first << " " << procCounter.second << "\n";
+  }
+  for ( const auto& particleData : fParticleDataMap1 ) {
+    const ParticleData& data = particleData.second;
+    out << "created " << particleData.first << " " << data.fCount << " " << data.fEmean
+        << " " << data.fEmin << " " << data.fEmax << " " << data.fTmean << "\n";
+  }
+  for ( const auto& particleData : fParticleDataMap2 ) {
+    const ParticleData& data = particleData.second;
+    out << "flux " << particleData.first << " " << data.fCount << " " << data.fEmean
+        << " " << data.fEmin << " " << data.fEmax << " " << data.fTmean << "\n";
+  }
+  for ( const auto& killedData : fKilledDataMap ) {
+    const KilledData& data = killedData.second;
+    out << "killed " << killedData.first << " " << data.fTimeKills << " "
+        << data.fEnergyKills << " " << data.fEkinSum << "\n";
+  }
+  out << "endrun\n";
+
+  out.precision(dfprec);
+}
+
+
+G4bool Run::ReadState(std::istream& in)
+{
+  G4String key;
+  while (in >> key) {
+    if (key == "endrun") return true;
+
+    if      (key == "events") { in >> fNbOfChainedEvents; numberOfEvent = 0; }
+    else if (key == "edep")   in >> fEnergyDeposit >> fEnergyDeposit2;
+    else if (key == "eflow")  in >> fEnergyFlow    >> fEnergyFlow2;
+    else if (key == "tallies") {
+      for (G4int i = 0; i < kNbOfTallies; i++) in >> fTallies[i];
+    }
+    else if (key == "process") {
+      G4String name; G4long count;
+      in >> name >> count;
+      fProcCounter[name] = count;
+    }
+    else if (key == "created" || key == "flux") {
+      G4String name; ParticleData data;
+      in >> name >> data.fCount >> data.fEmean >> data.fEmin >> data.fEmax >> data.fTmean;
+      if (key == "created") fParticleDataMap1[name] = data;
+      else                  fParticleDataMap2[name] = data;
+    }
+    else if (key == "killed") {
+      G4String name; KilledData data;
+      in >> name >> data.fTimeKills >> data.fEnergyKills >> data.fEkinSum;
+      fKilledDataMap[name] = data;
+    }
+    else return false;
+  }
+  return false;
+}
 
 
 void Run::EndOfRun() 
@@ -211,14 +316,15 @@ void Run::EndOfRun()
   G4double density = material->GetDensity();
    
   G4String Particle = fParticle->GetParticleName();    
-  G4cout << "\n The run is " << numberOfEvent << " "<< Particle 
+  G4long TotNbofEvents = GetNbOfEvents();
+  G4cout << "\n The run is " << TotNbofEvents << " "<< Particle 
          //<< " of " << G4BestUnit(fEkin,"Energy") 
          << " through " 
          << G4BestUnit(fDetector->GetAbsorThickness(),"Length") << " of "
          << material->GetName() << " (density: " 
          << G4BestUnit(density,"Volumic Mass") << ")" << G4endl;
 
-  if (numberOfEvent == 0) { G4cout.precision(dfprec);   return;}
+  if (TotNbofEvents == 0) { G4cout.precision(dfprec);   return;}
 
   //frequency of processes
   //
@@ -226,7 +332,7 @@ void Run::EndOfRun()
   G4int index = 0;
   for ( const auto& procCounter : fProcCounter ) {
      G4String procName = procCounter.first;
-     G4int    count    = procCounter.second;
+     G4long   count    = procCounter.second;
      G4String space = " "; if (++index%3 == 0) space = "\n";
      G4cout << " " << std::setw(20) << procName << "="<< std::setw(7) << count
             << space;
@@ -240,7 +346,7 @@ void Run::EndOfRun()
  for ( const auto& particleData : fParticleDataMap1 ) {
     G4String name = particleData.first;
     ParticleData data = particleData.second;
-    G4int count = data.fCount;
+    G4long count = data.fCount;
     G4double eMean = data.fEmean/count;
     G4double eMin = data.fEmin;
     G4double eMax = data.fEmax;
@@ -266,16 +372,12 @@ void Run::EndOfRun()
   fs::create_directory(folderName);
   fs::create_directory(folderName + "/" + ListFolder);
 
-  //Get process ID
-  G4long pid = getpid();
-
-  // Check if "ListOfGeneratedParticles_pid.txt" is already existing; if yes, check if "ListOfGeneratedParticles_pid+1.txt" exists. 
-  while(std::ifstream(folderName + "/" + ListFolder + "/" + "ListOfGeneratedParticles_" + std::to_string(pid) + ".txt"))
-  {
-    pid++;
-  }
-  // Set final file name 
-  std::string fileName = "ListOfGeneratedParticles_" + std::to_string(pid) + ".txt";
+  // Unique name from the tag of this process and the run ID - see OutputNaming.cc
+  // The total of a chained run gets its own suffix - see RunControl.cc
+  OutputNaming* naming = OutputNaming::Instance();
+  std::string fileName = naming->GetFileName("ListOfGeneratedParticles", runID,
+                                             fNbOfChainedEvents > 0 ? "_chain.txt" : ".txt");
+  naming->Register("list", folderName + "/" + ListFolder + "/" + fileName);
 
   // flush output to file
   std::ofstream outFile(folderName + "/" + ListFolder + "/" + fileName);
@@ -286,7 +388,7 @@ void Run::EndOfRun()
  for ( const auto& particleData : fParticleDataMap1 ) {
     G4String name = particleData.first;
     ParticleData data = particleData.second;
-    G4int count = data.fCount;
+    G4long count = data.fCount;
     G4double eMean = data.fEmean/count;
     G4double eMin = data.fEmin;
     G4double eMax = data.fEmax;
@@ -304,7 +406,6 @@ void Run::EndOfRun()
 
   // compute mean Energy deposited and rms
   //
-  G4int TotNbofEvents = numberOfEvent;
   fEnergyDeposit /= TotNbofEvents; fEnergyDeposit2 /= TotNbofEvents;
   G4double rmsEdep = fEnergyDeposit2 - fEnergyDeposit*fEnergyDeposit;
   if (rmsEdep>0.) rmsEdep = std::sqrt(rmsEdep);
@@ -327,6 +428,11 @@ void Run::EndOfRun()
          << G4BestUnit(rmsEflow,   "Energy") 
          << G4endl;
 
+  // hits in the sensitive detectors
+  //
+  G4cout << "\n Hits in SD1 (neutrons) = " << fTallies[kSD1Neutrons]
+         << ";  hits in SD2 (gammas) = " << fTallies[kSD2Gammas] << G4endl;
+
  //particles flux
  //
  G4cout << "\n List of particles emerging from the target :" << G4endl;
@@ -334,7 +440,7 @@ void Run::EndOfRun()
  for ( const auto& particleData : fParticleDataMap2 ) {
     G4String name = particleData.first;
     ParticleData data = particleData.second;
-    G4int count = data.fCount;
+    G4long count = data.fCount;
     G4double eMean = data.fEmean/count;
     G4double eMin = data.fEmin;
     G4double eMax = data.fEmax;
@@ -347,11 +453,29 @@ void Run::EndOfRun()
            << ") \tEflow/event = " << G4BestUnit(Eflow, "Energy") << G4endl;
  }
 
+ //tracks killed by the time and energy limits - see TrackKiller.cc
+ //
+ if (!fKilledDataMap.empty()) {
+   G4cout << "\n List of tracks killed by time/energy limits :" << G4endl;
+
+   for ( const auto& killedData : fKilledDataMap ) {
+      G4String name = killedData.first;
+      KilledData data = killedData.second;
+      G4long count = data.fTimeKills + data.fEnergyKills;
+
+      G4cout << "  " << std::setw(13) << name << ": " << std::setw(7) << count
+             << "  (time: " << data.fTimeKills << ", energy: " << data.fEnergyKills << ")"
+             << "\tEkin lost/event = " << G4BestUnit(data.fEkinSum/TotNbofEvents, "Energy") << G4endl;
+   }
+ }
+
 
   //remove all contents in fProcCounter, fCount 
   fProcCounter.clear();
   fParticleDataMap1.clear();
   fParticleDataMap2.clear();
+  fKilledDataMap.clear();
+  for (G4int i = 0; i < kNbOfTallies; i++) fTallies[i] = 0;
   fgIonMap.clear();
                           
   //restore default format         
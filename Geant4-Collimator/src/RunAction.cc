@@ -7,6 +7,16 @@ Understand what this does and comment it
 #include "DetectorConstruction.hh"
 #include "PrimaryGeneratorAction.hh"
 #include "Analysis.hh"
+#include "TrackKiller.hh"
+#include "RunControl.hh"
+#include "OutputWriter.hh"
+#include "OutputNaming.hh"
+#include "Benchmark.hh"
+#include "LoopCounters.hh"
+#include "StepProfiler.hh"
+#include "PerfCounters.hh"
+#include "Tracer.hh"
+#include "StepRecorder.hh"
 
 #include "G4Run.hh"
 #include "G4UnitsTable.hh"
@@ -17,9 +27,11 @@ Understand what this does and comment it
 
 
 #include "G4RunManager.hh"
+#include "G4Threading.hh"
 #include "G4AccumulableManager.hh"
 #include "G4LogicalVolumeStore.hh"
 #include "G4LogicalVolume.hh"
+#include "G4Material.hh"
 #include <filesystem>
 namespace fs = std::filesystem;
 
@@ -48,10 +60,6 @@ RunAction::RunAction(DetectorConstruction* det, PrimaryGeneratorAction* prim)
   fEdep2(0.)
 {
 
-  //Get process ID
-  G4long pid = getpid();
-  // G4cout << "\n PID is " << pid << G4endl;
-
   // create a folder for the files
   // std::string folderName = "Root Files";
   // std::filesystem::create_directory(folderName);
@@ -69,16 +77,13 @@ RunAction::RunAction(DetectorConstruction* det, PrimaryGeneratorAction* prim)
     //Open output file at the start of the simulation
     //
 
-    // Check if "pid.root" is already existing; if yes, check if "pid+1.root" exists. Output format as root-file is choosen in Analysis.hh 
-    while(std::ifstream(folderName + "/" + RootFolder + "/" + "ID_" + std::to_string(pid) + ".root"))
-    {
-      pid++;
-    }
-    // Set final file name 
-    std::string fileName = "ID_" + std::to_string(pid) + ".root";
+    // Unique name from the tag of this process - see OutputNaming.cc. Output format as root-file is choosen in Analysis.hh 
+    OutputNaming* naming = OutputNaming::Instance();
+    std::string fileName = "ID_" + naming->GetTag() + ".root";
 
     // Create the file
     analysisManager->OpenFile(folderName + "/" + RootFolder + "/" + fileName);
+    if (isMaster) naming->Register("root", folderName + "/" + RootFolder + "/" + fileName);
   }
 
   // add new units for dose
@@ -231,10 +236,16 @@ G4Run* RunAction::GenerateRun()
 }
 
 
-void RunAction::BeginOfRunAction(const G4Run*)
+void RunAction::BeginOfRunAction(const G4Run* run)
 {  
-  //Get process ID
-  G4long pid = getpid(); 
+  Tracer::Span span("BeginOfRunAction");
+  if (Benchmark::Instance()) Benchmark::Instance()->BeginOfRun(isMaster);
+  if (isMaster && LoopCounters::Instance()) LoopCounters::Instance()->BeginOfRun();
+  if (isMaster && StepProfiler::Instance()) StepProfiler::Instance()->BeginOfRun();
+  if (isMaster && PerfCounters::Instance()) PerfCounters::Instance()->BeginOfRun();
+  if (isMaster && StepRecorder::Instance()) StepRecorder::Instance()->BeginOfRun();
+
+  OutputNaming* naming = OutputNaming::Instance();
 
   // create a folder for the files
   // std::string folderName = "Root Files";
@@ -258,17 +269,58 @@ void RunAction::BeginOfRunAction(const G4Run*)
     // Create an output file which increases in number if the simulation is run again
     //
 
-    // Check if "pid.root" is already existing; if yes, check if "pid+1.root" exists. Output format as root-file is choosen in Analysis.hh 
-    while(std::ifstream(folderName + "/" + RootFolder + "/" + "ID_" + std::to_string(pid) + ".root"))
+    std::string fileName;
+    G4bool openFile = true;
+    RunControl* runControl = RunControl::Instance();
+    if (runControl && runControl->IsActive())
     {
-      pid++;
+      // Segmented run: the name only depends on base seed, shard and segment - see RunControl.cc
+      fileName = runControl->GetSegmentFileName();
+      // Single output: the file of the first segment stays open for the whole chain
+      if (runControl->IsSingleOutput() && !runControl->IsFirstSegment()) openFile = false;
+      else if (isMaster) runControl->AddOutputFile(folderName + "/" + RootFolder + "/" + fileName);
     }
-    // Set final file name 
-    std::string fileName = "ID_" + std::to_string(pid) + ".root";
+    else
+    {
+      // ID_<tag>_r<runID>.root - master and workers get the same name without looking at the folder, see OutputNaming.cc
+      // Output format as root-file is choosen in Analysis.hh 
+      fileName = naming->GetFileName("ID", run->GetRunID(), ".root");
+    }
+
+    // without merging every worker writes <fileName>_t<thread>.root - see ColliMerge.cc
+    OutputWriter* outputWriter = OutputWriter::Instance();
+    G4bool mergeNtuples = !outputWriter || outputWriter->MergeNtuples();
+    if (openFile) analysisManager->SetNtupleMerging(mergeNtuples);
 
     // Create the file
     // analysisManager->OpenFile("Folder2/" + fileName);
-    analysisManager->OpenFile(folderName + "/" + RootFolder + "/" + fileName);
+    if (openFile) analysisManager->OpenFile(folderName + "/" + RootFolder + "/" + fileName);
+
+    // list the files in the manifest of this process
+    if (openFile && isMaster) {
+      G4String stem = folderName + "/" + RootFolder + "/" + fs::path(fileName).stem().string();
+      naming->Register("root", stem + ".root");
+      if (!mergeNtuples && G4Threading::IsMultithreadedApplication()) {
+        G4int nofThreads = G4RunManager::GetRunManager()->GetNumberOfThreads();
+        for (G4int i = 0; i < nofThreads; i++) naming->Register("root", stem + "_t" + std::to_string(i) + ".root");
+      }
+    }
+
+    // asynchronous hit output next to the ROOT file - see OutputWriter.cc
+    if (isMaster && outputWriter) {
+      // run parameters and seeds for the header of the columnar files
+      outputWriter->AddRunInfo("runID", std::to_string(run->GetRunID()));
+      outputWriter->AddRunInfo("events", std::to_string(run->GetNumberOfEventToBeProcessed()));
+      outputWriter->AddRunInfo("absorber", fDetector->GetAbsorMaterial()->GetName());
+      outputWriter->AddRunInfo("absorberThickness_cm", std::to_string(fDetector->GetAbsorThickness()/cm));
+      // the seed set below for this run (seed[0]), the engine still has the one of the previous run
+      outputWriter->AddRunInfo("engineSeed", std::to_string(naming->GetSeed(run->GetRunID())));
+      if (runControl && runControl->IsActive()) {
+        outputWriter->AddRunInfo("baseSeed", std::to_string(runControl->GetBaseSeed()));
+        outputWriter->AddRunInfo("eventOffset", std::to_string(runControl->GetEventOffset()));
+      }
+      outputWriter->BeginOfRun(folderName + "/" + RootFolder + "/" + fs::path(fileName).stem().string());
+    }
   }
 
   //
@@ -280,8 +332,9 @@ void RunAction::BeginOfRunAction(const G4Run*)
   // Create seed array
   G4long seed[2];
 
-  seed[0] = (G4long) pid;
-  seed[1] = (G4long) pid;
+  // different for every process and run - replaces the pid of the old file name loop
+  seed[0] = naming->GetSeed(run->GetRunID());
+  seed[1] = seed[0];
 
   // Random seed 
   // G4int seednumber_1 = G4UniformRand() * 2147483646;
@@ -304,6 +357,12 @@ void RunAction::BeginOfRunAction(const G4Run*)
 
   // show Rndm status
   if (isMaster) G4Random::showEngineStatus();
+
+  // resolve the track kill limits once in the master, before the workers start stepping
+  if (isMaster) {
+    fDetector->GetTrackKiller()->Resolve();
+    fDetector->GetTrackKiller()->PrintLimits();
+  }
   
   // keep run condition
   if (fPrimary) { 
@@ -317,24 +376,47 @@ void RunAction::BeginOfRunAction(const G4Run*)
 
 void RunAction::EndOfRunAction(const G4Run* run)
 {
+  Tracer::Span span("EndOfRunAction");
+
+  // the worker leaves its event loop, the rest is merging and output
+  if (Benchmark::Instance()) Benchmark::Instance()->EndOfRun(isMaster, run->GetNumberOfEvent());
+
+  // a chained run with single output closes its file with the last segment
+  RunControl* runControl = RunControl::Instance();
+  G4bool keepFileOpen = runControl && runControl->IsActive()
+                        && runControl->IsSingleOutput() && !runControl->IsLastSegment();
+
   //use this code to create one file per run
-  if(SaveEachRunInSeparateFile == true)
+  if(SaveEachRunInSeparateFile == true && !keepFileOpen)
   {
     //
     //Close the file at the end of a run
     //
     auto analysisManager = G4AnalysisManager::Instance();
-    analysisManager->Write();
-    analysisManager->CloseFile();
+    { Tracer::Span write("Write");         analysisManager->Write(); }
+    { Tracer::Span closeFile("CloseFile"); analysisManager->CloseFile(); }
   }
 
+  // stop the writer thread - the workers have pushed all their events
+  OutputWriter* outputWriter = OutputWriter::Instance();
+  if (isMaster && outputWriter) { Tracer::Span flush("OutputWriter"); outputWriter->EndOfRun(); }
+
+  // every thread closes its step trace - see StepRecorder.cc
+  if (StepRecorder::Instance()) StepRecorder::Instance()->EndOfRun();
+
+  // event-loop counters of all threads
+  if (isMaster && LoopCounters::Instance()) LoopCounters::Instance()->EndOfRun();
+
+  // steps and CPU time per volume, particle and process of all threads
+  if (isMaster && StepProfiler::Instance()) StepProfiler::Instance()->EndOfRun(run->GetRunID());
+
   G4int nofEvents = run->GetNumberOfEvent();
   if (nofEvents == 0) return;
 
   //B1 SCORING METHOD
   // Merge accumulables 
   G4AccumulableManager* accumulableManager = G4AccumulableManager::Instance();
-  accumulableManager->Merge();
+  { Tracer::Span merge("Merge"); accumulableManager->Merge(); }
 
   // Compute dose = total energy deposit in a run and its variance
   G4double edep  = fEdep.GetValue();
@@ -401,7 +483,14 @@ void RunAction::EndOfRunAction(const G4Run* run)
    ;
 
 
+  // Segmented run: the master accumulates the segment and writes the checkpoint. No engine status is saved,
+  // every event is seeded from the base seed and its global number - see RunControl::SeedEvent
+  if (isMaster && runControl && runControl->IsActive()) runControl->EndOfSegment(fRun);
+
   if (isMaster) fRun->EndOfRun();    
+
+  // hardware counters of all threads, next to the run summary - see PerfCounters.cc
+  if (isMaster && PerfCounters::Instance()) PerfCounters::Instance()->EndOfRun();
   
   /*
   //save histograms      
@@ -0,0 +1,486 @@
+/*
+Segmented runs with checkpoints. /custom/run/beamOn N runs N events as a chain of /run/beamOn segments.
+After each segment the master writes a checkpoint (Output/Checkpoint_<tag>/checkpoint.txt) with the accumulated Run,
+the number of finished events, the base seed and the list of output files. /custom/run/resume reads the checkpoint
+and continues with the next segment. No engine status is saved: the events are seeded from the base seed alone.
+The tag is the one of the process which started the chain (see OutputNaming.cc); the process which resumes keeps it
+for the checkpoint and the segment files, and takes the newest checkpoint unless a tag is given.
+
+Every event is seeded from (base seed, global event number) in PrimaryGeneratorAction, so the result does not depend
+on where the run was interrupted or on how the events were distributed over the worker threads.
+
+The segments also lift the 2^31 event limit of /run/beamOn: the total run counts its events in 64 bit, and with
+/custom/run/singleOutput true all segments write into one output file, as if it were one giant run. The file is
+written once, by the last segment (a Write() per segment would merge the ntuples again and add a cycle of every
+histogram each time), so a chain with single output which stopped early can not be resumed: its file holds none of
+the finished segments. A finished chain which is extended by a resume starts a new file.
+
+/custom/run/converge runs segments until the relative statistical errors of the SD1 neutron count, the SD2 gamma
+count and the mean energy deposit are below a target, or until the time budget is used up. The errors are
+batch-means estimates with one batch per segment; a tally which is zero in every batch counts as converged.
+
+Sharding (ColliRotate --shard i/N --seed S): /custom/run/beamOn T runs only the events [T*i/N, T*(i+1)/N) of the
+global event numbering. Since the events are seeded from (base seed, global event number), the shards use
+non-overlapping random streams and together give exactly the run of T events. Each shard writes its accumulated Run
+with a self-describing header to Output/Shards/shard_<i>_of_<N>.txt; ColliMerge combines them.
+*/
+
+#include "RunControl.hh"
+#include "RunMessenger.hh"
+#include "Run.hh"
+#include "DetectorConstruction.hh"
+#include "OutputNaming.hh"
+
+#include "G4RunManager.hh"
+#include "G4Run.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+// get folderName from where it is defined (RunAction.cc) - the really dirty way
+extern std::string folderName;
+
+RunControl* RunControl::fgInstance = nullptr;
+
+
+RunControl::RunControl(DetectorConstruction* det)
+: fDetector(det), fRunMessenger(nullptr),
+  fActive(false), fSegmentSize(100000), fBaseSeed(0),
+  fEventsRequested(0), fEventsDone(0), fSegment(0),
+  fFirstEvent(0), fEventsTotal(0), fShardIndex(0), fNbOfShards(0),
+  fFirstSegment(0), fLastSegment(false), fSingleOutput(false), fChainSingleOutput(false),
+  fConverge(false), fTargetError(0.), fTimeBudget(0.), fElapsed(0.),
+  fTotalRun(nullptr)
+{
+  fgInstance = this;
+  fRunMessenger = new RunMessenger(this);
+}
+
+
+RunControl::~RunControl()
+{
+  delete fRunMessenger;
+  delete fTotalRun;
+  fgInstance = nullptr;
+}
+
+
+G4String RunControl::GetCheckpointFolder() const
+{
+  // jobs and shards may share the output folder
+  G4String folder = folderName + "/Checkpoint";
+  if (!fChainTag.empty()) folder += "_" + fChainTag;
+  if (fNbOfShards > 0)    folder += "_shard" + std::to_string(fShardIndex);
+  return folder;
+}
+
+
+G4String RunControl::GetSegmentFileName() const
+{
+  // only depends on chain tag, base seed, shard and segment, so a resumed segment overwrites its broken file
+  G4String name = "ID_";
+  if (!fChainTag.empty()) name += fChainTag + "_";
+  name += std::to_string(fBaseSeed);
+  if (fNbOfShards > 0) name += "_shard" + std::to_string(fShardIndex);
+  return name + "_" + std::to_string(fSegment) + ".root";
+}
+
+
+G4bool RunControl::FindLastChain()
+{
+  // the newest checkpoint of this shard (or of an unsharded run) in the output folder
+  G4String suffix = (fNbOfShards > 0) ? "_shard" + std::to_string(fShardIndex) : "";
+  G4bool found = false;
+  fs::file_time_type newest;
+
+  std::error_code ec;
+  for ( const auto& entry : fs::directory_iterator(folderName, ec) ) {
+    G4String name = entry.path().filename().string();
+    if (name.rfind("Checkpoint", 0) != 0 || name.size() < 10 + suffix.size()) continue;
+    if (name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+    if (suffix.empty() && name.find("_shard") != std::string::npos) continue;
+
+    // Checkpoint[_<tag>]<suffix>
+    G4String tag = name.substr(10, name.size() - 10 - suffix.size());
+    if (!tag.empty() && tag[0] != '_') continue;
+    if (!tag.empty()) tag = tag.substr(1);
+
+    fs::path checkpoint = entry.path() / "checkpoint.txt";
+    if (!fs::exists(checkpoint, ec)) continue;
+    auto modified = fs::last_write_time(checkpoint, ec);
+    if (!found || modified > newest) {
+      newest    = modified;
+      fChainTag = tag;
+      found     = true;
+    }
+  }
+  return found;
+}
+
+
+void RunControl::SetShard(G4int index, G4int nofShards)
+{
+  if (nofShards < 1 || index < 0 || index >= nofShards) {
+    G4ExceptionDescription msg;
+    msg << "Shard " << index << "/" << nofShards << " is not valid: without sharding every task of the job array"
+        << " would run all events.";
+    G4Exception("RunControl::SetShard()", "RunControl001", FatalException, msg);
+    return;
+  }
+  fShardIndex = index;
+  fNbOfShards = nofShards;
+}
+
+
+void RunControl::BeamOn(G4long nofEvents)
+{
+  // draw the base seed from the master engine unless it was set by /custom/run/setSeed
+  if (fBaseSeed == 0) {
+    if (fNbOfShards > 0) {
+      G4Exception("RunControl::BeamOn()", "RunControl002", JustWarning,
+                  "Sharded run without a global seed (--seed): the shards can not be combined reproducibly.");
+    }
+    fBaseSeed = 1 + (G4long)(G4UniformRand() * 2147483646.);
+  }
+
+  // this shard's slice of the global event numbers
+  fEventsTotal = nofEvents;
+  fFirstEvent  = 0;
+  if (fNbOfShards > 0) {
+    G4long perShard  = nofEvents / fNbOfShards;
+    G4long remainder = nofEvents % fNbOfShards;
+    fFirstEvent = perShard*fShardIndex + std::min<G4long>(fShardIndex, remainder);
+    nofEvents   = perShard + (fShardIndex < remainder ? 1 : 0);
+    G4cout << "\n Shard " << fShardIndex << " of " << fNbOfShards << ": events " << fFirstEvent
+           << " to " << fFirstEvent + nofEvents - 1 << " of " << fEventsTotal << G4endl;
+  }
+
+  // the checkpoint and the segment files carry the tag of this process, so two jobs in one folder do not
+  // overwrite each other - see OutputNaming.cc
+  fChainTag = OutputNaming::Instance() ? OutputNaming::Instance()->GetTag() : G4String();
+
+  delete fTotalRun;
+  fTotalRun = new Run(fDetector);
+  fOutputFiles.clear();
+
+  fEventsRequested = nofEvents;
+  fEventsDone      = 0;
+  fSegment         = 0;
+  fElapsed         = 0.;
+  fBatches.clear();
+
+  RunSegments();
+}
+
+
+void RunControl::BeamOnUntilConverged(G4double relError, G4double timeBudget)
+{
+  if (fNbOfShards > 0) {
+    G4cout << "\n--> warning from RunControl : convergence runs can not be sharded, use /custom/run/beamOn" << G4endl;
+    return;
+  }
+
+  fConverge    = true;
+  fTargetError = relError;
+  fTimeBudget  = timeBudget;
+
+  BeamOn(std::numeric_limits<G4long>::max());
+
+  fConverge = false;
+}
+
+
+void RunControl::Resume(G4long nofEvents, G4String tag)
+{
+  fConverge = false;
+
+  // a new process has a new tag: continue the chain of the given tag, of this process or the newest one
+  if (!tag.empty()) fChainTag = tag;
+  else if (fChainTag.empty() || !fs::exists(GetCheckpointFolder() + "/checkpoint.txt")) FindLastChain();
+
+  if (!ReadCheckpoint()) {
+    G4cout << "\n--> warning from RunControl::Resume : no valid checkpoint in "
+           << GetCheckpointFolder() << G4endl;
+    return;
+  }
+
+  // the single output file of the chain is only written by its last segment
+  if (fChainSingleOutput && fEventsDone < fEventsRequested) {
+    G4cout << "\n--> warning from RunControl::Resume : the chain in " << GetCheckpointFolder()
+           << " writes a single output file, which is lost with the stopped run. Start the chain again." << G4endl;
+    return;
+  }
+
+  if (nofEvents > 0) fEventsRequested = nofEvents;
+
+  G4cout << "\n Resuming segmented run at event " << fEventsDone << " of " << fEventsRequested
+         << " (segment " << fSegment << ", base seed " << fBaseSeed << ", from " << GetCheckpointFolder() << ")" << G4endl;
+
+  RunSegments();
+  fConverge = false;
+}
+
+
+void RunControl::RunSegments()
+{
+  fs::create_directories(GetCheckpointFolder());
+
+  G4RunManager* runManager = G4RunManager::GetRunManager();
+
+  fFirstSegment = fSegment;
+  if (fSingleOutput && fConverge) {
+    G4cout << "\n--> warning from RunControl : the last segment of a convergence run is not known in advance,"
+           << " the segments write separate output files." << G4endl;
+  }
+
+  fActive = true;
+  while (fEventsDone < fEventsRequested && !(fConverge && Converged())) {
+    G4long nofEvents = std::min(fSegmentSize, fEventsRequested - fEventsDone);
+    G4int  segment   = fSegment;
+
+    fLastSegment = (fEventsDone + nofEvents >= fEventsRequested);
+    fSegmentFiles.clear();
+    fSegmentStart = std::chrono::steady_clock::now();
+    runManager->BeamOn((G4int)nofEvents);
+
+    // EndOfSegment() did not accept the segment (aborted run) - stop here, resume repeats the segment
+    if (fSegment == segment) {
+      G4cout << "\n--> warning from RunControl : segment " << segment << " did not finish, stopping.";
+      if (IsSingleOutput()) G4cout << " The single output file of this chain is not written, run the chain again:"
+                                   << " it can not be resumed." << G4endl;
+      else                  G4cout << " Use /custom/run/resume to continue." << G4endl;
+      fActive = false;
+      return;
+    }
+  }
+  fActive = false;
+
+  // before EndOfRun(), which normalises the sums; also for a shard without events, ColliMerge expects every shard
+  if (fNbOfShards > 0) WriteShardResult();
+
+  // nothing was run (resume of a finished or converged chain, a shard without events): the primary particle of the
+  // total Run is only set by a merged segment, and a finished chain printed its total when it ended
+  if (fSegment == fFirstSegment) {
+    G4cout << "\n The segmented run in " << GetCheckpointFolder() << " has nothing left to run ("
+           << fEventsDone << " events, " << fSegment << " segments)." << G4endl;
+    return;
+  }
+
+  G4cout
+    << G4endl
+    << "--------------------End of Segmented Run--------------------"
+    << G4endl
+    << " " << fSegment << " segments, output files:" << G4endl;
+  for ( const auto& fileName : fOutputFiles ) G4cout << "  " << fileName << G4endl;
+
+  fTotalRun->EndOfRun();
+}
+
+
+G4double RunControl::BatchRelativeError(G4int tally) const
+{
+  G4int nofBatches = fBatches.size();
+  if (nofBatches < 2) return DBL_MAX;
+
+  G4double mean = 0.;
+  for ( const auto& batch : fBatches ) mean += batch[tally];
+  mean /= nofBatches;
+
+  G4double variance = 0.;
+  for ( const auto& batch : fBatches ) variance += (batch[tally] - mean)*(batch[tally] - mean);
+  variance /= (nofBatches - 1);
+
+  // a tally which stays zero in every batch (e.g. no SD2 gammas) is exact, not undetermined
+  if (mean == 0. && variance == 0.) return 0.;
+  if (mean <= 0.) return DBL_MAX;
+
+  // error of the mean of the batch means
+  return std::sqrt(variance/nofBatches)/mean;
+}
+
+
+G4bool RunControl::Converged() const
+{
+  if (fBatches.empty()) return false;
+
+  const char* names[kNbOfBatchTallies] = { "SD1 neutrons", "SD2 gammas", "mean edep" };
+  G4bool converged = ((G4int)fBatches.size() >= kMinNbOfBatches);
+
+  G4int dfprec = G4cout.precision(3);
+  G4cout << "\n Convergence after " << fBatches.size() << " batches (" << fEventsDone << " events, "
+         << fElapsed << " s):";
+  for (G4int i = 0; i < kNbOfBatchTallies; i++) {
+    G4double relError = BatchRelativeError(i);
+    if (relError > fTargetError) converged = false;
+    G4bool empty = std::all_of(fBatches.begin(), fBatches.end(), [i](const auto& batch) { return batch[i] == 0.; });
+    G4cout << "  " << names[i] << " = ";
+    if (empty && relError == 0.) G4cout << "0 (empty)";
+    else if (relError < DBL_MAX) G4cout << relError; else G4cout << "n/a";
+  }
+  G4cout << "  (target " << fTargetError << ")" << G4endl;
+  G4cout.precision(dfprec);
+
+  if (converged) {
+    G4cout << " All tallies converged." << G4endl;
+    return true;
+  }
+  if (fElapsed >= fTimeBudget) {
+    G4cout << " Time budget of " << fTimeBudget << " s used up, stopping before convergence." << G4endl;
+    return true;
+  }
+  return false;
+}
+
+
+void RunControl::SeedEvent(G4int eventID) const
+{
+  // splitmix64 of the base seed and the global event number
+  G4long eventNumber = fFirstEvent + fEventsDone + eventID;
+  unsigned long long state = (unsigned long long)fBaseSeed * 0x9E3779B97F4A7C15ULL
+                           + (unsigned long long)eventNumber;
+  auto next = [&state]() {
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  };
+
+  long seeds[3];
+  seeds[0] = (long)(next() >> 33) + 1;
+  seeds[1] = (long)(next() >> 33) + 1;
+  seeds[2] = 0;
+  G4Random::setTheSeeds(seeds);
+}
+
+
+void RunControl::AddOutputFile(G4String fileName)
+{
+  fSegmentFiles.push_back(fileName);
+}
+
+
+void RunControl::EndOfSegment(Run* run)
+{
+  G4long expected = std::min(fSegmentSize, fEventsRequested - fEventsDone);
+  if (run->GetNumberOfEvent() != expected) return;
+
+  // per-event means of this batch - before Run::EndOfRun() normalises the sums
+  std::array<G4double,kNbOfBatchTallies> batch;
+  batch[0] = (G4double)run->GetTally(Run::kSD1Neutrons)/expected;
+  batch[1] = (G4double)run->GetTally(Run::kSD2Gammas)/expected;
+  batch[2] = run->GetEnergyDeposit()/expected;
+  fBatches.push_back(batch);
+  fElapsed += std::chrono::duration<G4double>(std::chrono::steady_clock::now() - fSegmentStart).count();
+
+  // the total is named after the run of its first segment - see Run::EndOfRun()
+  if (fTotalRun->GetNbOfEvents() == 0) fTotalRun->SetRunID(run->GetRunID());
+  fTotalRun->MergeSegment(run);
+  fEventsDone += expected;
+  fSegment++;
+  fOutputFiles.insert(fOutputFiles.end(), fSegmentFiles.begin(), fSegmentFiles.end());
+
+  WriteCheckpoint();
+}
+
+
+void RunControl::WriteCheckpoint() const
+{
+  // write to a temporary file first, so a crash while writing keeps the previous checkpoint
+  G4String fileName = GetCheckpointFolder() + "/checkpoint.txt";
+  {
+    std::ofstream out(fileName + ".tmp");
+    out << "ColliRotateCheckpoint 1\n";
+    out << "baseSeed "        << fBaseSeed        << "\n";
+    out << "eventsRequested " << fEventsRequested << "\n";
+    out << "eventsDone "      << fEventsDone      << "\n";
+    out << "segmentSize "     << fSegmentSize     << "\n";
+    out << "segment "         << fSegment         << "\n";
+    out << "firstEvent "      << fFirstEvent      << "\n";
+    out << "eventsTotal "     << fEventsTotal     << "\n";
+    out << "elapsed "         << fElapsed         << "\n";
+    if (fConverge) out << "converge " << fTargetError << " " << fTimeBudget << "\n";
+    if (IsSingleOutput()) out << "singleOutput\n";
+    out.precision(std::numeric_limits<G4double>::max_digits10);
+    for ( const auto& batch : fBatches ) out << "batch " << batch[0] << " " << batch[1] << " " << batch[2] << "\n";
+    for ( const auto& outputFile : fOutputFiles ) out << "file " << outputFile << "\n";
+    out << "run\n";
+    fTotalRun->WriteState(out);
+  }
+  fs::rename(fileName + ".tmp", fileName);
+}
+
+
+G4bool RunControl::ReadCheckpoint()
+{
+  std::ifstream in(GetCheckpointFolder() + "/checkpoint.txt");
+  if (!in) return false;
+
+  std::string line;
+  std::getline(in, line);
+  if (line != "ColliRotateCheckpoint 1") return false;
+
+  delete fTotalRun;
+  fTotalRun = new Run(fDetector);
+  fOutputFiles.clear();
+  fBatches.clear();
+  fElapsed = 0.;
+  fChainSingleOutput = false;
+
+  while (std::getline(in, line)) {
+    std::istringstream is(line);
+    G4String key;
+    is >> key;
+
+    if      (key == "baseSeed")        is >> fBaseSeed;
+    else if (key == "eventsRequested") is >> fEventsRequested;
+    else if (key == "eventsDone")      is >> fEventsDone;
+    else if (key == "segmentSize")     is >> fSegmentSize;
+    else if (key == "segment")         is >> fSegment;
+    else if (key == "firstEvent")      is >> fFirstEvent;
+    else if (key == "eventsTotal")     is >> fEventsTotal;
+    else if (key == "elapsed")         is >> fElapsed;
+    else if (key == "converge")      { is >> fTargetError >> fTimeBudget; fConverge = true; }
+    else if (key == "singleOutput")    fChainSingleOutput = true;
+    else if (key == "batch") {
+      std::array<G4double,kNbOfBatchTallies> batch;
+      is >> batch[0] >> batch[1] >> batch[2];
+      fBatches.push_back(batch);
+    }
+    else if (key == "file")            fOutputFiles.push_back(line.substr(5));
+    else if (key == "run")             return fTotalRun->ReadState(in);
+  }
+  return false;
+}
+
+
+void RunControl::WriteShardResult() const
+{
+  // self-describing partial result: which slice of which run, the output files and the Run accumulators
+  G4String folder = folderName + "/Shards";
+  fs::create_directories(folder);
+  G4String fileName = folder + "/shard_" + std::to_string(fShardIndex) + "_of_" + std::to_string(fNbOfShards) + ".txt";
+  {
+    std::ofstream out(fileName + ".tmp");
+    out << "ColliRotateShard 1\n";
+    out << "shard "       << fShardIndex << " " << fNbOfShards << "\n";
+    out << "baseSeed "    << fBaseSeed    << "\n";
+    out << "eventsTotal " << fEventsTotal << "\n";
+    out << "firstEvent "  << fFirstEvent  << "\n";
+    out << "events "      << fEventsDone  << "\n";
+    if (OutputNaming::Instance()) out << "tag " << OutputNaming::Instance()->GetTag() << "\n";
+    for ( const auto& outputFile : fOutputFiles ) out << "file " << outputFile << "\n";
+    out << "run\n";
+    fTotalRun->WriteState(out);
+  }
+  fs::rename(fileName + ".tmp", fileName);
+
+  if (OutputNaming::Instance()) OutputNaming::Instance()->Register("shard", fileName);
+  G4cout << " Shard result written to " << fileName << G4endl;
+}
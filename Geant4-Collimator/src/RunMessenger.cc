@@ -0,0 +1,163 @@
+/*
+Commands for segmented runs with checkpoints - see RunControl.cc
+Event numbers are 64 bit, so they are passed as strings; G4UIcmdWithAnInteger stops at 2,147,483,647.
+*/
+
+#include "RunMessenger.hh"
+
+#include "RunControl.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcommand.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIparameter.hh"
+
+#include <limits>
+#include <sstream>
+
+
+RunMessenger::RunMessenger(RunControl* control)
+:G4UImessenger(),
+ fRunControl(control), fRunDir(nullptr),
+ fBeamOnCmd(nullptr), fResumeCmd(nullptr), fSegmentCmd(nullptr), fSeedCmd(nullptr),
+ fConvergeCmd(nullptr), fSingleOutputCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fRunDir = new G4UIdirectory("/custom/run/",broadcast);
+  fRunDir->SetGuidance("Segmented runs with checkpoints.");
+
+  // Start a segmented run
+  fBeamOnCmd = new G4UIcmdWithAString("/custom/run/beamOn",this);
+  fBeamOnCmd->SetGuidance("Start a run of N events in segments, with a checkpoint after each segment");
+  fBeamOnCmd->SetParameterName("N",false);
+  fBeamOnCmd->AvailableForStates(G4State_Idle);
+
+  // Resume from the last checkpoint
+  fResumeCmd = new G4UIcommand("/custom/run/resume",this);
+  fResumeCmd->SetGuidance("Continue the segmented run of the last checkpoint up to N events");
+  fResumeCmd->SetGuidance("N = 0 continues up to the event count of the interrupted run");
+  fResumeCmd->SetGuidance("tag = output tag of the interrupted process (Output/Checkpoint_<tag>), last = the newest checkpoint");
+
+  G4UIparameter* eventsPrm = new G4UIparameter("N",'s',true);
+  eventsPrm->SetDefaultValue("0");
+  fResumeCmd->SetParameter(eventsPrm);
+
+  G4UIparameter* tagPrm = new G4UIparameter("tag",'s',true);
+  tagPrm->SetDefaultValue("last");
+  fResumeCmd->SetParameter(tagPrm);
+
+  fResumeCmd->AvailableForStates(G4State_Idle);
+
+  // Events per segment = checkpoint interval
+  fSegmentCmd = new G4UIcmdWithAString("/custom/run/checkpointEvery",this);
+  fSegmentCmd->SetGuidance("Number of events per segment, a checkpoint is written after each segment (default 100000)");
+  fSegmentCmd->SetGuidance("At most 2147483647, the limit of one /run/beamOn");
+  fSegmentCmd->SetParameterName("n",false);
+  fSegmentCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Base seed of the per-event seeds
+  fSeedCmd = new G4UIcmdWithAString("/custom/run/setSeed",this);
+  fSeedCmd->SetGuidance("Base seed for the per-event seeds of a segmented run (default: drawn from the master engine)");
+  fSeedCmd->SetParameterName("seed",false);
+  fSeedCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Run segments until the tallies are converged
+  fConvergeCmd = new G4UIcommand("/custom/run/converge",this);
+  fConvergeCmd->SetGuidance("Run segments until the relative errors of the SD1 neutron count, the SD2 gamma count");
+  fConvergeCmd->SetGuidance("and the mean energy deposit are below relErr, or until the time budget is used up.");
+  fConvergeCmd->SetGuidance("Each segment (/custom/run/checkpointEvery) is one batch of the batch-means estimate.");
+
+  G4UIparameter* errPrm = new G4UIparameter("relErr",'d',false);
+  errPrm->SetGuidance("target relative error");
+  errPrm->SetParameterRange("relErr>0.");
+  fConvergeCmd->SetParameter(errPrm);
+
+  G4UIparameter* budgetPrm = new G4UIparameter("budget",'d',false);
+  budgetPrm->SetGuidance("wall time budget");
+  budgetPrm->SetParameterRange("budget>0.");
+  fConvergeCmd->SetParameter(budgetPrm);
+
+  G4UIparameter* unitPrm = new G4UIparameter("unit",'s',true);
+  unitPrm->SetGuidance("unit of the time budget");
+  unitPrm->SetDefaultValue("min");
+  unitPrm->SetParameterCandidates("s min h");
+  fConvergeCmd->SetParameter(unitPrm);
+
+  fConvergeCmd->AvailableForStates(G4State_Idle);
+
+  // One output file for all segments
+  fSingleOutputCmd = new G4UIcmdWithABool("/custom/run/singleOutput",this);
+  fSingleOutputCmd->SetGuidance("Write all segments of a segmented run into one output file (default false)");
+  fSingleOutputCmd->SetGuidance("The file is written by the last segment, a chain which stopped early can not be resumed");
+  fSingleOutputCmd->SetParameterName("flag",true);
+  fSingleOutputCmd->SetDefaultValue(true);
+  fSingleOutputCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+}
+
+
+RunMessenger::~RunMessenger()
+{
+  delete fBeamOnCmd;
+  delete fResumeCmd;
+  delete fSegmentCmd;
+  delete fSeedCmd;
+  delete fConvergeCmd;
+  delete fSingleOutputCmd;
+  delete fRunDir;
+}
+
+
+void RunMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fConvergeCmd )
+   { G4double relError, budget;
+     G4String unit;
+     std::istringstream is(newValue);
+     is >> relError >> budget >> unit;
+     // wall clock seconds, not Geant4 time units
+     G4double seconds = (unit == "h") ? 3600. : (unit == "min") ? 60. : 1.;
+     fRunControl->BeamOnUntilConverged(relError, budget*seconds);
+     return;
+   }
+
+  if( command == fSingleOutputCmd )
+   { fRunControl->SetSingleOutput(fSingleOutputCmd->GetNewBoolValue(newValue));
+     return;
+   }
+
+  G4long value = -1;
+  std::istringstream is(newValue);
+  is >> value;
+  if (is.fail() || value < 0) {
+    G4cout << "\n--> warning from RunMessenger : " << command->GetCommandPath()
+           << " needs a positive number, got " << newValue << G4endl;
+    return;
+  }
+
+  if( command == fBeamOnCmd && value == 0 ) {
+    G4cout << "\n--> warning from RunMessenger : " << command->GetCommandPath()
+           << " needs at least one event" << G4endl;
+    return;
+  }
+
+  if( command == fBeamOnCmd )
+   { fRunControl->BeamOn(value);}
+
+  if( command == fResumeCmd )
+   { G4String tag = "last";
+     is >> tag;
+     fRunControl->Resume(value, tag == "last" ? "" : tag);}
+
+  // a segment is one /run/beamOn, which counts its events in 32 bit
+  if( command == fSegmentCmd && value > std::numeric_limits<G4int>::max() ) {
+    G4cout << "\n--> warning from RunMessenger : " << command->GetCommandPath()
+           << " can be at most " << std::numeric_limits<G4int>::max() << " events, got " << newValue << G4endl;
+    return;
+  }
+
+  if( command == fSegmentCmd && value > 0 )
+   { fRunControl->SetSegmentSize(value);}
+
+  if( command == fSeedCmd )
+   { fRunControl->SetBaseSeed(value);}
+}
@@ -1,5 +1,8 @@
 #include "SensitiveDetector.hh"
 #include "Analysis.hh"
+#include "Run.hh"
+#include "OutputWriter.hh"
+#include "PerfCounters.hh"
 
 #include "G4VTouchable.hh"
 #include "G4Step.hh"
@@ -9,6 +12,7 @@
 #include "G4VProcess.hh"
 
 #include "G4ParticleTypes.hh"
+#include "G4RunManager.hh"
 
 
 SD2::SD2(const G4String& name)
@@ -26,6 +30,8 @@ void SD2::Initialize(G4HCofThisEvent* /*hce*/)
 
 G4bool SD2::ProcessHits(G4Step* step, G4TouchableHistory* /*history*/)
 {
+  PerfCounters::Scope perf(PerfCounters::kSensitive);
+
   // Current track:
   const G4Track* track = step->GetTrack();
 
@@ -55,19 +61,37 @@ G4bool SD2::ProcessHits(G4Step* step, G4TouchableHistory* /*history*/)
     // Get Analysis Manager
     G4AnalysisManager* analysisManager = G4AnalysisManager::Instance();
 
-    // Store neutron hit in the ntuple
-    if(particle == G4Neutron::Neutron())  analysisManager->FillNtupleDColumn(3, 0, Ekin/MeV);
-    if(particle == G4Neutron::Neutron())  analysisManager->FillNtupleDColumn(3, 1, localPosition.x()/cm);
-    if(particle == G4Neutron::Neutron())  analysisManager->FillNtupleDColumn(3, 2, localPosition.y()/cm);
-    if(particle == G4Neutron::Neutron())  analysisManager->FillNtupleDColumn(3, 3, time/ns);
-    if(particle == G4Neutron::Neutron())  analysisManager->AddNtupleRow(3);
-
-    // Store gamma hit in the ntuple
-    if(particle == G4Gamma::Gamma())  analysisManager->FillNtupleDColumn(4, 0, Ekin/MeV);
-    if(particle == G4Gamma::Gamma())  analysisManager->FillNtupleDColumn(4, 1, localPosition.x()/cm);
-    if(particle == G4Gamma::Gamma())  analysisManager->FillNtupleDColumn(4, 2, localPosition.y()/cm);
-    if(particle == G4Gamma::Gamma())  analysisManager->FillNtupleDColumn(4, 3, time/ns);
-    if(particle == G4Gamma::Gamma())  analysisManager->AddNtupleRow(4);
+    // Hits for the writer thread - see OutputWriter.cc
+    OutputWriter* outputWriter = OutputWriter::Instance();
+    if (outputWriter && outputWriter->IsActive())
+    {
+      if(particle == G4Neutron::Neutron())  outputWriter->AddHit(3, Ekin/MeV, localPosition.x()/cm, localPosition.y()/cm, time/ns);
+      if(particle == G4Gamma::Gamma())      outputWriter->AddHit(4, Ekin/MeV, localPosition.x()/cm, localPosition.y()/cm, time/ns);
+    }
+
+    if (!outputWriter || outputWriter->WriteNtuples())
+    {
+      // Store neutron hit in the ntuple
+      if(particle == G4Neutron::Neutron())  analysisManager->FillNtupleDColumn(3, 0, Ekin/MeV);
+      if(particle == G4Neutron::Neutron())  analysisManager->FillNtupleDColumn(3, 1, localPosition.x()/cm);
+      if(particle == G4Neutron::Neutron())  analysisManager->FillNtupleDColumn(3, 2, localPosition.y()/cm);
+      if(particle == G4Neutron::Neutron())  analysisManager->FillNtupleDColumn(3, 3, time/ns);
+      if(particle == G4Neutron::Neutron())  analysisManager->AddNtupleRow(3);
+
+      // Store gamma hit in the ntuple
+      if(particle == G4Gamma::Gamma())  analysisManager->FillNtupleDColumn(4, 0, Ekin/MeV);
+      if(particle == G4Gamma::Gamma())  analysisManager->FillNtupleDColumn(4, 1, localPosition.x()/cm);
+      if(particle == G4Gamma::Gamma())  analysisManager->FillNtupleDColumn(4, 2, localPosition.y()/cm);
+      if(particle == G4Gamma::Gamma())  analysisManager->FillNtupleDColumn(4, 3, time/ns);
+      if(particle == G4Gamma::Gamma())  analysisManager->AddNtupleRow(4);
+    }
+
+    // Count gamma hits for the convergence check - see RunControl.cc
+    if(particle == G4Gamma::Gamma())
+    {
+      Run* run = static_cast<Run*>(G4RunManager::GetRunManager()->GetNonConstCurrentRun());
+      run->CountTally(Run::kSD2Gammas);
+    }
 
     // // Store hit in histogram 
     // analysisManager->FillH1(0, ID);
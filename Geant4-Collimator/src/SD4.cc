@@ -1,5 +1,6 @@
 #include "SensitiveDetector.hh"
 #include "Analysis.hh"
+#include "PerfCounters.hh"
 
 #include "G4VTouchable.hh"
 #include "G4Step.hh"
@@ -26,6 +27,8 @@ void SD4::Initialize(G4HCofThisEvent* /*hce*/)
 
 G4bool SD4::ProcessHits(G4Step* step, G4TouchableHistory* /*history*/)
 {
+  PerfCounters::Scope perf(PerfCounters::kSensitive);
+
   // Current track:
   const G4Track* track = step->GetTrack();
 
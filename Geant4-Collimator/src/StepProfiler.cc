@@ -0,0 +1,293 @@
+/*
+Sampling step profiler, to see where the steps and the CPU time go - tungsten insert vs copper body vs borated PE,
+neutrons vs gammas vs electrons, hadElastic vs Transportation - and so where biasing and production cuts pay off.
+
+Every thread counts into a dense table [volume][particle][process] of its own (thread_local, allocated on first use
+and kept in a list), without strings on the stepping path:
+  - volume:   a row per logical volume, assigned when the volume is stepped through the first time in the run
+              (open addressing by pointer, like the processes). The rows are dropped at every run, so geometry
+              rebuilds (/custom/geo/change_x) do not add rows; after kMaxVolumes - 1 volumes the last row collects
+              the rest
+  - particle: a column per particle definition ID, assigned when the particle is seen the first time in this thread;
+              after kMaxParticles - 1 particles (many ions) the last column collects the rest
+  - process:  the process pointers of the thread are looked up in an open-addressing table; a process name gets a
+              column when it is seen the first time, so hIoni of all particles share one column
+The names are looked at only when a new particle or process pointer turns up.
+
+Every step is counted. The thread CPU time is read only around every n-th step (/custom/profile/sampling, default
+64): the time from the end of the sampled step to the end of the next one is that step's cost. It is added n times
+to its cell, which makes the time column an estimate; steps starting a new track are skipped because their time
+includes the tracking of the previous one.
+
+At the end of the run the master adds the tables of all threads up by name and writes
+  Output/Profile/StepProfile_<tag>_r<run>.csv
+with volume, particle, process, steps, the estimated CPU time, and the fractions of all steps and all time, sorted by
+time. The ten most expensive rows are printed as well.
+*/
+
+#include "StepProfiler.hh"
+#include "ProfileMessenger.hh"
+#include "OutputNaming.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4VProcess.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4AutoLock.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+#if __unix__
+#include <time.h>                         //clock_gettime with the CPU time of the thread
+#endif
+
+// get folderName from where it is defined (RunAction.cc) - the really dirty way
+extern std::string folderName;
+
+namespace {
+  G4Mutex stepProfilerMutex = G4MUTEX_INITIALIZER;
+}
+
+StepProfiler* StepProfiler::fgInstance = nullptr;
+G4bool StepProfiler::fgEnabled = false;
+G4int StepProfiler::fgSampling = 64;
+G4int StepProfiler::fgRun = 0;
+G4ThreadLocal StepProfiler::ThreadData* StepProfiler::fgLocal = nullptr;
+std::vector<std::unique_ptr<StepProfiler::ThreadData>> StepProfiler::fgThreadData;
+
+
+StepProfiler::StepProfiler()
+: fProfileMessenger(nullptr)
+{
+  fgInstance = this;
+  fProfileMessenger = new ProfileMessenger(this);
+}
+
+
+StepProfiler::~StepProfiler()
+{
+  delete fProfileMessenger;
+  fgInstance = nullptr;
+}
+
+
+StepProfiler::ThreadData& StepProfiler::Register()
+{
+  auto data = std::make_unique<ThreadData>();
+  data->fProcessSlots.assign(kProcessSlots, { nullptr, -1 });
+  data->fProcessNames.push_back("none");            // column 0: no process defined the step
+
+  G4AutoLock lock(&stepProfilerMutex);
+  fgLocal = data.get();
+  fgThreadData.push_back(std::move(data));
+  return *fgLocal;
+}
+
+
+G4double StepProfiler::CPUTime()
+{
+#if __unix__
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + 1.e-9*ts.tv_nsec;
+#else
+  return std::chrono::duration<G4double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+void StepProfiler::ThreadData::Reset(G4int run)
+{
+  // the geometry may have been rebuilt since the last run, and a new volume may have the address of an old one
+  fRun = run;
+  fTable.clear();
+  fVolumeSlots.assign(kVolumeSlots, { nullptr, -1 });
+  fVolumeNames.clear();
+  fCount  = 0;
+  fMarked = false;
+}
+
+
+G4int StepProfiler::ThreadData::VolumeRow(const G4LogicalVolume* volume)
+{
+  const std::size_t mask = kVolumeSlots - 1;
+  std::size_t slot = ((std::uintptr_t)volume >> 4)*0x9E3779B97F4A7C15ull >> 20 & mask;
+  for (G4int probe = 0; probe < kVolumeSlots; probe++, slot = (slot + 1) & mask) {
+    auto& entry = fVolumeSlots[slot];
+    if (entry.second >= 0 && entry.first == volume) return entry.second;
+    if (entry.second >= 0) continue;
+
+    // first step in this volume in this run: a new row
+    G4int row = (G4int)fVolumeNames.size();
+    if (row < kMaxVolumes - 1) fVolumeNames.push_back(volume ? volume->GetName() : G4String("none"));
+    else {
+      row = kMaxVolumes - 1;
+      if (fVolumeNames.size() < (std::size_t)kMaxVolumes) fVolumeNames.push_back("other");
+    }
+    fTable.resize(fVolumeNames.size()*kMaxParticles*kMaxProcesses);
+    entry = { volume, row };
+    return row;
+  }
+  return kMaxVolumes - 1;                             // table full
+}
+
+
+G4int StepProfiler::ThreadData::ParticleColumn(const G4ParticleDefinition* particle)
+{
+  G4int id = particle->GetParticleDefinitionID();
+  if (id < 0) return kMaxParticles - 1;
+  if (id < (G4int)fParticleColumn.size() && fParticleColumn[id] >= 0) return fParticleColumn[id];
+
+  // first step of this particle in this thread
+  if (id >= (G4int)fParticleColumn.size()) fParticleColumn.resize(id + 1, -1);
+  G4int column = (G4int)fParticleNames.size();
+  if (column < kMaxParticles - 1) fParticleNames.push_back(particle->GetParticleName());
+  else {
+    column = kMaxParticles - 1;
+    if (fParticleNames.size() < (std::size_t)kMaxParticles) fParticleNames.push_back("other");
+  }
+  fParticleColumn[id] = column;
+  return column;
+}
+
+
+G4int StepProfiler::ThreadData::ProcessColumn(const G4VProcess* process)
+{
+  if (!process) return 0;
+
+  const std::size_t mask = kProcessSlots - 1;
+  std::size_t slot = ((std::uintptr_t)process >> 4)*0x9E3779B97F4A7C15ull >> 20 & mask;
+  for (G4int probe = 0; probe < kProcessSlots; probe++, slot = (slot + 1) & mask) {
+    auto& entry = fProcessSlots[slot];
+    if (entry.first == process) return entry.second;
+    if (entry.first) continue;
+
+    // first step of this process object in this thread: a column per process name
+    const G4String& name = process->GetProcessName();
+    auto found = std::find(fProcessNames.begin(), fProcessNames.end(), name);
+    G4int column = (G4int)(found - fProcessNames.begin());
+    if (found == fProcessNames.end()) {
+      if (column < kMaxProcesses - 1) fProcessNames.push_back(name);
+      else {
+        column = kMaxProcesses - 1;
+        if (fProcessNames.size() < (std::size_t)kMaxProcesses) fProcessNames.push_back("other");
+      }
+    }
+    entry = { process, column };
+    return column;
+  }
+  return kMaxProcesses - 1;                           // table full
+}
+
+
+void StepProfiler::Step(const G4Step* step)
+{
+  ThreadData& data = Local();
+  if (data.fRun != fgRun) data.Reset(fgRun);
+
+  const G4Track* track = step->GetTrack();
+  const G4VPhysicalVolume* physical = step->GetPreStepPoint()->GetPhysicalVolume();
+  G4int volume   = data.VolumeRow(physical ? physical->GetLogicalVolume() : nullptr);
+  G4int particle = data.ParticleColumn(track->GetDefinition());
+  G4int process  = data.ProcessColumn(step->GetPostStepPoint()->GetProcessDefinedStep());
+
+  Cell& cell = data.fTable[((std::size_t)volume*kMaxParticles + particle)*kMaxProcesses + process];
+  cell.fSteps++;
+
+  // sampled CPU time: from the end of the marked step to the end of this one
+  if (data.fMarked) {
+    data.fMarked = false;
+    if (data.fMarkTrack == track) cell.fTime += (CPUTime() - data.fMark)*fgSampling;
+  }
+  if (++data.fCount >= fgSampling) {
+    data.fCount     = 0;
+    data.fMarked    = true;
+    data.fMarkTrack = track;
+    data.fMark      = CPUTime();
+  }
+}
+
+
+void StepProfiler::BeginOfRun()
+{
+  // before the workers start: every thread clears its table at its first step of the new run
+  fgRun++;
+}
+
+
+void StepProfiler::EndOfRun(G4int runID) const
+{
+  if (!fgEnabled) return;
+
+  // all threads, by name
+  std::map<std::array<G4String,3>,Cell> cells;
+  Cell total;
+  {
+    G4AutoLock lock(&stepProfilerMutex);
+    for ( const auto& data : fgThreadData ) {
+      if (data->fRun != fgRun) continue;
+      for (std::size_t v = 0; v < data->fVolumeNames.size(); v++) {
+        const G4String& volume = data->fVolumeNames[v];
+        for (std::size_t p = 0; p < data->fParticleNames.size(); p++) {
+          for (std::size_t q = 0; q < data->fProcessNames.size(); q++) {
+            const Cell& cell = data->fTable[(v*kMaxParticles + p)*kMaxProcesses + q];
+            if (cell.fSteps == 0) continue;
+            Cell& sum = cells[{ volume, data->fParticleNames[p], data->fProcessNames[q] }];
+            sum.fSteps   += cell.fSteps;
+            sum.fTime    += cell.fTime;
+            total.fSteps += cell.fSteps;
+            total.fTime  += cell.fTime;
+          }
+        }
+      }
+    }
+  }
+  if (total.fSteps == 0) return;
+
+  std::vector<std::pair<std::array<G4String,3>,Cell>> sorted(cells.begin(), cells.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+    return (a.second.fTime != b.second.fTime) ? a.second.fTime > b.second.fTime : a.second.fSteps > b.second.fSteps;
+  });
+
+  G4String folder = folderName + "/Profile";
+  std::error_code ec;
+  fs::create_directories(folder, ec);
+  OutputNaming* naming = OutputNaming::Instance();
+  G4String fileName = folder + "/" + (naming ? naming->GetFileName("StepProfile", runID, ".csv")
+                                             : G4String("StepProfile_r" + std::to_string(runID) + ".csv"));
+  std::ofstream out(fileName);
+  out << "volume,particle,process,steps,cpu_s,step_fraction,time_fraction\n";
+  for ( const auto& row : sorted ) {
+    out << row.first[0] << "," << row.first[1] << "," << row.first[2] << "," << row.second.fSteps << ","
+        << row.second.fTime << "," << (G4double)row.second.fSteps/total.fSteps << ","
+        << (total.fTime > 0. ? row.second.fTime/total.fTime : 0.) << "\n";
+  }
+  out.close();
+  if (naming) naming->Register("profile", fileName);
+
+  G4int dfprec = G4cout.precision(3);
+  G4cout << "\n ======================== Step profile ========================"
+         << "\n " << total.fSteps << " steps, " << total.fTime << " s CPU (sampled 1/" << fgSampling << ")"
+         << "\n " << std::left << std::setw(20) << "volume" << std::setw(12) << "particle" << std::setw(20) << "process"
+         << std::right << std::setw(9) << "steps %" << std::setw(9) << "time %" << G4endl;
+  for (std::size_t i = 0; i < sorted.size() && i < 10; i++) {
+    const auto& row = sorted[i];
+    G4cout << " " << std::left << std::setw(20) << row.first[0] << std::setw(12) << row.first[1]
+           << std::setw(20) << row.first[2] << std::right
+           << std::setw(9) << 100.*row.second.fSteps/total.fSteps
+           << std::setw(9) << (total.fTime > 0. ? 100.*row.second.fTime/total.fTime : 0.) << G4endl;
+  }
+  G4cout << " table: " << fileName
+         << "\n ==============================================================" << G4endl;
+  G4cout.precision(dfprec);
+}
@@ -0,0 +1,334 @@
+/*
+Binary step recorder. SteppingVerbose::StepInfo formats every step through G4BestUnit into G4cout, which makes
+/tracking/verbose unusable beyond a handful of events. With /custom/record/enable every thread instead appends a
+40-byte record per step (position, time, energy, deposit, step and track length, volume and process ID - see
+StepTrace.hh) to a buffer, which goes through zlib (level 1 by default) in blocks of 1 MB into
+  Output/StepTrace/steps_<tag>_r<run>[_t<thread>].steps.gz
+The names of processes and particles are written once per file, when their ID is used the first time. The volumes
+get a dense ID per file: all logical volumes of the geometry are listed at the start of the file, so the IDs do not
+depend on the instance IDs of Geant4, which grow with every geometry rebuild.
+
+Filters, all resolved before the workers start - on the stepping path there are no strings:
+  /custom/record/events first [last]     global event numbers (with the offset of a segmented run, see RunControl.cc)
+  /custom/record/particle name           repeat for more particles, "all" clears
+  /custom/record/volume name             logical volumes, repeat for more, "all" clears
+  /custom/record/energy min max unit     kinetic energy at the start of the step, max 0 = no upper limit
+A track gets a start record before its first recorded step. Print the files with
+  StepPrint [--event N] [--track N] file.steps.gz ...
+which writes the columns of SteppingVerbose - see StepPrint.cc.
+*/
+
+#include "StepRecorder.hh"
+#include "RecorderMessenger.hh"
+#include "StepTrace.hh"
+#include "RunControl.hh"
+#include "OutputNaming.hh"
+
+#include "G4Event.hh"
+#include "G4Run.hh"
+#include "G4RunManager.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4VProcess.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4ParticleTable.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+
+#include "zlib.h"
+
+#include <algorithm>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+// get folderName from where it is defined (RunAction.cc) - the really dirty way
+extern std::string folderName;
+
+namespace {
+  G4Mutex stepRecorderMutex = G4MUTEX_INITIALIZER;
+
+  // size of the blocks handed to zlib
+  const std::size_t kChunkSize = 1 << 20;
+}
+
+StepRecorder* StepRecorder::fgInstance = nullptr;
+G4bool StepRecorder::fgEnabled = false;
+G4ThreadLocal StepRecorder::ThreadData* StepRecorder::fgLocal = nullptr;
+std::vector<std::unique_ptr<StepRecorder::ThreadData>> StepRecorder::fgThreadData;
+
+
+StepRecorder::StepRecorder()
+: fRecorderMessenger(nullptr),
+  fFirstEvent(0), fLastEvent(-1), fEmin(0.), fEmax(0.), fCompression(1)
+{
+  fgInstance = this;
+  fRecorderMessenger = new RecorderMessenger(this);
+}
+
+
+StepRecorder::~StepRecorder()
+{
+  delete fRecorderMessenger;
+  fgInstance = nullptr;
+}
+
+
+void StepRecorder::AddParticle(const G4String& name)
+{
+  if (name == "all") fParticleNames.clear();
+  else fParticleNames.push_back(name);
+}
+
+
+void StepRecorder::AddVolume(const G4String& name)
+{
+  if (name == "all") fVolumeNames.clear();
+  else fVolumeNames.push_back(name);
+}
+
+
+StepRecorder::ThreadData& StepRecorder::Register()
+{
+  G4AutoLock lock(&stepRecorderMutex);
+  fgThreadData.push_back(std::make_unique<ThreadData>());
+  fgLocal = fgThreadData.back().get();
+  return *fgLocal;
+}
+
+
+void StepRecorder::BeginOfRun()
+{
+  if (!fgEnabled) return;
+
+  // particles
+  fParticles.clear();
+  for ( const auto& name : fParticleNames ) {
+    const G4ParticleDefinition* particle = G4ParticleTable::GetParticleTable()->FindParticle(name);
+    if (particle) fParticles.push_back(particle);
+    else G4cout << "\n--> warning from StepRecorder : unknown particle " << name << ", not recorded" << G4endl;
+  }
+  if (!fParticleNames.empty() && fParticles.empty()) fParticles.push_back(nullptr);    // nothing passes
+
+  // volumes of the current geometry
+  fVolumes.clear();
+  if (!fVolumeNames.empty()) {
+    for ( const G4LogicalVolume* volume : *G4LogicalVolumeStore::GetInstance() ) {
+      if (std::find(fVolumeNames.begin(), fVolumeNames.end(), volume->GetName()) == fVolumeNames.end()) continue;
+      fVolumes.push_back(volume);
+    }
+    if (fVolumes.empty()) {
+      G4cout << "\n--> warning from StepRecorder : none of the volumes of /custom/record/volume exists" << G4endl;
+      fVolumes.push_back(nullptr);                                                      // nothing passes
+    }
+  }
+}
+
+
+void StepRecorder::BeginOfEvent(const G4Event* event)
+{
+  ThreadData& data = Local();
+  data.fRecordEvent = false;
+  if (!fgEnabled) return;
+
+  G4long eventNumber = event->GetEventID();
+  RunControl* runControl = RunControl::Instance();
+  if (runControl && runControl->IsActive()) eventNumber += runControl->GetEventOffset();
+  if (eventNumber < fFirstEvent || (fLastEvent >= 0 && eventNumber > fLastEvent)) return;
+
+  data.fRecordEvent  = true;
+  data.fEvent        = eventNumber;
+  data.fRun          = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+  data.fEventWritten = false;
+  data.fTrack        = nullptr;
+}
+
+
+void StepRecorder::EndOfRun()
+{
+  Local().Close();
+}
+
+
+void StepRecorder::ThreadData::Open()
+{
+  G4String folder = folderName + "/StepTrace";
+  std::error_code ec;
+  fs::create_directories(folder, ec);
+
+  G4int thread = G4Threading::G4GetThreadId();
+  G4String suffix = (thread >= 0 ? "_t" + std::to_string(thread) : G4String("")) + ".steps.gz";
+  OutputNaming* naming = OutputNaming::Instance();
+  fFileName = folder + "/" + (naming ? naming->GetFileName("steps", fRun, suffix)
+                                     : "steps_r" + std::to_string(fRun) + suffix);
+
+  G4String mode = "wb" + std::to_string(fgInstance->fCompression);
+  fFile = gzopen(fFileName.c_str(), mode.c_str());
+  if (!fFile) {
+    G4cout << "\n--> warning from StepRecorder : can not write " << fFileName << G4endl;
+    fRecordEvent = false;
+    return;
+  }
+
+  // the ids of the names start again in every file
+  fBuffer.clear();
+  fBuffer.reserve(kChunkSize + 4096);
+  fVolumeIDs.clear();
+  fProcessIDs.clear();
+  fParticleIDs.clear();
+  fProcessNameIDs.clear();
+  fSteps = 0;
+  Write(StepTrace::kMagic, sizeof(StepTrace::kMagic));
+
+  // the volume table: dense IDs of this file, in the order of the store (the geometry is fixed during a run)
+  for ( const G4LogicalVolume* volume : *G4LogicalVolumeStore::GetInstance() ) {
+    if (fVolumeIDs.count(volume)) continue;
+    G4int id = std::min<G4int>(fVolumeIDs.size(), StepTrace::kOtherVolume);
+    fVolumeIDs[volume] = id;
+    if (id < StepTrace::kOtherVolume) WriteName(StepTrace::kVolumeName, id, volume->GetName());
+  }
+  if (fVolumeIDs.size() > StepTrace::kOtherVolume) WriteName(StepTrace::kVolumeName, StepTrace::kOtherVolume, "other");
+}
+
+
+void StepRecorder::ThreadData::Close()
+{
+  if (!fFile) return;
+  gzwrite((gzFile)fFile, fBuffer.data(), fBuffer.size());
+  gzclose((gzFile)fFile);
+  fFile = nullptr;
+  fBuffer.clear();
+
+  G4cout << "\n StepRecorder: " << fSteps << " steps written to " << fFileName << G4endl;
+  if (OutputNaming::Instance()) OutputNaming::Instance()->Register("steps", fFileName);
+}
+
+
+void StepRecorder::ThreadData::WriteName(uint8_t tag, G4int id, const G4String& name)
+{
+  uint16_t header[2] = { (uint16_t)id, (uint16_t)std::min<std::size_t>(name.size(), 0xFFFF) };
+  Write(&tag, 1);
+  Write(header, sizeof(header));
+  Write(name.data(), header[1]);
+}
+
+
+G4int StepRecorder::ThreadData::VolumeID(const G4LogicalVolume* volume)
+{
+  auto found = fVolumeIDs.find(volume);
+  if (found != fVolumeIDs.end()) return found->second;
+
+  // not in the store when the file was opened
+  G4int id = std::min<G4int>(fVolumeIDs.size(), StepTrace::kOtherVolume);
+  fVolumeIDs[volume] = id;
+  WriteName(StepTrace::kVolumeName, id, id < StepTrace::kOtherVolume ? volume->GetName() : G4String("other"));
+  return id;
+}
+
+
+G4int StepRecorder::ThreadData::ProcessID(const G4VProcess* process)
+{
+  if (!process) return StepTrace::kNoProcess;
+  auto found = fProcessIDs.find(process);
+  if (found != fProcessIDs.end()) return found->second;
+
+  // the processes of all particles with the same name share an id
+  const G4String& name = process->GetProcessName();
+  auto named = fProcessNameIDs.find(name);
+  G4int id = (named != fProcessNameIDs.end()) ? named->second : (G4int)fProcessNameIDs.size() + 1;
+  if (named == fProcessNameIDs.end()) {
+    fProcessNameIDs[name] = id;
+    WriteName(StepTrace::kProcessName, id, name);
+  }
+  fProcessIDs[process] = id;
+  return id;
+}
+
+
+G4int StepRecorder::ThreadData::ParticleID(const G4ParticleDefinition* particle)
+{
+  auto found = fParticleIDs.find(particle);
+  if (found != fParticleIDs.end()) return found->second;
+
+  G4int id = (G4int)fParticleIDs.size();
+  fParticleIDs[particle] = id;
+  WriteName(StepTrace::kParticleName, id, particle->GetParticleName());
+  return id;
+}
+
+
+void StepRecorder::ThreadData::Record(const G4Step* step)
+{
+  const StepRecorder* recorder = fgInstance;
+  const G4Track* track = step->GetTrack();
+  const G4StepPoint* pre  = step->GetPreStepPoint();
+  const G4StepPoint* post = step->GetPostStepPoint();
+  const G4LogicalVolume* volume = pre->GetPhysicalVolume()->GetLogicalVolume();
+
+  // filters
+  const auto& particles = recorder->fParticles;
+  if (!particles.empty() && std::find(particles.begin(), particles.end(), track->GetDefinition()) == particles.end())
+    return;
+  const auto& volumes = recorder->fVolumes;
+  if (!volumes.empty() && std::find(volumes.begin(), volumes.end(), volume) == volumes.end()) return;
+  G4double ekin = pre->GetKineticEnergy();
+  if (ekin < recorder->fEmin || (recorder->fEmax > 0. && ekin > recorder->fEmax)) return;
+
+  if (!fFile) {
+    Open();
+    if (!fFile) return;
+  }
+
+  if (!fEventWritten) {
+    StepTrace::EventRecord event = { fEvent, fRun };
+    uint8_t tag = StepTrace::kEvent;
+    Write(&tag, 1);
+    Write(&event, sizeof(event));
+    fEventWritten = true;
+  }
+
+  // start point of the track, before its first recorded step
+  if (track != fTrack || track->GetTrackID() != fTrackID) {
+    StepTrace::TrackRecord start;
+    start.fTrackID  = track->GetTrackID();
+    start.fParentID = track->GetParentID();
+    start.fParticle = (uint16_t)ParticleID(track->GetDefinition());
+    start.fVolume   = (uint16_t)VolumeID(volume);
+    start.fX        = (float)(pre->GetPosition().x()/mm);
+    start.fY        = (float)(pre->GetPosition().y()/mm);
+    start.fZ        = (float)(pre->GetPosition().z()/mm);
+    start.fTime     = (float)(pre->GetGlobalTime()/ns);
+    start.fEkin     = (float)(ekin/MeV);
+    uint8_t tag = StepTrace::kTrack;
+    Write(&tag, 1);
+    Write(&start, sizeof(start));
+    fTrack   = track;
+    fTrackID = track->GetTrackID();
+  }
+
+  StepTrace::StepRecord record;
+  record.fStep        = (uint32_t)track->GetCurrentStepNumber();
+  record.fVolume      = (uint16_t)VolumeID(volume);
+  record.fProcess     = (post->GetStepStatus() == fWorldBoundary) ? StepTrace::kOutOfWorld
+                                                                  : (uint16_t)ProcessID(post->GetProcessDefinedStep());
+  record.fX           = (float)(post->GetPosition().x()/mm);
+  record.fY           = (float)(post->GetPosition().y()/mm);
+  record.fZ           = (float)(post->GetPosition().z()/mm);
+  record.fTime        = (float)(post->GetGlobalTime()/ns);
+  record.fEkin        = (float)(post->GetKineticEnergy()/MeV);
+  record.fEdep        = (float)(step->GetTotalEnergyDeposit()/MeV);
+  record.fStepLength  = (float)(step->GetStepLength()/mm);
+  record.fTrackLength = (float)(track->GetTrackLength()/mm);
+  uint8_t tag = StepTrace::kStep;
+  Write(&tag, 1);
+  Write(&record, sizeof(record));
+  fSteps++;
+
+  if (fBuffer.size() >= kChunkSize) {
+    gzwrite((gzFile)fFile, fBuffer.data(), fBuffer.size());
+    fBuffer.clear();
+  }
+}
@@ -3,6 +3,12 @@
 #include "Run.hh"
 #include "EventAction.hh"
 #include "Analysis.hh"
+#include "TrackKiller.hh"
+#include "LoopCounters.hh"
+#include "EventWatchdog.hh"
+#include "StepProfiler.hh"
+#include "PerfCounters.hh"
+#include "StepRecorder.hh"
 
 #include "G4RunManager.hh"
                            
@@ -22,6 +28,12 @@ SteppingAction::~SteppingAction()
 
 void SteppingAction::UserSteppingAction(const G4Step* aStep)
 {
+  PerfCounters::Scope perf(PerfCounters::kStepping);
+  LOOP_COUNT(CountStep());
+  if (EventWatchdog::IsEnabled()) EventWatchdog::Step(aStep);
+  if (StepProfiler::IsEnabled()) StepProfiler::Step(aStep);
+  if (StepRecorder::IsEnabled()) StepRecorder::Step(aStep);
+
   // count processes
   // 
   const G4StepPoint* endPoint = aStep->GetPostStepPoint();
@@ -29,6 +41,16 @@ void SteppingAction::UserSteppingAction(const G4Step* aStep)
   Run* run = static_cast<Run*>(
         G4RunManager::GetRunManager()->GetNonConstCurrentRun());
   run->CountProcesses(process);
+
+  // kill tracks outside of the time and energy limits - see TrackKiller.cc
+  //
+  G4int killReason = fDetector->GetTrackKiller()->Check(aStep);
+  if (killReason != TrackKiller::kNotKilled) {
+    G4Track* track = aStep->GetTrack();
+    track->SetTrackStatus(fStopAndKill);
+    run->CountKilledTrack(track->GetDefinition()->GetParticleName(), killReason,
+                          track->GetKineticEnergy());
+  }
   
   // energy deposit
   //
@@ -0,0 +1,77 @@
+/*
+Commands for the timeline of the run phases - see Tracer.cc
+*/
+
+#include "TraceMessenger.hh"
+
+#include "Tracer.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithAString.hh"
+
+
+TraceMessenger::TraceMessenger(Tracer* tracer)
+:G4UImessenger(),
+ fTracer(tracer), fTraceDir(nullptr),
+ fEnableCmd(nullptr), fEventSamplingCmd(nullptr), fBufferSizeCmd(nullptr), fWriteCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fTraceDir = new G4UIdirectory("/custom/trace/",broadcast);
+  fTraceDir->SetGuidance("Timeline of the run phases as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).");
+
+  // Tracer on/off
+  fEnableCmd = new G4UIcmdWithABool("/custom/trace/enable",this);
+  fEnableCmd->SetGuidance("Record spans from now on (ColliRotate --trace records the initialization as well)");
+  fEnableCmd->SetParameterName("flag",true);
+  fEnableCmd->SetDefaultValue(true);
+  fEnableCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Events on the timeline
+  fEventSamplingCmd = new G4UIcmdWithAnInteger("/custom/trace/eventSampling",this);
+  fEventSamplingCmd->SetGuidance("Record every n-th event of each thread (default 100, 1 = every event)");
+  fEventSamplingCmd->SetParameterName("n",false);
+  fEventSamplingCmd->SetRange("n>=1");
+  fEventSamplingCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Ring buffer
+  fBufferSizeCmd = new G4UIcmdWithAnInteger("/custom/trace/bufferSize",this);
+  fBufferSizeCmd->SetGuidance("Spans kept per thread, rounded up to a power of 2 (default 65536)");
+  fBufferSizeCmd->SetGuidance("Applies to the threads started afterwards: set it before /run/initialize");
+  fBufferSizeCmd->SetParameterName("n",false);
+  fBufferSizeCmd->SetRange("n>=1");
+  fBufferSizeCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Output
+  fWriteCmd = new G4UIcmdWithAString("/custom/trace/write",this);
+  fWriteCmd->SetGuidance("Write the spans recorded so far (default Output/Trace/trace_<tag>.json)");
+  fWriteCmd->SetParameterName("fileName",true);
+  fWriteCmd->SetDefaultValue("");
+  fWriteCmd->AvailableForStates(G4State_Idle);
+}
+
+
+TraceMessenger::~TraceMessenger()
+{
+  delete fEnableCmd;
+  delete fEventSamplingCmd;
+  delete fBufferSizeCmd;
+  delete fWriteCmd;
+  delete fTraceDir;
+}
+
+
+void TraceMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fEnableCmd )
+   { fTracer->SetEnabled(fEnableCmd->GetNewBoolValue(newValue));}
+
+  if( command == fEventSamplingCmd )
+   { fTracer->SetEventSampling(fEventSamplingCmd->GetNewIntValue(newValue));}
+
+  if( command == fBufferSizeCmd )
+   { fTracer->SetBufferSize(fBufferSizeCmd->GetNewIntValue(newValue));}
+
+  if( command == fWriteCmd )
+   { fTracer->Write(newValue);}
+}
@@ -0,0 +1,203 @@
+/*
+Timeline of the run phases in the Chrome trace format, to see where the threads wait: how long the HP data loading
+keeps the workers from their first event, and how long the workers idle at the end of the run while the master
+merges. Open the file in chrome://tracing or https://ui.perfetto.dev.
+
+Enabled with ColliRotate --trace (from the start of main(), so the initialization is on the timeline) or
+/custom/trace/enable (from then on). Spans:
+  - main():            setup (run manager, physics list, user classes), macro
+  - every thread:      Initialize (G4State_Init -> Idle: geometry and physics construction), RunInitialization
+                       (Idle -> GeomClosed: the physics tables and HP data of BeamOn, plus the UI commands before it),
+                       Construct / ConstructSDandField / Build, BeginOfRunAction, EndOfRunAction with Write and
+                       CloseFile (ntuple merging), Merge (accumulables) and OutputWriter
+  - worker events:     every n-th event of each thread (/custom/trace/eventSampling, default 100), the first always
+The initialization phases come from a G4VStateDependent of each thread.
+
+Every thread writes complete spans ("ph":"X") into a ring buffer of its own (/custom/trace/bufferSize records,
+default 65536; the oldest are overwritten), without locks - the span names are string literals, kept as pointers.
+The master writes all buffers at the end of main() to Output/Trace/trace_<tag>.json, or at any time between runs
+with /custom/trace/write [file].
+*/
+
+#include "Tracer.hh"
+#include "TraceMessenger.hh"
+#include "OutputNaming.hh"
+
+#include "G4VStateDependent.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+
+#include <fstream>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+#if __unix__
+#include <unistd.h>                       //getpid() for the process of the trace
+#endif
+
+// get folderName from where it is defined (RunAction.cc) - the really dirty way
+extern std::string folderName;
+
+namespace {
+  G4Mutex tracerMutex = G4MUTEX_INITIALIZER;
+
+  // the initialization phases of one thread from its state changes
+  class StateWatcher : public G4VStateDependent
+  {
+    public:
+      virtual G4bool Notify(G4ApplicationState requestedState)
+      {
+        if (Tracer::IsEnabled()) {
+          G4double now = Tracer::Now();
+          if (requestedState == G4State_Init) fInitStart = now;
+          else if (requestedState == G4State_Idle) {
+            if (fState == G4State_Init && fInitStart >= 0.) Tracer::Add("Initialize", fInitStart);
+            fIdleStart = now;
+          }
+          else if (requestedState == G4State_GeomClosed && fState == G4State_Idle && fIdleStart >= 0.)
+            Tracer::Add("RunInitialization", fIdleStart);
+        }
+        fState = requestedState;
+        return true;
+      }
+
+    private:
+      G4ApplicationState fState = G4State_PreInit;
+      G4double fInitStart = -1., fIdleStart = -1.;
+  };
+}
+
+Tracer* Tracer::fgInstance = nullptr;
+G4bool Tracer::fgEnabled = false;
+G4int Tracer::fgEventSampling = 100;
+G4int Tracer::fgBufferSize = 65536;
+const std::chrono::steady_clock::time_point Tracer::fgStart = std::chrono::steady_clock::now();
+G4ThreadLocal Tracer::ThreadData* Tracer::fgLocal = nullptr;
+std::vector<std::unique_ptr<Tracer::ThreadData>> Tracer::fgThreadData;
+
+
+Tracer::Tracer(G4bool enabled)
+: fTraceMessenger(nullptr)
+{
+  fgInstance = this;
+  fgEnabled  = enabled;
+  fTraceMessenger = new TraceMessenger(this);
+  Local();                                      // the master watches its state changes from now on
+}
+
+
+Tracer::~Tracer()
+{
+  delete fTraceMessenger;
+  fgInstance = nullptr;
+}
+
+
+void Tracer::SetBufferSize(G4int n)
+{
+  // round up to a power of 2
+  G4int size = 1;
+  while (size < n) size <<= 1;
+  fgBufferSize = size;
+}
+
+
+Tracer::ThreadData& Tracer::Register()
+{
+  auto data = std::make_unique<ThreadData>();
+  data->fThread = G4Threading::G4GetThreadId();
+  data->fRing.resize(fgBufferSize);
+  data->fStateWatcher = new StateWatcher;       // registers with the G4StateManager of this thread
+
+  G4AutoLock lock(&tracerMutex);
+  fgLocal = data.get();
+  fgThreadData.push_back(std::move(data));
+  return *fgLocal;
+}
+
+
+void Tracer::Add(const char* name, G4double start, G4long arg)
+{
+  ThreadData& data = Local();
+  Record& record = data.fRing[data.fNext++ & (data.fRing.size() - 1)];
+  record.fName     = name;
+  record.fStart    = start;
+  record.fDuration = Now() - start;
+  record.fArg      = arg;
+}
+
+
+void Tracer::BeginOfEvent(G4long eventID)
+{
+  if (!fgEnabled) return;
+  ThreadData& data = Local();
+  data.fEventStart = (data.fEvents++ % fgEventSampling == 0) ? Now() : -1.;
+  data.fEventID    = eventID;
+}
+
+
+void Tracer::EndOfEvent()
+{
+  if (!fgEnabled) return;
+  ThreadData& data = Local();
+  if (data.fEventStart >= 0.) Add("Event", data.fEventStart, data.fEventID);
+  data.fEventStart = -1.;
+}
+
+
+void Tracer::Write(G4String fileName) const
+{
+  if (fileName.empty()) {
+    G4String folder = folderName + "/Trace";
+    std::error_code ec;
+    fs::create_directories(folder, ec);
+    G4String tag = OutputNaming::Instance() ? OutputNaming::Instance()->GetTag() : G4String("run");
+    fileName = folder + "/trace_" + tag + ".json";
+  }
+
+  std::ofstream out(fileName);
+  if (!out) {
+    G4cout << "\n--> warning from Tracer : can not write " << fileName << G4endl;
+    return;
+  }
+#if __unix__
+  long pid = getpid();
+#else
+  long pid = 0;
+#endif
+
+  // between runs: no thread is recording
+  G4AutoLock lock(&tracerMutex);
+  unsigned long long nbOfRecords = 0, nbOfLost = 0;
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\"ColliRotate\"}}";
+  out.precision(3);
+  out << std::fixed;
+  for ( const auto& data : fgThreadData ) {
+    G4int tid = data->fThread + 1;
+    G4String threadName = (data->fThread < 0) ? G4String("master") : G4String("worker " + std::to_string(data->fThread));
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid
+        << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+    out << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid
+        << ",\"args\":{\"sort_index\":" << tid << "}}";
+
+    unsigned long long size  = data->fRing.size();
+    unsigned long long first = (data->fNext > size) ? data->fNext - size : 0;
+    for (unsigned long long i = first; i < data->fNext; i++) {
+      const Record& record = data->fRing[i & (size - 1)];
+      out << ",\n{\"name\":\"" << record.fName << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid
+          << ",\"ts\":" << record.fStart << ",\"dur\":" << record.fDuration;
+      if (record.fArg >= 0) out << ",\"args\":{\"event\":" << record.fArg << "}";
+      out << "}";
+    }
+    nbOfRecords += data->fNext - first;
+    nbOfLost    += first;
+  }
+  out << "\n]}\n";
+  out.close();
+
+  G4cout << "\n Trace: " << nbOfRecords << " spans written to " << fileName;
+  if (nbOfLost > 0) G4cout << " (" << nbOfLost << " overwritten, see /custom/trace/bufferSize)";
+  G4cout << G4endl;
+  if (OutputNaming::Instance()) OutputNaming::Instance()->Register("trace", fileName);
+}
@@ -0,0 +1,130 @@
+/*
+Time and energy cuts for all particle species. Neutrons in the BoratedPE and copper random-walk for microseconds
+after they are thermalized; tracks which can not contribute to the scored time window anymore are killed here.
+The killed tracks are counted in Run.cc so the bias can be checked at the end of the run.
+*/
+
+#include "TrackKiller.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4LogicalVolume.hh"
+#include "G4ParticleTable.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4UnitsTable.hh"
+
+#include <iomanip>
+
+
+TrackKiller::TrackKiller()
+{ }
+
+
+TrackKiller::~TrackKiller()
+{ }
+
+
+TrackKiller::KillLimit& TrackKiller::FindOrAddLimit(G4String particle, G4String region)
+{
+  for ( auto& limit : fLimits ) {
+    if (limit.fParticleName == particle && limit.fRegionName == region) return limit;
+  }
+
+  KillLimit limit;
+  limit.fParticleName = particle;
+  limit.fRegionName   = region;
+  limit.fParticle     = nullptr;
+  limit.fRegion       = nullptr;
+  limit.fTimeMax      = DBL_MAX;
+  limit.fEkinMin      = 0.;
+  limit.fResolved     = false;
+  fLimits.push_back(limit);
+
+  return fLimits.back();
+}
+
+
+void TrackKiller::SetTimeLimit(G4String particle, G4String region, G4double tmax)
+{
+  FindOrAddLimit(particle, region).fTimeMax = tmax;
+}
+
+
+void TrackKiller::SetEnergyLimit(G4String particle, G4String region, G4double emin)
+{
+  FindOrAddLimit(particle, region).fEkinMin = emin;
+}
+
+
+void TrackKiller::ClearLimits()
+{
+  fLimits.clear();
+}
+
+
+void TrackKiller::Resolve()
+{
+  // names are resolved at the start of each run because particles and regions do not exist in PreInit
+  for ( auto& limit : fLimits ) {
+    limit.fResolved = true;
+    limit.fParticle = nullptr;
+    limit.fRegion   = nullptr;
+
+    if (limit.fParticleName != "all") {
+      limit.fParticle = G4ParticleTable::GetParticleTable()->FindParticle(limit.fParticleName);
+      if (!limit.fParticle) limit.fResolved = false;
+    }
+
+    if (limit.fRegionName != "all") {
+      limit.fRegion = G4RegionStore::GetInstance()->GetRegion(limit.fRegionName, false);
+      if (!limit.fRegion) limit.fResolved = false;
+    }
+
+    if (!limit.fResolved) {
+      G4ExceptionDescription msg;
+      msg << "Kill limit for particle '" << limit.fParticleName << "' in region '"
+          << limit.fRegionName << "' can not be resolved and is ignored.";
+      G4Exception("TrackKiller::Resolve()", "TrackKiller001", JustWarning, msg);
+    }
+  }
+}
+
+
+void TrackKiller::PrintLimits() const
+{
+  if (fLimits.empty()) return;
+
+  G4cout << "\n Track kill limits :" << G4endl;
+  for ( const auto& limit : fLimits ) {
+    G4cout << "  " << std::setw(13) << limit.fParticleName
+           << " in " << std::setw(25) << limit.fRegionName << ":  ";
+    if (limit.fTimeMax < DBL_MAX) G4cout << "t > " << G4BestUnit(limit.fTimeMax, "Time") << "  ";
+    if (limit.fEkinMin > 0.)      G4cout << "Ekin < " << G4BestUnit(limit.fEkinMin, "Energy");
+    if (!limit.fResolved)         G4cout << "  (ignored)";
+    G4cout << G4endl;
+  }
+}
+
+
+G4int TrackKiller::Check(const G4Step* step) const
+{
+  if (fLimits.empty()) return kNotKilled;
+
+  const G4Track* track = step->GetTrack();
+  const G4ParticleDefinition* particle = track->GetDefinition();
+  const G4Region* region = step->GetPreStepPoint()->GetPhysicalVolume()->GetLogicalVolume()->GetRegion();
+
+  // pointers only - no string comparisons per step
+  for ( const auto& limit : fLimits ) {
+    if (!limit.fResolved) continue;
+    if (limit.fParticle && limit.fParticle != particle) continue;
+    if (limit.fRegion   && limit.fRegion   != region)   continue;
+
+    if (track->GetGlobalTime()    > limit.fTimeMax) return kTimeLimit;
+    if (track->GetKineticEnergy() < limit.fEkinMin) return kEnergyLimit;
+  }
+
+  return kNotKilled;
+}
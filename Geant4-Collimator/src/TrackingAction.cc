@@ -3,6 +3,9 @@
 #include "Run.hh"
 #include "EventAction.hh"
 #include "Analysis.hh"
+#include "LoopCounters.hh"
+#include "EventWatchdog.hh"
+#include "PerfCounters.hh"
 
 #include "G4RunManager.hh"
 #include "G4Track.hh"
@@ -27,6 +30,10 @@ TrackingAction::~TrackingAction()
 
 void TrackingAction::PreUserTrackingAction(const G4Track* track)
 {
+  PerfCounters::Scope perf(PerfCounters::kTracking);
+  LOOP_COUNT(CountTrack(track->GetParentID() > 0));
+  if (EventWatchdog::IsEnabled()) EventWatchdog::CountTrack();
+
   Run* run = static_cast<Run*>(
        G4RunManager::GetRunManager()->GetNonConstCurrentRun());
 
@@ -43,6 +50,8 @@ void TrackingAction::PreUserTrackingAction(const G4Track* track)
 
 void TrackingAction::PostUserTrackingAction(const G4Track* track)
 {
+  PerfCounters::Scope perf(PerfCounters::kTracking);
+
   Run* run = static_cast<Run*>(
        G4RunManager::GetRunManager()->GetNonConstCurrentRun());
   
@@ -0,0 +1,103 @@
+/*
+Commands for the overlap checks of the geometry - see GeometryValidator.cc
+*/
+
+#include "ValidatorMessenger.hh"
+
+#include "GeometryValidator.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4UIcmdWithoutParameter.hh"
+
+
+ValidatorMessenger::ValidatorMessenger(GeometryValidator* validator)
+:G4UImessenger(),
+ fValidator(validator), fOverlapsDir(nullptr),
+ fModeCmd(nullptr), fResolutionCmd(nullptr), fToleranceCmd(nullptr), fThreadsCmd(nullptr),
+ fCacheFileCmd(nullptr), fValidateCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fOverlapsDir = new G4UIdirectory("/custom/overlaps/",broadcast);
+  fOverlapsDir->SetGuidance("Overlap checks of the geometry, in parallel and cached by a hash of the geometry.");
+
+  // When to check
+  fModeCmd = new G4UIcmdWithAString("/custom/overlaps/mode",this);
+  fModeCmd->SetGuidance("deferred: check the whole geometry after it is built, skip it if the cache file has it (default)");
+  fModeCmd->SetGuidance("placement: every G4PVPlacement checks itself while the geometry is built");
+  fModeCmd->SetGuidance("off: no checks - takes effect at the next geometry build");
+  fModeCmd->SetParameterName("mode",false);
+  fModeCmd->SetCandidates("deferred placement off");
+  fModeCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Points per volume
+  fResolutionCmd = new G4UIcmdWithAnInteger("/custom/overlaps/resolution",this);
+  fResolutionCmd->SetGuidance("Points on the surface of every placement which are tested (default 1000)");
+  fResolutionCmd->SetParameterName("points",false);
+  fResolutionCmd->SetRange("points>0");
+  fResolutionCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Tolerance
+  fToleranceCmd = new G4UIcmdWithADoubleAndUnit("/custom/overlaps/tolerance",this);
+  fToleranceCmd->SetGuidance("Overlaps up to this depth are not reported (default 0)");
+  fToleranceCmd->SetParameterName("tolerance",false);
+  fToleranceCmd->SetRange("tolerance>=0.");
+  fToleranceCmd->SetUnitCategory("Length");
+  fToleranceCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Threads
+  fThreadsCmd = new G4UIcmdWithAnInteger("/custom/overlaps/threads",this);
+  fThreadsCmd->SetGuidance("Threads which check the placements (default 0 = one per core)");
+  fThreadsCmd->SetParameterName("n",false);
+  fThreadsCmd->SetRange("n>=0");
+  fThreadsCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Cache of validated geometries
+  fCacheFileCmd = new G4UIcmdWithAString("/custom/overlaps/cacheFile",this);
+  fCacheFileCmd->SetGuidance("File with the hashes of the checked geometries (default OverlapCache.txt, none = no cache)");
+  fCacheFileCmd->SetParameterName("fileName",false);
+  fCacheFileCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Check now
+  fValidateCmd = new G4UIcmdWithoutParameter("/custom/overlaps/validate",this);
+  fValidateCmd->SetGuidance("Check the current geometry now, in any mode and also if the cache file has it");
+  fValidateCmd->AvailableForStates(G4State_Idle);
+}
+
+
+ValidatorMessenger::~ValidatorMessenger()
+{
+  delete fModeCmd;
+  delete fResolutionCmd;
+  delete fToleranceCmd;
+  delete fThreadsCmd;
+  delete fCacheFileCmd;
+  delete fValidateCmd;
+  delete fOverlapsDir;
+}
+
+
+void ValidatorMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fModeCmd ) {
+    if      (newValue == "placement") fValidator->SetMode(GeometryValidator::kPlacement);
+    else if (newValue == "off")       fValidator->SetMode(GeometryValidator::kOff);
+    else                              fValidator->SetMode(GeometryValidator::kDeferred);
+  }
+
+  if( command == fResolutionCmd )
+   { fValidator->SetResolution(fResolutionCmd->GetNewIntValue(newValue));}
+
+  if( command == fToleranceCmd )
+   { fValidator->SetTolerance(fToleranceCmd->GetNewDoubleValue(newValue));}
+
+  if( command == fThreadsCmd )
+   { fValidator->SetThreads(fThreadsCmd->GetNewIntValue(newValue));}
+
+  if( command == fCacheFileCmd )
+   { fValidator->SetCacheFile(newValue);}
+
+  if( command == fValidateCmd )
+   { fValidator->ValidateNow();}
+}
@@ -0,0 +1,80 @@
+/*
+Commands for the slow-event watchdog - see EventWatchdog.cc
+*/
+
+#include "WatchdogMessenger.hh"
+
+#include "EventWatchdog.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcommand.hh"
+#include "G4UIparameter.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <sstream>
+
+
+WatchdogMessenger::WatchdogMessenger(EventWatchdog* watchdog)
+:G4UImessenger(),
+ fEventWatchdog(watchdog), fWatchdogDir(nullptr),
+ fThresholdCmd(nullptr), fMaxReportsCmd(nullptr), fReplayCmd(nullptr)
+{
+  G4bool broadcast = false;
+  fWatchdogDir = new G4UIdirectory("/custom/watchdog/",broadcast);
+  fWatchdogDir->SetGuidance("Reports of slow events, with the engine state to replay them.");
+
+  // Wall time of a slow event
+  fThresholdCmd = new G4UIcmdWithADoubleAndUnit("/custom/watchdog/threshold",this);
+  fThresholdCmd->SetGuidance("Report events running longer than this wall time (0 = off, default)");
+  fThresholdCmd->SetParameterName("time",false);
+  fThresholdCmd->SetRange("time>=0.");
+  fThresholdCmd->SetUnitCategory("Time");
+  fThresholdCmd->SetDefaultUnit("s");
+  fThresholdCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Limit the number of reports
+  fMaxReportsCmd = new G4UIcmdWithAnInteger("/custom/watchdog/maxReports",this);
+  fMaxReportsCmd->SetGuidance("Report at most this many slow events per job (default 20)");
+  fMaxReportsCmd->SetParameterName("n",false);
+  fMaxReportsCmd->SetRange("n>=0");
+  fMaxReportsCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+
+  // Replay one reported event
+  fReplayCmd = new G4UIcommand("/custom/watchdog/replay",this);
+  fReplayCmd->SetGuidance("Run the event of a .rndm file of Output/SlowEvents once more with /tracking/verbose");
+  fReplayCmd->SetGuidance("Use the same macro (geometry, source, physics) as the run that reported the event");
+  G4UIparameter* fileParam = new G4UIparameter("file",'s',false);
+  fReplayCmd->SetParameter(fileParam);
+  G4UIparameter* verboseParam = new G4UIparameter("verbose",'i',true);
+  verboseParam->SetDefaultValue(1);
+  fReplayCmd->SetParameter(verboseParam);
+  fReplayCmd->AvailableForStates(G4State_Idle);
+}
+
+
+WatchdogMessenger::~WatchdogMessenger()
+{
+  delete fThresholdCmd;
+  delete fMaxReportsCmd;
+  delete fReplayCmd;
+  delete fWatchdogDir;
+}
+
+
+void WatchdogMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if( command == fThresholdCmd )
+   { fEventWatchdog->SetThreshold(fThresholdCmd->GetNewDoubleValue(newValue)/s);}
+
+  if( command == fMaxReportsCmd )
+   { fEventWatchdog->SetMaxReports(fMaxReportsCmd->GetNewIntValue(newValue));}
+
+  if( command == fReplayCmd ) {
+    G4String fileName;
+    G4int verboseLevel = 1;
+    std::istringstream is(newValue);
+    is >> fileName >> verboseLevel;
+    fEventWatchdog->Replay(fileName, verboseLevel);
+  }
+}
@@ -305,7 +305,8 @@ How to import one object from an .stl-file
   logicFlanschAssemblyVisAtt->SetVisibility(true);
   logicFlanschAssembly->SetVisAttributes(logicFlanschAssemblyVisAtt);
 
-  //import .obj-file containing an assembly
+  //import .obj-file containing an assembly - the same file again: its meshes come from the mesh cache of CADMesh,
+  //it is parsed only once (per modification of the file). Load times with /custom/cad/printCache
   auto Ring_mesh = CADMesh::TessellatedMesh::FromOBJ("./Austrittsfenster.obj");
   Ring_mesh->SetScale(1);
 
@@ -712,6 +713,7 @@ How to import one object from an .stl-file
   // CADMesh :: OBJ // - ASSEMBLIES
   ////////////////////
   //import .obj-file containing an assembly
+  //large files load much faster converted to binary meshes: 'CADConvert FaradayCupMobile.obj' and From("./FaradayCupMobile.cmb")
   auto FaradayCup_mesh = CADMesh::TessellatedMesh::FromOBJ("./FaradayCupMobile.obj");
   FaradayCup_mesh->SetScale(1);
 